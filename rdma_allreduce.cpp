@@ -0,0 +1,149 @@
+#include "rdma_collective.hpp"
+
+/*
+    环形 allreduce 基准测试
+
+    用法:
+      ./rdma_allreduce rendezvous <nranks>
+      ./rdma_allreduce <rendezvous_ip> [max_mb] [iters] [f32|f16|i64] [sum|max]
+
+    先启动集合点进程，再启动 nranks 个rank进程（max_mb 必须相同）。
+    每种消息长度先校验一次结果，再计时 iters 次，由 rank 0 输出：
+      algbw = 字节数 / 时间，busbw = algbw * 2(N-1)/N（与链路带宽可直接比较）
+*/
+
+// 第i个元素在rank上的初始值，全部为小整数，float16也能精确表示求和结果
+double init_value(int rank, size_t i) {
+    return (double)((rank + 1) * (int)(i % 7 + 1));
+}
+
+double expected_value(reduce_op op, int nranks, size_t i) {
+    int base = (int)(i % 7 + 1);
+    return op == REDUCE_SUM ? (double)(base * nranks * (nranks + 1) / 2) : (double)(base * nranks);
+}
+
+void fill_buffer(char *buf, size_t count, reduce_dtype dtype, int rank) {
+    for (size_t i = 0; i < count; i++) {
+        double v = init_value(rank, i);
+        if (dtype == REDUCE_F32) {
+            ((float *)buf)[i] = (float)v;
+        } else if (dtype == REDUCE_F16) {
+            ((uint16_t *)buf)[i] = float_to_half((float)v);
+        } else {
+            ((int64_t *)buf)[i] = (int64_t)v;
+        }
+    }
+}
+
+int check_buffer(const char *buf, size_t count, reduce_dtype dtype, reduce_op op, int nranks) {
+    for (size_t i = 0; i < count; i++) {
+        double v;
+        if (dtype == REDUCE_F32) {
+            v = ((const float *)buf)[i];
+        } else if (dtype == REDUCE_F16) {
+            v = half_to_float(((const uint16_t *)buf)[i]);
+        } else {
+            v = (double)((const int64_t *)buf)[i];
+        }
+        if (v != expected_value(op, nranks, i)) {
+            std::cerr << "Mismatch at element " << i << ": got " << v
+                      << ", expected " << expected_value(op, nranks, i) << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 本地归约内核的吞吐（按读写的总字节数计算）
+void bench_kernels(reduce_dtype dtype, reduce_op op) {
+    size_t bytes = 16 << 20;
+    std::vector<char> dst(bytes), src(bytes);
+    fill_buffer(dst.data(), bytes / reduce_dtype_size(dtype), dtype, 0);
+    fill_buffer(src.data(), bytes / reduce_dtype_size(dtype), dtype, 1);
+    for (int level = REDUCE_SCALAR; level <= REDUCE_AVX512; level++) {
+        const char *name;
+        reduce_fn fn = reduce_kernel(dtype, op, (reduce_level)level, &name);
+        if (!fn) {
+            continue;
+        }
+        int reps = 10;
+        uint64_t start = now_ns();
+        for (int r = 0; r < reps; r++) {
+            fn(dst.data(), src.data(), bytes / reduce_dtype_size(dtype));
+        }
+        double secs = (now_ns() - start) / 1e9;
+        std::cout << "Reduce kernel " << name << ": " << 3.0 * bytes * reps / secs / 1e9 << " GB/s" << std::endl;
+    }
+}
+
+int run_benchmark(coll_ring *ring, size_t max_bytes, int iters, reduce_dtype dtype, reduce_op op) {
+    size_t elem_size = reduce_dtype_size(dtype);
+    int nranks = ring->nranks;
+    for (size_t bytes = 4096; bytes <= max_bytes; bytes *= 4) {
+        size_t count = bytes / elem_size;
+
+        fill_buffer(ring->data, count, dtype, ring->rank);
+        if (coll_allreduce(ring, count, dtype, op) < 0 ||
+            check_buffer(ring->data, count, dtype, op, nranks) < 0) {
+            return -1;
+        }
+
+        // 每次都重新填充并校验结果，只统计allreduce本身的时间；
+        // 各rank不互相等待地连续调用，也能检查相邻两次调用的数据不会混在一起
+        uint64_t elapsed = 0;
+        for (int i = 0; i < iters; i++) {
+            fill_buffer(ring->data, count, dtype, ring->rank);
+            uint64_t start = now_ns();
+            if (coll_allreduce(ring, count, dtype, op) < 0) {
+                return -1;
+            }
+            elapsed += now_ns() - start;
+            if (check_buffer(ring->data, count, dtype, op, nranks) < 0) {
+                return -1;
+            }
+        }
+        double secs = elapsed / 1e9 / iters;
+        double algbw = bytes / secs / 1e9;
+        if (ring->rank == 0) {
+            std::cout << "Size: " << bytes << " bytes, time: " << secs * 1e6 << " us"
+                      << ", algbw: " << algbw << " GB/s"
+                      << ", busbw: " << algbw * 2 * (nranks - 1) / nranks << " GB/s" << std::endl;
+        }
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " rendezvous <nranks>" << std::endl;
+        std::cerr << "       " << argv[0] << " <rendezvous_ip> [max_mb] [iters] [f32|f16|i64] [sum|max]" << std::endl;
+        return -1;
+    }
+    if (strcmp(argv[1], "rendezvous") == 0) {
+        int nranks = argc > 2 ? atoi(argv[2]) : 2;
+        return coll_rendezvous(nranks);
+    }
+
+    size_t max_bytes = (size_t)(argc > 2 ? atoi(argv[2]) : 64) << 20;
+    int iters = argc > 3 ? atoi(argv[3]) : 20;
+    reduce_dtype dtype = REDUCE_F32;
+    if (argc > 4) {
+        dtype = strcmp(argv[4], "f16") == 0 ? REDUCE_F16 : (strcmp(argv[4], "i64") == 0 ? REDUCE_I64 : REDUCE_F32);
+    }
+    reduce_op op = argc > 5 && strcmp(argv[5], "max") == 0 ? REDUCE_MAX : REDUCE_SUM;
+
+    coll_ring ring;
+    int ret = coll_ring_init(&ring, argv[1], max_bytes);
+    if (ret == 0) {
+        if (ring.rank == 0) {
+            bench_kernels(dtype, op);
+        }
+        ret = run_benchmark(&ring, max_bytes, iters, dtype, op);
+    }
+    if (ret < 0) {
+        std::cerr << "Allreduce failed" << std::endl;
+    }
+    coll_ring_free(&ring);
+    return ret;
+}
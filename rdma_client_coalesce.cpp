@@ -0,0 +1,175 @@
+#include "rdma_coalesce.hpp"
+
+/*
+    小消息合并发送基准测试
+
+    用法: ./rdma_client_coalesce <server_ip> [messages] [max_delay_us]
+
+    三种发送方式 × 四种到达模式：
+      发送方式：每条消息一个WR / 固定阈值合并（缓冲区满或max_delay_us超时）/ 自适应合并
+      到达模式：连续发送 / 每1us一条 / 每50us一条 / 每100us突发32条
+    输出消息速率、平均每批消息数、平均附加延迟（消息从到达到被post的时间，包括等待信用的时间）。
+*/
+
+struct coalesce_phase {
+    uint32_t count;
+};
+
+struct coalesce_result {
+    uint32_t received;
+    uint32_t errors;
+    uint64_t batches;
+};
+
+struct arrival_pattern {
+    const char *name;
+    uint64_t gap_ns;        // 相邻消息的到达间隔
+    uint32_t burst;         // 突发长度，0表示不突发
+    uint64_t idle_ns;       // 两次突发之间的空闲时间
+    uint32_t divisor;       // 消息数 = messages / divisor
+};
+
+enum coalesce_mode {
+    MODE_PER_WR = 0,
+    MODE_FIXED = 1,
+    MODE_ADAPTIVE = 2,
+};
+
+const char *mode_names[] = {"per-WR", "fixed", "adaptive"};
+
+uint32_t bench_msg_len(uint32_t seq) {
+    return 32 + (uint32_t)(((uint64_t)seq * 2654435761u) >> 7) % 225;
+}
+
+void fill_msg(char *msg, uint32_t len, uint32_t seq) {
+    memcpy(msg, &seq, sizeof(seq));
+    for (uint32_t i = sizeof(seq); i < len; i++) {
+        msg[i] = (char)(seq + i);
+    }
+}
+
+int run_phase(credit_channel *ch, int sock_fd, coalesce_mode mode, const arrival_pattern *pat,
+              uint32_t count, uint32_t max_delay_us) {
+    coalesce_phase phase;
+    phase.count = count;
+    if (sock_send_all(sock_fd, &phase, sizeof(phase)) < 0) {
+        std::cerr << "Failed to send phase" << std::endl;
+        return -1;
+    }
+
+    coalesce_sender cs;
+    if (mode == MODE_PER_WR) {
+        coalesce_sender_init(&cs, ch, 1, max_delay_us, false);
+    } else {
+        coalesce_sender_init(&cs, ch, CREDIT_MSG_SIZE, max_delay_us, mode == MODE_ADAPTIVE);
+    }
+
+    char msg[256];
+    uint64_t start = now_ns();
+    uint64_t next = start;
+    for (uint32_t seq = 0; seq < count; seq++) {
+        while (now_ns() < next) {
+            if (coalesce_poll(&cs) < 0) {
+                return -1;
+            }
+        }
+        uint32_t len = bench_msg_len(seq);
+        fill_msg(msg, len, seq);
+        if (coalesce_send(&cs, msg, len) < 0) {
+            return -1;
+        }
+        next += pat->gap_ns;
+        if (pat->burst && (seq + 1) % pat->burst == 0) {
+            next += pat->idle_ns;
+        }
+    }
+    if (coalesce_flush(&cs) < 0) {
+        return -1;
+    }
+
+    coalesce_result result;
+    if (sock_recv_all(sock_fd, &result, sizeof(result)) < 0) {
+        std::cerr << "Failed to receive result" << std::endl;
+        return -1;
+    }
+    double secs = (now_ns() - start) / 1e9;
+    if (result.received != count || result.errors) {
+        std::cerr << "Verification failed: " << result.received << " received, " << result.errors << " corrupted" << std::endl;
+        return -1;
+    }
+    std::cout << mode_names[mode] << " / " << pat->name << ": " << count / secs << " msg/s"
+              << ", " << (double)count / result.batches << " msgs/batch"
+              << ", added latency: " << cs.added_ns / cs.msgs / 1000.0 << " us"
+              << ", flushes (size/timer/call): " << cs.flush_by_size << "/" << cs.flush_by_timer
+              << "/" << cs.flush_by_call << std::endl;
+    return 0;
+}
+
+int rdma_client_coalesce(rdma_context *_ctx, int sock_fd, uint32_t messages, uint32_t max_delay_us) {
+    if (rdma_alloc_resources(_ctx, CREDIT_BUF_SIZE, 2 * (CREDIT_SEND_SLOTS + CREDIT_RECV_SLOTS), IBV_ACCESS_LOCAL_WRITE) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, CREDIT_SEND_SLOTS + CREDIT_CTRL_SLOTS, CREDIT_RECV_SLOTS) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, sock_fd, &remote_qp_info, IBV_ACCESS_LOCAL_WRITE, 0) < 0) {
+        return -1;
+    }
+
+    credit_channel ch;
+    if (credit_channel_init(&ch, _ctx) < 0 || credit_handshake(&ch, sock_fd) < 0) {
+        return -1;
+    }
+
+    const arrival_pattern patterns[] = {
+        {"back-to-back", 0, 0, 0, 1},
+        {"every 1us", 1000, 0, 0, 4},
+        {"every 50us", 50000, 0, 0, 50},
+        {"burst 32 / 100us", 0, 32, 100000, 10},
+    };
+    for (const arrival_pattern &pat : patterns) {
+        uint32_t count = std::max<uint32_t>(messages / pat.divisor, 1);
+        for (int mode = MODE_PER_WR; mode <= MODE_ADAPTIVE; mode++) {
+            if (run_phase(&ch, sock_fd, (coalesce_mode)mode, &pat, count, max_delay_us) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    coalesce_phase done;
+    done.count = 0;
+    if (sock_send_all(sock_fd, &done, sizeof(done)) < 0) {
+        std::cerr << "Failed to send phase" << std::endl;
+        return -1;
+    }
+    std::cout << "Credit stalls: " << ch.credit_stalls << std::endl;
+    return credit_drain(&ch);
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [messages] [max_delay_us]" << std::endl;
+        return -1;
+    }
+    uint32_t messages = argc > 2 ? atoi(argv[2]) : 1000000;
+    uint32_t max_delay_us = argc > 3 ? atoi(argv[3]) : 20;
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_client_coalesce(&ctx, sock_fd, messages, max_delay_us);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
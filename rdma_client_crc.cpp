@@ -0,0 +1,235 @@
+#include "rdma_common.hpp"
+#include "rdma_crc32c.hpp"
+
+/*
+    带CRC32C端到端校验的RDMA写/读客户端。
+    写：post第N块的RDMA_WRITE_WITH_IMM后立即计算第N块的CRC，计算与网卡DMA读取重叠；
+        全部写完后写入尾部（每块CRC + 整体摘要），并以立即数据携带摘要。
+    读：先读尾部，再流水RDMA_READ各块，第N块完成后校验它，同时后续块仍在传输。
+*/
+
+#define CRC_WINDOW 16           // 在途WR数
+
+struct crc_bench_config {
+    uint64_t size;
+    uint32_t chunk;
+    uint32_t iters;
+    uint32_t integrity;
+};
+
+// 等待一个发送方向的完成
+int wait_send(rdma_context *_ctx, uint64_t *wr_id) {
+    struct ibv_wc wc;
+    while (ibv_poll_cq(_ctx->cq, 1, &wc) == 0);
+    if (wc.status != IBV_WC_SUCCESS) {
+        std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc.status) << std::endl;
+        return -1;
+    }
+    *wr_id = wc.wr_id;
+    return 0;
+}
+
+int post_rdma(rdma_context *_ctx, enum ibv_wr_opcode opcode, uint64_t wr_id, char *local, uint32_t len,
+              uint64_t remote_addr, uint32_t rkey, uint32_t imm) {
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)local;
+    sge.length = len;
+    sge.lkey = _ctx->mr->lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = wr_id;
+    wr.opcode = opcode;
+    wr.sg_list = &sge;
+    wr.num_sge = len > 0 ? 1 : 0;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.imm_data = htonl(imm);
+    wr.wr.rdma.remote_addr = remote_addr;
+    wr.wr.rdma.rkey = rkey;
+    if (ibv_post_send(_ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post RDMA request" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int rdma_client_crc(rdma_context *_ctx, int sock_fd, const crc_bench_config *cfg) {
+    if (sock_send_all(sock_fd, cfg, sizeof(*cfg)) < 0) {
+        std::cerr << "Failed to send benchmark config" << std::endl;
+        return -1;
+    }
+    uint32_t nchunks = (uint32_t)((cfg->size + cfg->chunk - 1) / cfg->chunk);
+    size_t trailer_size = (nchunks + 1) * sizeof(uint32_t);
+
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    if (rdma_alloc_resources(_ctx, cfg->size + trailer_size, 2 * CRC_WINDOW, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, CRC_WINDOW, 1) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, sock_fd, &remote_qp_info, access) < 0) {
+        return -1;
+    }
+    char ready;
+    if (sock_recv_all(sock_fd, &ready, 1) < 0) {
+        return -1;
+    }
+
+    const char *impl;
+    crc32c_select(&impl);
+    std::cout << "CRC32C implementation: " << impl << std::endl;
+
+    char *data = _ctx->buffer;
+    uint32_t *trailer = (uint32_t *)(_ctx->buffer + cfg->size);
+    for (uint64_t i = 0; i < cfg->size; i++) {
+        data[i] = (char)(i * 131 + 7);
+    }
+
+    // 各实现的本地校验速度，作为网络吞吐的参照
+    if (cfg->integrity) {
+        crc32c_fn impls[] = {crc32c_sw, crc32c_sse42, crc32c_select(NULL)};
+        const char *names[] = {"scalar", "sse4.2", impl};
+        for (int k = 0; k < 3; k++) {
+            uint64_t t0 = now_ns();
+            uint32_t c = impls[k](0, data, cfg->size);
+            double s = (now_ns() - t0) / 1e9;
+            std::cout << "CRC32C " << names[k] << ": " << cfg->size / s / 1e9 << " GB/s (crc " << std::hex << c << std::dec << ")" << std::endl;
+        }
+    }
+
+    // 写阶段
+    uint64_t start = now_ns();
+    for (uint32_t it = 0; it < cfg->iters; it++) {
+        int inflight = 0;
+        uint64_t wr_id;
+        for (uint32_t n = 0; n < nchunks; n++) {
+            if (inflight == CRC_WINDOW) {
+                if (wait_send(_ctx, &wr_id) < 0) {
+                    return -1;
+                }
+                inflight--;
+            }
+            uint64_t off = (uint64_t)n * cfg->chunk;
+            uint32_t len = (uint32_t)std::min((uint64_t)cfg->chunk, cfg->size - off);
+            enum ibv_wr_opcode op = cfg->integrity ? IBV_WR_RDMA_WRITE_WITH_IMM : IBV_WR_RDMA_WRITE;
+            if (post_rdma(_ctx, op, n, data + off, len, remote_qp_info.addr + off, remote_qp_info.rkey, n) < 0) {
+                return -1;
+            }
+            inflight++;
+            if (cfg->integrity) {
+                trailer[n] = crc32c(0, data + off, len);   // 该块正在传输时计算它的CRC
+            }
+        }
+        while (inflight > 0) {
+            if (wait_send(_ctx, &wr_id) < 0) {
+                return -1;
+            }
+            inflight--;
+        }
+        // 写入尾部并以立即数据携带摘要；不校验时只发一个零长度的结束通知
+        uint32_t digest = 0;
+        uint32_t tlen = 0;
+        if (cfg->integrity) {
+            digest = crc32c(0, trailer, nchunks * sizeof(uint32_t));
+            trailer[nchunks] = digest;
+            tlen = trailer_size;
+        }
+        if (post_rdma(_ctx, IBV_WR_RDMA_WRITE_WITH_IMM, nchunks, (char *)trailer, tlen,
+                      remote_qp_info.addr + cfg->size, remote_qp_info.rkey, digest) < 0 ||
+            wait_send(_ctx, &wr_id) < 0) {
+            return -1;
+        }
+        char ok;
+        if (sock_recv_all(sock_fd, &ok, 1) < 0 || !ok) {
+            std::cerr << "Server reported integrity failure" << std::endl;
+            return -1;
+        }
+    }
+    double secs = (now_ns() - start) / 1e9;
+    std::cout << "RDMA Write " << (cfg->integrity ? "with" : "without") << " integrity: "
+              << (double)cfg->size * cfg->iters / secs / 1e9 << " GB/s" << std::endl;
+
+    // 读阶段：先读尾部，再流水读各块并逐块校验
+    std::vector<uint32_t> expected(nchunks + 1);
+    uint32_t bad = 0;
+    start = now_ns();
+    for (uint32_t it = 0; it < cfg->iters; it++) {
+        memset(data, 0, cfg->size);
+        uint64_t wr_id;
+        if (cfg->integrity) {
+            if (post_rdma(_ctx, IBV_WR_RDMA_READ, nchunks, (char *)trailer, trailer_size,
+                          remote_qp_info.addr + cfg->size, remote_qp_info.rkey, 0) < 0 ||
+                wait_send(_ctx, &wr_id) < 0) {
+                return -1;
+            }
+            memcpy(expected.data(), trailer, trailer_size);
+        }
+        uint32_t posted = 0, completed = 0;
+        while (completed < nchunks) {
+            while (posted < nchunks && posted - completed < CRC_WINDOW) {
+                uint64_t off = (uint64_t)posted * cfg->chunk;
+                uint32_t len = (uint32_t)std::min((uint64_t)cfg->chunk, cfg->size - off);
+                if (post_rdma(_ctx, IBV_WR_RDMA_READ, posted, data + off, len,
+                              remote_qp_info.addr + off, remote_qp_info.rkey, 0) < 0) {
+                    return -1;
+                }
+                posted++;
+            }
+            if (wait_send(_ctx, &wr_id) < 0) {
+                return -1;
+            }
+            completed++;
+            if (cfg->integrity) {
+                // RC按序完成，wr_id即为刚到达的块号；校验它时后续块仍在传输
+                uint64_t off = wr_id * cfg->chunk;
+                uint32_t len = (uint32_t)std::min((uint64_t)cfg->chunk, cfg->size - off);
+                if (crc32c(0, data + off, len) != expected[wr_id]) {
+                    bad++;
+                }
+            }
+        }
+    }
+    secs = (now_ns() - start) / 1e9;
+    std::cout << "RDMA Read " << (cfg->integrity ? "with" : "without") << " integrity: "
+              << (double)cfg->size * cfg->iters / secs / 1e9 << " GB/s";
+    if (cfg->integrity) {
+        std::cout << ", corrupted chunks: " << bad;
+    }
+    std::cout << std::endl;
+
+    char done = 1;
+    sock_send_all(sock_fd, &done, 1);
+    return bad == 0 ? 0 : -1;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [size_mb] [chunk_kb] [iters] [--no-integrity]" << std::endl;
+        return -1;
+    }
+    crc_bench_config cfg;
+    cfg.size = (uint64_t)(argc > 2 ? atoi(argv[2]) : 256) << 20;
+    cfg.chunk = (argc > 3 ? atoi(argv[3]) : 1024) * 1024;
+    cfg.iters = argc > 4 ? atoi(argv[4]) : 10;
+    cfg.integrity = !(argc > 5 && strcmp(argv[5], "--no-integrity") == 0);
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_client_crc(&ctx, sock_fd, &cfg);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
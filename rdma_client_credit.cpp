@@ -0,0 +1,107 @@
+#include "rdma_credit.hpp"
+
+struct credit_bench_config {
+    uint32_t rounds;
+    uint32_t burst;
+    uint32_t oneway;
+};
+
+int rdma_client_credit(rdma_context *_ctx, int sock_fd, const credit_bench_config *cfg, bool naive) {
+    if (sock_send_all(sock_fd, cfg, sizeof(*cfg)) < 0) {
+        std::cerr << "Failed to send benchmark config" << std::endl;
+        return -1;
+    }
+
+    if (rdma_alloc_resources(_ctx, CREDIT_BUF_SIZE, 2 * (CREDIT_SEND_SLOTS + CREDIT_RECV_SLOTS), IBV_ACCESS_LOCAL_WRITE) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, CREDIT_SEND_SLOTS + CREDIT_CTRL_SLOTS, CREDIT_RECV_SLOTS) < 0) {
+        return -1;
+    }
+    // 对照组忽略信用，只能依靠RNR无限重试（rnr_retry = 7）兜底
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, sock_fd, &remote_qp_info, IBV_ACCESS_LOCAL_WRITE, naive ? 7 : 0) < 0) {
+        return -1;
+    }
+
+    credit_channel ch;
+    if (credit_channel_init(&ch, _ctx) < 0 || credit_handshake(&ch, sock_fd) < 0) {
+        return -1;
+    }
+    ch.ignore_credits = naive;
+
+    // 阶段一：每轮向对端突发burst条消息，统计每条消息的往返延迟。
+    // 没有信用时先消费回显，回显被消费后信用才会被归还，避免两端都阻塞在发送上。
+    std::vector<double> samples;
+    std::vector<uint64_t> send_ts(cfg->burst);
+    char msg[CREDIT_MSG_SIZE];
+    memset(msg, 'x', 64);
+    for (uint32_t r = 0; r < cfg->rounds; r++) {
+        uint32_t sent = 0, received = 0;
+        while (received < cfg->burst) {
+            if (sent < cfg->burst && credit_can_send(&ch)) {
+                send_ts[sent] = now_ns();
+                if (credit_send(&ch, msg, 64) < 0) {
+                    return -1;
+                }
+                sent++;
+            } else if (received < sent) {
+                if (credit_recv(&ch, msg, sizeof(msg)) < 0) {
+                    return -1;
+                }
+                samples.push_back((now_ns() - send_ts[received]) / 1000.0);
+                received++;
+            } else if (credit_progress(&ch) < 0) {
+                return -1;
+            }
+        }
+    }
+    print_latency_stats(naive ? "Burst RTT (no credits)" : "Burst RTT (credits)", samples);
+
+    // 阶段二：单向发送，对端只能通过纯信用消息归还信用
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < cfg->oneway; i++) {
+        if (credit_send(&ch, msg, 64) < 0) {
+            return -1;
+        }
+    }
+    if (credit_recv(&ch, msg, sizeof(msg)) < 0) {   // 等待对端的"Done"
+        return -1;
+    }
+    double secs = (now_ns() - start) / 1e9;
+    std::cout << "One-way: " << cfg->oneway << " messages, " << cfg->oneway / secs << " msg/s" << std::endl;
+    std::cout << "Credit stalls: " << ch.credit_stalls
+              << ", credit messages sent: " << ch.credit_msgs_sent
+              << ", RNR errors: " << ch.rnr_errors << std::endl;
+    return credit_drain(&ch);
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [burst] [rounds] [--naive]" << std::endl;
+        return -1;
+    }
+    credit_bench_config cfg;
+    cfg.burst = argc > 2 ? atoi(argv[2]) : 64;
+    cfg.rounds = argc > 3 ? atoi(argv[3]) : 1000;
+    cfg.oneway = 100000;
+    bool naive = argc > 4 && strcmp(argv[4], "--naive") == 0;
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_client_credit(&ctx, sock_fd, &cfg, naive);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -0,0 +1,152 @@
+#include "rdma_delta.hpp"
+
+/*
+    增量同步基准测试
+
+    用法: ./rdma_client_delta <server_ip> [size_mb] [block_kb]
+
+    两端由同一个种子生成相同的初始数据。每一轮先在本地随机修改一定比例的块（每块改一个32位字），
+    再分别用全量传输和增量同步把服务端更新到最新版本，输出线路上的字节数（读指纹 + 写数据）、
+    WR数和耗时，每轮结束后由服务端回复数据区的CRC32C校验两端一致。
+*/
+
+// 随机修改ratio比例的块，每块翻转一个32位字中的若干位
+void mutate_blocks(char *data, uint64_t size, uint32_t block_size, double ratio, std::mt19937_64 &rng) {
+    uint64_t nblocks = size / block_size;
+    uint64_t count = (uint64_t)(nblocks * ratio);
+    std::vector<uint64_t> order(nblocks);
+    for (uint64_t i = 0; i < nblocks; i++) {
+        order[i] = i;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        std::swap(order[i], order[i + rng() % (nblocks - i)]);
+        uint64_t off = order[i] * block_size + (rng() % (block_size / sizeof(uint32_t))) * sizeof(uint32_t);
+        uint32_t word;
+        memcpy(&word, data + off, sizeof(word));
+        word ^= (uint32_t)(rng() | 1);
+        memcpy(data + off, &word, sizeof(word));
+    }
+}
+
+int verify_round(rdma_context *_ctx, int sock_fd, uint64_t size) {
+    uint32_t cmd = DELTA_CMD_VERIFY, digest;
+    if (sock_send_all(sock_fd, &cmd, sizeof(cmd)) < 0 || sock_recv_all(sock_fd, &digest, sizeof(digest)) < 0) {
+        std::cerr << "Failed to verify with server" << std::endl;
+        return -1;
+    }
+    if (digest != crc32c(0, _ctx->buffer, size)) {
+        std::cerr << "Server data does not match local data" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+void print_result(const char *label, double ratio, const delta_stats &st, uint64_t ns) {
+    std::cout << label << " (" << ratio * 100 << "% changed): "
+              << (st.bytes_read + st.bytes_written) / 1e6 << " MB on the wire"
+              << " (read " << st.bytes_read / 1e6 << ", written " << st.bytes_written / 1e6 << ")"
+              << ", " << st.changed_blocks << " changed blocks, " << st.wrs << " WRs in " << st.chains << " chains"
+              << ", " << ns / 1e6 << " ms" << std::endl;
+}
+
+int rdma_client_delta(rdma_context *_ctx, int sock_fd, const delta_config *cfg) {
+    if (sock_send_all(sock_fd, cfg, sizeof(*cfg)) < 0) {
+        std::cerr << "Failed to send config" << std::endl;
+        return -1;
+    }
+    uint64_t nblocks = (cfg->size + cfg->block_size - 1) / cfg->block_size;
+    uint64_t fp_bytes = nblocks * sizeof(uint32_t);
+    int access = IBV_ACCESS_LOCAL_WRITE;
+    if (rdma_alloc_resources(_ctx, cfg->size + 2 * fp_bytes, 2 * DELTA_SQ_DEPTH, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, DELTA_SQ_DEPTH, 1) < 0) {
+        return -1;
+    }
+    qp_info remote;
+    if (rdma_connect_qp(_ctx, sock_fd, &remote, access) < 0) {
+        return -1;
+    }
+
+    char *data = _ctx->buffer;
+    uint32_t *local_fps = (uint32_t *)(_ctx->buffer + cfg->size);
+    uint32_t *remote_fps = (uint32_t *)(_ctx->buffer + cfg->size + fp_bytes);
+    int nthreads = std::max(1u, std::min(std::thread::hardware_concurrency(), 8u));
+    fill_base(data, cfg->size, cfg->seed);
+    std::cout << "Fingerprinting with " << nthreads << " threads" << std::endl;
+
+    std::mt19937_64 rng(cfg->seed + 1);
+    const double ratios[] = {0.01, 0.10, 0.50};
+    for (double ratio : ratios) {
+        // 全量传输
+        mutate_blocks(data, cfg->size, cfg->block_size, ratio, rng);
+        delta_stats full;
+        memset(&full, 0, sizeof(full));
+        std::vector<delta_run> runs;
+        uint64_t start = now_ns();
+        delta_full_runs(cfg->size, &runs);
+        if (delta_write_runs(_ctx, runs, data, remote.addr, remote.rkey, &full) < 0) {
+            return -1;
+        }
+        uint64_t full_ns = now_ns() - start;
+        if (verify_round(_ctx, sock_fd, cfg->size) < 0) {
+            return -1;
+        }
+        print_result("Full", ratio, full, full_ns);
+
+        // 增量同步（再修改同样比例的块，服务端此时与修改前的本地数据一致）
+        mutate_blocks(data, cfg->size, cfg->block_size, ratio, rng);
+        delta_stats delta;
+        memset(&delta, 0, sizeof(delta));
+        start = now_ns();
+        if (delta_sync(_ctx, data, cfg->size, cfg->block_size, local_fps, remote_fps, remote.addr, remote.rkey,
+                       nthreads, &delta) < 0) {
+            return -1;
+        }
+        uint64_t delta_ns = now_ns() - start;
+        if (verify_round(_ctx, sock_fd, cfg->size) < 0) {
+            return -1;
+        }
+        print_result("Delta", ratio, delta, delta_ns);
+    }
+
+    uint32_t cmd = DELTA_CMD_DONE;
+    if (sock_send_all(sock_fd, &cmd, sizeof(cmd)) < 0) {
+        std::cerr << "Failed to send command" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [size_mb] [block_kb]" << std::endl;
+        return -1;
+    }
+    delta_config cfg;
+    cfg.size = (uint64_t)(argc > 2 ? atoi(argv[2]) : 256) << 20;
+    cfg.block_size = (uint32_t)(argc > 3 ? atoi(argv[3]) : 4) << 10;
+    cfg.seed = 2024;
+    if (cfg.block_size == 0 || cfg.block_size > DELTA_MAX_RUN) {
+        std::cerr << "Invalid block size" << std::endl;
+        return -1;
+    }
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_client_delta(&ctx, sock_fd, &cfg);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -0,0 +1,138 @@
+#include "rdma_stripe.hpp"
+#include <random>
+
+/*
+    纠删码条带写基准测试
+
+    用法: ./rdma_client_ec <k> <m> <frag_kb> <total_mb> <ip:port> ... (共 k+m 个服务器)
+
+    1. 各级别编码内核的吞吐（按数据字节计算）；
+    2. 流水线深度为1（编码与写串行）和 STRIPE_PIPELINE（编码与写重叠）时的端到端写吞吐；
+    3. 抽样读回：无故障时直接读数据分片，再随机让m个服务器"失效"，从剩余服务器读回并重建，逐字节校验。
+*/
+
+void bench_encode(stripe_set *s) {
+    int k = s->k, m = s->m;
+    std::vector<uint8_t> parity_buf((size_t)m * s->frag_size);
+    uint8_t *parity[EC_MAX_FRAGS];
+    for (int i = 0; i < m; i++) {
+        parity[i] = parity_buf.data() + (size_t)i * s->frag_size;
+    }
+    for (int level = EC_SCALAR; level <= EC_AVX2; level++) {
+        const char *name;
+        ec_codec codec;
+        if (!ec_kernel((ec_level)level, &name) || ec_codec_init(&codec, k, m, (ec_level)level) < 0) {
+            continue;
+        }
+        // 标量版本太慢，只编码一部分块
+        uint64_t blocks = level == EC_SCALAR ? std::max<uint64_t>(s->nblocks / 16, 1) : s->nblocks;
+        uint64_t start = now_ns();
+        for (uint64_t b = 0; b < blocks; b++) {
+            const uint8_t *data[EC_MAX_FRAGS];
+            for (int j = 0; j < k; j++) {
+                data[j] = (const uint8_t *)stripe_block(s, b) + j * s->frag_size;
+            }
+            ec_encode(&codec, data, parity, s->frag_size);
+        }
+        double secs = (now_ns() - start) / 1e9;
+        std::cout << "Encode " << name << " (" << k << "+" << m << "): "
+                  << blocks * s->block_size / secs / 1e9 << " GB/s" << std::endl;
+    }
+}
+
+int bench_write(stripe_set *s, int depth) {
+    stripe_set_depth(s, depth);
+    s->encode_ns = 0;
+    uint64_t start = now_ns();
+    for (uint64_t b = 0; b < s->nblocks; b++) {
+        if (stripe_write_block(s, b) < 0) {
+            return -1;
+        }
+    }
+    if (stripe_flush(s) < 0) {
+        return -1;
+    }
+    uint64_t elapsed = now_ns() - start;
+    double bytes = (double)s->nblocks * s->block_size;
+    std::cout << "Write (depth " << depth << "): " << bytes / elapsed << " GB/s of data"
+              << ", " << bytes * (s->k + s->m) / s->k / elapsed << " GB/s on the wire"
+              << ", encoding " << 100.0 * s->encode_ns / elapsed << "% of the time" << std::endl;
+    return 0;
+}
+
+int verify_reads(stripe_set *s) {
+    int n = s->k + s->m;
+    std::mt19937 rng(7);
+    uint64_t step = std::max<uint64_t>(s->nblocks / 256, 1);
+    std::vector<double> normal, degraded;
+    for (uint64_t b = 0; b < s->nblocks; b += step) {
+        bool failed[EC_MAX_FRAGS] = {false};
+        for (int pass = 0; pass < 2; pass++) {
+            if (pass == 1) {
+                // 随机选m个服务器失效，数据分片优先，保证需要重建
+                for (int lost = 0; lost < s->m;) {
+                    int i = rng() % (lost == 0 ? s->k : n);
+                    if (!failed[i]) {
+                        failed[i] = true;
+                        lost++;
+                    }
+                }
+            }
+            uint64_t start = now_ns();
+            char *block = stripe_read_block(s, b, failed);
+            if (!block) {
+                return -1;
+            }
+            (pass == 0 ? normal : degraded).push_back((now_ns() - start) / 1000.0);
+            if (memcmp(block, stripe_block(s, b), s->block_size) != 0) {
+                std::cerr << "Block " << b << " mismatch" << (pass == 1 ? " after reconstruction" : "") << std::endl;
+                return -1;
+            }
+        }
+    }
+    print_latency_stats("Read (all servers)", normal);
+    print_latency_stats("Read (m servers lost)", degraded);
+    return 0;
+}
+
+int rdma_client_ec(stripe_set *s, int k, int m, size_t frag_size, uint64_t nblocks, const char *const *endpoints) {
+    if (stripe_init(s, k, m, frag_size, nblocks, endpoints, ec_best_level()) < 0) {
+        return -1;
+    }
+    std::mt19937_64 rng(42);
+    uint64_t *words = (uint64_t *)s->data;
+    for (size_t i = 0; i < nblocks * s->block_size / sizeof(uint64_t); i++) {
+        words[i] = rng();
+    }
+
+    bench_encode(s);
+    if (bench_write(s, 1) < 0 || bench_write(s, STRIPE_PIPELINE) < 0) {
+        return -1;
+    }
+    return verify_reads(s);
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 6) {
+        std::cerr << "Usage: " << argv[0] << " <k> <m> <frag_kb> <total_mb> <ip:port> ..." << std::endl;
+        return -1;
+    }
+    int k = atoi(argv[1]);
+    int m = atoi(argv[2]);
+    size_t frag_size = (size_t)atoi(argv[3]) << 10;
+    uint64_t total = (uint64_t)atoi(argv[4]) << 20;
+    if (k < 1 || m < 0 || frag_size == 0 || argc - 5 != k + m) {
+        std::cerr << "Need exactly k + m = " << k + m << " servers" << std::endl;
+        return -1;
+    }
+    uint64_t nblocks = std::max<uint64_t>(total / (frag_size * k), 1);
+
+    stripe_set s;
+    int ret = rdma_client_ec(&s, k, m, frag_size, nblocks, argv + 5);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+    stripe_free(&s);
+    return ret;
+}
@@ -0,0 +1,169 @@
+#include "rdma_farmem.hpp"
+#include <random>
+
+/*
+    远端内存页缓存基准测试：本地缓存远小于远端内存，对几种合成访问模式
+    输出命中率、预取命中、写回次数和平均访问延迟。
+*/
+
+enum farmem_pattern { PATTERN_SEQUENTIAL, PATTERN_STRIDED, PATTERN_RANDOM, PATTERN_HOTSET };
+
+struct farmem_workload {
+    const char *name;
+    farmem_pattern pattern;
+    double write_ratio;
+    bool prefetch;
+};
+
+int run_workload(farmem_cache *fc, const farmem_workload *w, uint64_t remote_size, uint64_t cache_size, uint64_t accesses) {
+    if (farmem_flush(fc) < 0) {
+        return -1;
+    }
+    // 每个负载都从冷缓存开始
+    qp_info remote_info;
+    remote_info.addr = fc->remote_addr;
+    remote_info.rkey = fc->rkey;
+    farmem_init(fc, fc->ctx, &remote_info, remote_size, fc->page_size, fc->nframes);
+    fc->prefetch_enabled = w->prefetch;
+
+    std::mt19937_64 rng(42);
+    uint64_t slots = remote_size / sizeof(uint64_t);
+    uint64_t hot_slots = cache_size / 2 / sizeof(uint64_t);   // 热点集合为缓存的一半
+    uint64_t stride = 3 * fc->page_size + 64;
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < accesses; i++) {
+        uint64_t addr;
+        switch (w->pattern) {
+        case PATTERN_SEQUENTIAL:
+            addr = (i * 64) % remote_size;
+            break;
+        case PATTERN_STRIDED:
+            addr = (i * stride) % (remote_size - sizeof(uint64_t));
+            addr &= ~(uint64_t)7;
+            break;
+        case PATTERN_RANDOM:
+            addr = (rng() % slots) * sizeof(uint64_t);
+            break;
+        default:
+            addr = (rng() % 10 == 0 ? rng() % slots : rng() % hot_slots) * sizeof(uint64_t);
+            break;
+        }
+        uint64_t v = i;
+        bool write = w->write_ratio > 0 && (rng() % 1000) < w->write_ratio * 1000;
+        int ret = write ? farmem_write(fc, addr, &v, sizeof(v)) : farmem_read(fc, addr, &v, sizeof(v));
+        if (ret < 0) {
+            return -1;
+        }
+    }
+    if (farmem_flush(fc) < 0) {
+        return -1;
+    }
+    double ns = (double)(now_ns() - start) / accesses;
+    const farmem_stats &st = fc->stats;
+    std::cout << w->name << " - hit rate: " << 100.0 * st.hits / st.accesses << "%"
+              << ", prefetch hits: " << st.prefetch_hits << "/" << st.prefetch_issued
+              << ", evictions: " << st.evictions
+              << ", write-backs: " << st.writebacks << " in " << st.writeback_batches << " batches"
+              << ", avg access: " << ns << " ns" << std::endl;
+    return 0;
+}
+
+// 写入每页页号，清空缓存后随机读回校验
+int verify(farmem_cache *fc, uint64_t remote_size) {
+    uint64_t pages = remote_size / fc->page_size;
+    for (uint64_t p = 0; p < pages; p++) {
+        if (farmem_write(fc, p * fc->page_size, &p, sizeof(p)) < 0) {
+            return -1;
+        }
+    }
+    if (farmem_flush(fc) < 0) {
+        return -1;
+    }
+    qp_info remote_info;
+    remote_info.addr = fc->remote_addr;
+    remote_info.rkey = fc->rkey;
+    farmem_init(fc, fc->ctx, &remote_info, remote_size, fc->page_size, fc->nframes);
+    std::mt19937_64 rng(7);
+    for (int i = 0; i < 10000; i++) {
+        uint64_t p = rng() % pages, v;
+        if (farmem_read(fc, p * fc->page_size, &v, sizeof(v)) < 0) {
+            return -1;
+        }
+        if (v != p) {
+            std::cerr << "Verification failed at page " << p << ": " << v << std::endl;
+            return -1;
+        }
+    }
+    std::cout << "Verification passed" << std::endl;
+    return 0;
+}
+
+int rdma_client_farmem(rdma_context *_ctx, int sock_fd, uint64_t cache_size, uint32_t page_size) {
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    if (rdma_alloc_resources(_ctx, cache_size, 2 * FARMEM_MAX_INFLIGHT, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, FARMEM_MAX_INFLIGHT, 1) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, sock_fd, &remote_qp_info, access) < 0) {
+        return -1;
+    }
+    uint64_t remote_size;
+    if (sock_recv_all(sock_fd, &remote_size, sizeof(remote_size)) < 0) {
+        std::cerr << "Failed to receive remote size" << std::endl;
+        return -1;
+    }
+    std::cout << "Remote memory: " << (remote_size >> 20) << " MB, local cache: " << (cache_size >> 20)
+              << " MB, page size: " << page_size << " bytes" << std::endl;
+
+    farmem_cache fc;
+    farmem_init(&fc, _ctx, &remote_qp_info, remote_size, page_size, (uint32_t)(cache_size / page_size));
+    if (verify(&fc, remote_size) < 0) {
+        return -1;
+    }
+
+    uint64_t accesses = 4 * remote_size / 64;
+    farmem_workload workloads[] = {
+        {"sequential (no prefetch)", PATTERN_SEQUENTIAL, 0, false},
+        {"sequential",               PATTERN_SEQUENTIAL, 0, true},
+        {"strided (no prefetch)",    PATTERN_STRIDED,    0, false},
+        {"strided",                  PATTERN_STRIDED,    0, true},
+        {"random 30% writes",        PATTERN_RANDOM,     0.3, true},
+        {"hot set 30% writes",       PATTERN_HOTSET,     0.3, true},
+    };
+    for (const farmem_workload &w : workloads) {
+        if (run_workload(&fc, &w, remote_size, cache_size, w.pattern == PATTERN_SEQUENTIAL ? accesses : accesses / 16) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [cache_mb] [page_kb]" << std::endl;
+        return -1;
+    }
+    uint64_t cache_size = (uint64_t)(argc > 2 ? atoi(argv[2]) : 64) << 20;
+    uint32_t page_size = (argc > 3 ? atoi(argv[3]) : 4) * 1024;
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_client_farmem(&ctx, sock_fd, cache_size, page_size);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -0,0 +1,207 @@
+#include "rdma_mpsc.hpp"
+#include <mutex>
+
+/*
+    多线程提交吞吐测试：1~max_threads 个生产者线程各自发送 ops 个 64 字节的RDMA_WRITE，
+    每个线程最多 MPSC_CLIENT_WINDOW 个操作在途，比较：
+      engine  无锁MPSC队列 + QP属主线程，批量post
+      mutex   所有线程共用一把锁保护 ibv_post_send 和 ibv_poll_cq，每个WR单独post并带完成通知
+*/
+
+#define MPSC_MSG_SIZE 64
+#define MPSC_CLIENT_WINDOW 16
+#define MPSC_MAX_THREADS 32
+
+/* 对照组：互斥锁保护的QP */
+struct mutex_qp {
+    rdma_context *ctx;
+    std::mutex lock;
+    int outstanding;
+};
+
+// 持锁时调用：轮询CQ并置位对应操作的完成标志
+void mutex_qp_poll(mutex_qp *mq) {
+    struct ibv_wc wc[32];
+    int n = ibv_poll_cq(mq->ctx->cq, 32, wc);
+    for (int i = 0; i < n; i++) {
+        mpsc_op *op = (mpsc_op *)wc[i].wr_id;
+        op->status = wc[i].status;
+        op->done.store(1, std::memory_order_release);
+        mq->outstanding--;
+    }
+}
+
+void mutex_qp_submit(mutex_qp *mq, mpsc_op *op) {
+    std::lock_guard<std::mutex> guard(mq->lock);
+    while (mq->outstanding >= MPSC_SQ_DEPTH) {
+        mutex_qp_poll(mq);
+    }
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)op->local_addr;
+    sge.length = op->length;
+    sge.lkey = op->lkey;
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = (uintptr_t)op;
+    wr.opcode = op->opcode;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = op->remote_addr;
+    wr.wr.rdma.rkey = op->rkey;
+    if (ibv_post_send(mq->ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post send request" << std::endl;
+        op->status = IBV_WC_GENERAL_ERR;
+        op->done.store(1, std::memory_order_release);
+        return;
+    }
+    mq->outstanding++;
+}
+
+// 等待自己的操作完成，期间抢到锁就顺便替其他线程轮询CQ
+int mutex_qp_wait(mutex_qp *mq, mpsc_op *op) {
+    uint32_t spins = 0;
+    while (!op->done.load(std::memory_order_acquire)) {
+        if (mq->lock.try_lock()) {
+            mutex_qp_poll(mq);
+            mq->lock.unlock();
+        } else {
+            mpsc_relax(&spins);
+        }
+    }
+    return op->status == IBV_WC_SUCCESS ? 0 : -1;
+}
+
+
+struct producer_args {
+    int id;
+    bool use_engine;
+    mpsc_engine *eng;
+    mutex_qp *mq;
+    rdma_context *ctx;
+    const qp_info *remote;
+    uint64_t ops;
+    int failed;
+};
+
+void producer_thread(producer_args *args) {
+    mpsc_op window[MPSC_CLIENT_WINDOW];
+    char *local = args->ctx->buffer + (size_t)args->id * MPSC_CLIENT_WINDOW * MPSC_MSG_SIZE;
+    uint64_t remote = args->remote->addr + (uint64_t)args->id * MPSC_CLIENT_WINDOW * MPSC_MSG_SIZE;
+    args->failed = 0;
+    for (uint64_t i = 0; i < args->ops; i++) {
+        int slot = (int)(i % MPSC_CLIENT_WINDOW);
+        mpsc_op *op = &window[slot];
+        if (i >= MPSC_CLIENT_WINDOW) {
+            // 槽位复用前等待上一轮的操作完成
+            int ret = args->use_engine ? mpsc_wait(op) : mutex_qp_wait(args->mq, op);
+            args->failed |= ret < 0;
+        }
+        mpsc_op_init(op, IBV_WR_RDMA_WRITE, local + slot * MPSC_MSG_SIZE, MPSC_MSG_SIZE, args->ctx->mr->lkey,
+                     remote + slot * MPSC_MSG_SIZE, args->remote->rkey);
+        if (args->use_engine) {
+            mpsc_submit(args->eng, op);
+        } else {
+            mutex_qp_submit(args->mq, op);
+        }
+    }
+    for (uint64_t i = 0; i < std::min<uint64_t>(args->ops, MPSC_CLIENT_WINDOW); i++) {
+        int ret = args->use_engine ? mpsc_wait(&window[i]) : mutex_qp_wait(args->mq, &window[i]);
+        args->failed |= ret < 0;
+    }
+}
+
+int run_producers(rdma_context *_ctx, const qp_info *remote, int nthreads, uint64_t ops, bool use_engine) {
+    mpsc_engine *eng = new mpsc_engine;
+    mutex_qp mq;
+    mq.ctx = _ctx;
+    mq.outstanding = 0;
+    if (use_engine) {
+        mpsc_engine_start(eng, _ctx);
+    }
+
+    std::vector<producer_args> args(nthreads);
+    std::vector<std::thread> threads;
+    uint64_t start = now_ns();
+    for (int i = 0; i < nthreads; i++) {
+        args[i].id = i;
+        args[i].use_engine = use_engine;
+        args[i].eng = eng;
+        args[i].mq = &mq;
+        args[i].ctx = _ctx;
+        args[i].remote = remote;
+        args[i].ops = ops;
+        threads.push_back(std::thread(producer_thread, &args[i]));
+    }
+    int failed = 0;
+    for (int i = 0; i < nthreads; i++) {
+        threads[i].join();
+        failed |= args[i].failed;
+    }
+    double secs = (now_ns() - start) / 1e9;
+
+    if (use_engine) {
+        mpsc_engine_stop(eng);
+    }
+    std::cout << (use_engine ? "engine" : "mutex ") << " - threads: " << nthreads
+              << ", msg/s: " << (uint64_t)(nthreads * ops / secs);
+    if (use_engine) {
+        std::cout << ", avg batch: " << (double)eng->ops / std::max<uint64_t>(eng->batches, 1);
+    }
+    std::cout << std::endl;
+    delete eng;
+    if (failed) {
+        std::cerr << "Some operations failed" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int rdma_client_mpsc(rdma_context *_ctx, int sock_fd, uint64_t ops, int max_threads) {
+    int access = IBV_ACCESS_LOCAL_WRITE;
+    size_t buf_size = (size_t)MPSC_MAX_THREADS * MPSC_CLIENT_WINDOW * MPSC_MSG_SIZE;
+    if (rdma_alloc_resources(_ctx, buf_size, MPSC_SQ_DEPTH, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, MPSC_SQ_DEPTH, 1) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, sock_fd, &remote_qp_info, access) < 0) {
+        return -1;
+    }
+    for (int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+        if (run_producers(_ctx, &remote_qp_info, nthreads, ops, false) < 0 ||
+            run_producers(_ctx, &remote_qp_info, nthreads, ops, true) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [ops_per_thread] [max_threads]" << std::endl;
+        return -1;
+    }
+    uint64_t ops = argc > 2 ? atoll(argv[2]) : 100000;
+    int max_threads = std::min(argc > 3 ? atoi(argv[3]) : MPSC_MAX_THREADS, MPSC_MAX_THREADS);
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_client_mpsc(&ctx, sock_fd, ops, max_threads);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
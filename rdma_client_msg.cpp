@@ -0,0 +1,104 @@
+#include "rdma_msg.hpp"
+
+struct msg_bench_config {
+    uint64_t min_size;
+    uint64_t max_size;
+    uint32_t iters;
+    uint32_t frag_size;
+    uint32_t zero_copy;
+};
+
+int rdma_client_msg(rdma_context *_ctx, int sock_fd, const msg_bench_config *cfg) {
+    if (sock_send_all(sock_fd, cfg, sizeof(*cfg)) < 0) {
+        std::cerr << "Failed to send benchmark config" << std::endl;
+        return -1;
+    }
+
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE;
+    if (rdma_alloc_resources(_ctx, msg_buffer_size(cfg->frag_size), 4 * MSG_WINDOW, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, 2 * MSG_WINDOW, MSG_WINDOW, 2, sizeof(uint64_t)) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, sock_fd, &remote_qp_info, access) < 0) {
+        return -1;
+    }
+    msg_channel ch;
+    msg_channel_init(&ch, _ctx, cfg->frag_size);
+    msg_channel_set_remote(&ch, &remote_qp_info);
+
+    char *src = (char *)malloc(cfg->max_size);
+    if (!src) {
+        std::cerr << "Failed to allocate source buffer" << std::endl;
+        return -1;
+    }
+    struct ibv_mr *src_mr = NULL;
+    if (cfg->zero_copy) {
+        src_mr = ibv_reg_mr(_ctx->pd, src, cfg->max_size, IBV_ACCESS_LOCAL_WRITE);
+        if (!src_mr) {
+            std::cerr << "Failed to register source buffer" << std::endl;
+            free(src);
+            return -1;
+        }
+    }
+
+    int ret = 0;
+    for (uint64_t size = cfg->min_size; size <= cfg->max_size && ret == 0; size *= 4) {
+        uint64_t start = now_ns();
+        for (uint32_t i = 0; i < cfg->iters && ret == 0; i++) {
+            // 首尾字节写入序号，供服务端校验
+            src[0] = (char)i;
+            src[size - 1] = (char)i;
+            ret = msg_send(&ch, src, size, src_mr);
+        }
+        char ack = 0;
+        if (ret == 0 && (sock_recv_all(sock_fd, &ack, 1) < 0 || ack != 1)) {
+            std::cerr << "Server reported a corrupted message" << std::endl;
+            ret = -1;
+        }
+        if (ret == 0) {
+            double secs = (now_ns() - start) / 1e9;
+            std::cout << "Size " << size << " bytes: "
+                      << (double)size * cfg->iters / secs / 1e9 << " GB/s" << std::endl;
+        }
+    }
+
+    if (src_mr) {
+        ibv_dereg_mr(src_mr);
+    }
+    free(src);
+    return ret;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [max_size_mb] [iters] [frag_kb] [--copy]" << std::endl;
+        return -1;
+    }
+    msg_bench_config cfg;
+    cfg.min_size = 1 << 20;
+    cfg.max_size = (uint64_t)(argc > 2 ? atoi(argv[2]) : 1024) << 20;
+    cfg.iters = argc > 3 ? atoi(argv[3]) : 4;
+    cfg.frag_size = argc > 4 ? atoi(argv[4]) * 1024 : MSG_DEFAULT_FRAG;
+    cfg.zero_copy = !(argc > 5 && strcmp(argv[5], "--copy") == 0);
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_client_msg(&ctx, sock_fd, &cfg);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -0,0 +1,184 @@
+#include "rdma_mw.hpp"
+
+/*
+    内存窗口授权客户端：循环 请求授权 -> RDMA_WRITE 到授权区间 -> SEND_WITH_INV 撤销，
+    输出每轮的延迟；最后用已撤销的rkey再写一次，确认被对端拒绝（IBV_WC_REM_ACCESS_ERR）。
+*/
+
+#define MW_CLIENT_DATA_SIZE (64 << 10)
+
+int wait_completion(rdma_context *_ctx, struct ibv_wc *wc) {
+    while (true) {
+        int n = ibv_poll_cq(_ctx->cq, 1, wc);
+        if (n < 0) {
+            std::cerr << "Failed to poll CQ" << std::endl;
+            return -1;
+        }
+        if (n == 1) {
+            return 0;
+        }
+    }
+}
+
+int post_send_wr(rdma_context *_ctx, enum ibv_wr_opcode opcode, char *buf, uint32_t len,
+                 uint64_t remote_addr, uint32_t rkey, uint32_t invalidate_rkey) {
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)buf;
+    sge.length = len;
+    sge.lkey = _ctx->mr->lkey;
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.opcode = opcode;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = remote_addr;
+    wr.wr.rdma.rkey = rkey;
+    if (opcode == IBV_WR_SEND_WITH_INV) {
+        wr.invalidate_rkey = invalidate_rkey;
+    }
+    if (ibv_post_send(_ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post send request" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 发送一个控制消息，invalidate_rkey非0时用SEND_WITH_INV同时撤销该rkey
+int send_request(rdma_context *_ctx, char *buf, const mw_request *req, uint32_t invalidate_rkey) {
+    memcpy(buf, req, sizeof(*req));
+    enum ibv_wr_opcode opcode = invalidate_rkey ? IBV_WR_SEND_WITH_INV : IBV_WR_SEND;
+    return post_send_wr(_ctx, opcode, buf, sizeof(*req), 0, 0, invalidate_rkey);
+}
+
+int post_reply_recv(rdma_context *_ctx, char *buf) {
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)buf;
+    sge.length = sizeof(mw_reply);
+    sge.lkey = _ctx->mr->lkey;
+    struct ibv_recv_wr recv_wr, *bad_recv_wr;
+    memset(&recv_wr, 0, sizeof(recv_wr));
+    recv_wr.sg_list = &sge;
+    recv_wr.num_sge = 1;
+    if (ibv_post_recv(_ctx->qp, &recv_wr, &bad_recv_wr)) {
+        std::cerr << "Failed to post receive request" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 等待count个完成，任何一个失败都返回-1
+int wait_all(rdma_context *_ctx, int count) {
+    struct ibv_wc wc;
+    for (int i = 0; i < count; i++) {
+        if (wait_completion(_ctx, &wc) < 0) {
+            return -1;
+        }
+        if (wc.status != IBV_WC_SUCCESS) {
+            std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc.status) << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int rdma_client_mw(rdma_context *_ctx, int sock_fd, int rounds) {
+    int access = IBV_ACCESS_LOCAL_WRITE;
+    if (rdma_alloc_resources(_ctx, MW_CLIENT_DATA_SIZE + 2 * sizeof(mw_request), 16, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, 8, 8) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, sock_fd, &remote_qp_info, access) < 0) {
+        return -1;
+    }
+    char ready;
+    if (sock_recv_all(sock_fd, &ready, 1) < 0) {
+        std::cerr << "Server not ready" << std::endl;
+        return -1;
+    }
+    char *data = _ctx->buffer;
+    char *req_buf = data + MW_CLIENT_DATA_SIZE;
+    char *reply_buf = req_buf + sizeof(mw_request);
+    memset(data, 'x', MW_CLIENT_DATA_SIZE);
+
+    std::vector<double> cycle_us;
+    mw_reply reply;
+    memset(&reply, 0, sizeof(reply));
+    for (int i = 0; i < rounds; i++) {
+        uint64_t start = now_ns();
+        mw_request req;
+        req.type = MW_REQ_GRANT;
+        req.access = IBV_ACCESS_REMOTE_WRITE;
+        req.offset = (uint64_t)i * MW_CLIENT_DATA_SIZE % (32 << 20);
+        req.length = MW_CLIENT_DATA_SIZE;
+        if (post_reply_recv(_ctx, reply_buf) < 0 || send_request(_ctx, req_buf, &req, 0) < 0 ||
+            wait_all(_ctx, 2) < 0) {
+            return -1;
+        }
+        memcpy(&reply, reply_buf, sizeof(reply));
+        if (reply.status != 0) {
+            std::cerr << "Grant rejected by server" << std::endl;
+            return -1;
+        }
+        if (post_send_wr(_ctx, IBV_WR_RDMA_WRITE, data, MW_CLIENT_DATA_SIZE, reply.addr, reply.rkey, 0) < 0 ||
+            wait_all(_ctx, 1) < 0) {
+            return -1;
+        }
+        // 用完后通过SEND_WITH_INV让对端网卡撤销这个rkey
+        req.type = MW_REQ_RELEASE;
+        if (send_request(_ctx, req_buf, &req, reply.rkey) < 0 || wait_all(_ctx, 1) < 0) {
+            return -1;
+        }
+        cycle_us.push_back((now_ns() - start) / 1000.0);
+    }
+    print_latency_stats("Grant + write + revoke", cycle_us);
+
+    mw_request done;
+    memset(&done, 0, sizeof(done));
+    done.type = MW_REQ_DONE;
+    if (send_request(_ctx, req_buf, &done, 0) < 0 || wait_all(_ctx, 1) < 0) {
+        return -1;
+    }
+
+    // 撤销后的rkey必须被拒绝（QP随之进入ERROR，因此放在最后）
+    struct ibv_wc wc;
+    if (post_send_wr(_ctx, IBV_WR_RDMA_WRITE, data, 64, reply.addr, reply.rkey, 0) < 0 ||
+        wait_completion(_ctx, &wc) < 0) {
+        return -1;
+    }
+    if (wc.status == IBV_WC_SUCCESS) {
+        std::cerr << "Write with revoked rkey unexpectedly succeeded" << std::endl;
+        return -1;
+    }
+    std::cout << "Write with revoked rkey rejected: " << ibv_wc_status_str(wc.status) << std::endl;
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [rounds]" << std::endl;
+        return -1;
+    }
+    int rounds = argc > 2 ? atoi(argv[2]) : 1000;
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_client_mw(&ctx, sock_fd, rounds);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -0,0 +1,115 @@
+#include "rdma_proto.hpp"
+
+/*
+    协议选择基准测试
+
+    用法: ./rdma_client_proto <server_ip> [max_kb]
+
+    先用 proto_calibrate 测出内联/eager和eager/rendezvous的切换点，再对8B到max_kb的每个长度
+    分别强制使用三种协议和自动选择做乒乓，输出单程延迟（微秒）。某种协议不适用的长度
+    （超过内联上限或eager缓冲区大小）显示为"-"。自动选择的结果应在每个长度上都接近三者中的最小值。
+*/
+
+#define CALIBRATE_ROUNDS 200
+
+int rounds_for(uint32_t len) {
+    return (int)std::max<uint64_t>(20, std::min<uint64_t>(2000, (64ull << 20) / len));
+}
+
+int rdma_client_proto(rdma_context *_ctx, int sock_fd, uint32_t max_size) {
+    if (sock_send_all(sock_fd, &max_size, sizeof(max_size)) < 0) {
+        std::cerr << "Failed to send config" << std::endl;
+        return -1;
+    }
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ;
+    if (rdma_alloc_resources(_ctx, PROTO_RESERVED_SIZE + 2 * (size_t)max_size, PROTO_CQ_DEPTH, access) < 0) {
+        return -1;
+    }
+    if (proto_create_qp(_ctx) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, sock_fd, &remote_qp_info, access) < 0) {
+        return -1;
+    }
+    proto_channel ch;
+    if (proto_channel_init(&ch, _ctx) < 0 || proto_handshake(sock_fd) < 0) {
+        return -1;
+    }
+    char *sbuf = _ctx->buffer + PROTO_RESERVED_SIZE;
+    char *rbuf = sbuf + max_size;
+    for (uint32_t i = 0; i < max_size; i++) {
+        sbuf[i] = (char)i;
+    }
+
+    uint64_t start = now_ns();
+    if (proto_calibrate(&ch, sbuf, rbuf, CALIBRATE_ROUNDS) < 0) {
+        return -1;
+    }
+    std::cout << "Calibration took " << (now_ns() - start) / 1000000 << " ms: inline <= " << ch.inline_max
+              << " B (cap " << ch.inline_cap << "), rendezvous >= " << ch.rndv_min << " B" << std::endl;
+
+    for (uint32_t len = 8; len <= max_size; len *= 2) {
+        int rounds = rounds_for(len);
+        double t[3];
+        for (int proto = PROTO_INLINE; proto <= PROTO_RNDV; proto++) {
+            bool usable = (proto != PROTO_INLINE || len <= ch.inline_cap) && (proto != PROTO_EAGER || len <= PROTO_EAGER_MAX);
+            t[proto] = usable ? proto_pingpong(&ch, sbuf, rbuf, len, proto, rounds) : 0;
+            if (t[proto] < 0) {
+                return -1;
+            }
+        }
+        double t_auto = proto_pingpong(&ch, sbuf, rbuf, len, PROTO_AUTO, rounds);
+        if (t_auto < 0) {
+            return -1;
+        }
+        if (memcmp(sbuf, rbuf, len) != 0) {
+            std::cerr << "Echo mismatch at size " << len << std::endl;
+            return -1;
+        }
+        int chosen = len <= ch.inline_max ? PROTO_INLINE : (len < ch.rndv_min ? PROTO_EAGER : PROTO_RNDV);
+        std::cout << len << " B:";
+        for (int proto = PROTO_INLINE; proto <= PROTO_RNDV; proto++) {
+            std::cout << " " << proto_name(proto) << " ";
+            if (t[proto] > 0) {
+                std::cout << t[proto] << " us,";
+            } else {
+                std::cout << "-,";
+            }
+        }
+        std::cout << " auto " << t_auto << " us (" << proto_name(chosen) << ", " << len / t_auto << " MB/s)" << std::endl;
+    }
+
+    // 长度为0的消息通知服务端结束
+    return proto_send_as(&ch, sbuf, 0, PROTO_EAGER);
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [max_kb]" << std::endl;
+        return -1;
+    }
+    uint32_t max_size = (uint32_t)(argc > 2 ? atoi(argv[2]) : 4096) << 10;
+    if (max_size < 8 || max_size > (1u << 30)) {
+        std::cerr << "Invalid max size" << std::endl;
+        return -1;
+    }
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_client_proto(&ctx, sock_fd, max_size);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -0,0 +1,174 @@
+#include "rdma_qos.hpp"
+
+/*
+    QoS基准测试
+
+    用法: ./rdma_client_qos <server_ip> [ctrl_msgs] [bulk_rate_mbps]
+
+    大流量不停地写4MB块（始终保持 BULK_DEPTH 个操作未完成），同时每 CTRL_GAP_US 微秒发一个64字节的控制写，
+    统计控制消息从提交到完成的延迟分布和大流量的吞吐：
+      - idle：没有大流量，作为基线；
+      - fifo：所有操作按提交顺序post到同一个SL 0的QP（原来的做法）；
+      - qos：控制类和大流量类各用一个QP（不同的SL），DRR调度，大流量在网卡中最多排队 BULK_INFLIGHT 字节；
+      - qos + limit：在qos基础上给大流量限速（指定 bulk_rate_mbps 时）。
+*/
+
+#define BULK_SIZE (4 << 20)
+#define BULK_DEPTH 8
+#define BULK_INFLIGHT (1 << 20)
+#define CTRL_SIZE 64
+#define CTRL_GAP_US 50
+#define CTRL_REMOTE_OFFSET (48 << 20)       // 控制消息写到对端缓冲区的这个位置之后
+#define CTRL_USER_ID 0x43000000ull
+
+enum qos_class_id { CLASS_FIFO = 0, CLASS_CTRL = 1, CLASS_BULK = 2 };
+
+struct qos_run {
+    const char *name;
+    bool bulk;
+    int ctrl_flow;
+    int bulk_flow;
+};
+
+int run_mode(qos_sched *s, const qos_run *run, const qp_info *remote, uint32_t ctrl_msgs) {
+    char *bulk_src = s->ctx->buffer;
+    char *ctrl_src = s->ctx->buffer + BULK_SIZE;
+    uint32_t lkey = s->ctx->mr->lkey;
+    std::vector<double> samples;
+    uint64_t bulk_ops = 0, bulk_bytes = 0;
+    int bulk_outstanding = 0;
+    uint32_t ctrl_sent = 0;
+    qos_completion done[32];
+
+    uint64_t start = now_ns();
+    uint64_t next_ctrl = start;
+    while (samples.size() < ctrl_msgs) {
+        while (run->bulk && bulk_outstanding < BULK_DEPTH) {
+            uint64_t remote_addr = remote->addr + (bulk_ops % BULK_DEPTH) * (uint64_t)BULK_SIZE;
+            qos_submit(s, run->bulk_flow, IBV_WR_RDMA_WRITE, bulk_src, lkey, BULK_SIZE, remote_addr, remote->rkey, bulk_ops);
+            bulk_ops++;
+            bulk_outstanding++;
+        }
+        uint64_t now = now_ns();
+        if (ctrl_sent < ctrl_msgs && now >= next_ctrl) {
+            uint64_t remote_addr = remote->addr + CTRL_REMOTE_OFFSET + (ctrl_sent % 1024) * CTRL_SIZE;
+            qos_submit(s, run->ctrl_flow, IBV_WR_RDMA_WRITE, ctrl_src, lkey, CTRL_SIZE, remote_addr, remote->rkey,
+                       CTRL_USER_ID | ctrl_sent);
+            ctrl_sent++;
+            next_ctrl += CTRL_GAP_US * 1000;
+        }
+        if (qos_dispatch(s) < 0) {
+            return -1;
+        }
+        int n = qos_progress(s, done, 32);
+        if (n < 0) {
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (done[i].status != IBV_WC_SUCCESS) {
+                return -1;
+            }
+            if ((done[i].user_id & 0xff000000ull) == CTRL_USER_ID) {
+                samples.push_back((done[i].complete_ns - done[i].enqueue_ns) / 1000.0);
+            } else {
+                bulk_outstanding--;
+                bulk_bytes += BULK_SIZE;
+            }
+        }
+    }
+    double secs = (now_ns() - start) / 1e9;
+
+    // 等待剩余的大流量完成，不计入吞吐
+    while (!qos_idle(s)) {
+        if (qos_dispatch(s) < 0 || qos_progress(s, done, 32) < 0) {
+            return -1;
+        }
+    }
+    std::string label = std::string("Control latency (") + run->name + ")";
+    print_latency_stats(label.c_str(), samples);
+    if (run->bulk) {
+        std::cout << "Bulk throughput (" << run->name << "): " << bulk_bytes / secs / 1e9 << " GB/s" << std::endl;
+    }
+    return 0;
+}
+
+int rdma_client_qos(rdma_context *_ctx, int sock_fd, uint32_t ctrl_msgs, uint32_t bulk_rate_mbps, qos_sched *s) {
+    // 控制类用DSCP 46 (EF)，大流量类用DSCP 10 (AF11)
+    qos_class_config classes[3] = {
+        {"fifo", 0, 0, 1, 0, 0},
+        {"control", 1, 46 << 2, 4, 0, 0},
+        {"bulk", 0, 10 << 2, 1, 0, BULK_INFLIGHT},
+    };
+    uint32_t nclasses = 3;
+    qos_wire_class wire[3];
+    for (uint32_t i = 0; i < nclasses; i++) {
+        wire[i].sl = classes[i].sl;
+        wire[i].traffic_class = classes[i].traffic_class;
+    }
+    if (sock_send_all(sock_fd, &nclasses, sizeof(nclasses)) < 0 ||
+        sock_send_all(sock_fd, wire, sizeof(wire)) < 0) {
+        std::cerr << "Failed to send classes" << std::endl;
+        return -1;
+    }
+
+    int access = IBV_ACCESS_LOCAL_WRITE;
+    if (rdma_alloc_resources(_ctx, BULK_SIZE + CTRL_SIZE, 2 * 3 * QOS_SQ_DEPTH, access) < 0) {
+        return -1;
+    }
+    qos_init(s, _ctx, classes, nclasses);
+    qp_info remote;
+    for (uint32_t i = 0; i < nclasses; i++) {
+        if (qos_add_flow(s, (int)i, sock_fd, &remote, access) < 0) {
+            return -1;
+        }
+    }
+
+    qos_run runs[] = {
+        {"idle", false, CLASS_CTRL, CLASS_BULK},
+        {"fifo", true, CLASS_FIFO, CLASS_FIFO},
+        {"qos", true, CLASS_CTRL, CLASS_BULK},
+    };
+    for (const qos_run &run : runs) {
+        if (run_mode(s, &run, &remote, ctrl_msgs) < 0) {
+            return -1;
+        }
+    }
+    if (bulk_rate_mbps) {
+        qos_set_rate(s, CLASS_BULK, bulk_rate_mbps);
+        qos_run limited = {"qos + limit", true, CLASS_CTRL, CLASS_BULK};
+        if (run_mode(s, &limited, &remote, ctrl_msgs) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [ctrl_msgs] [bulk_rate_mbps]" << std::endl;
+        return -1;
+    }
+    uint32_t ctrl_msgs = argc > 2 ? atoi(argv[2]) : 20000;
+    uint32_t bulk_rate_mbps = argc > 3 ? atoi(argv[3]) : 0;
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    qos_sched sched;
+    sched.ctx = &ctx;
+    int ret = rdma_client_qos(&ctx, sock_fd, ctrl_msgs, bulk_rate_mbps, &sched);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    qos_free(&sched);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -0,0 +1,141 @@
+#include "rdma_recovery.hpp"
+
+/*
+    QP恢复测试：持续向服务端的 RECOVERY_BLOCKS 个块发送 4KB 的RDMA_WRITE（最多 RECOVERY_WINDOW 个在途），
+    每 fault_every 个操作注入一次故障：
+      默认          post一个rkey错误的RDMA_WRITE，对端返回远程访问错误
+      --local-fault 直接把本端QP切到ERROR
+    结束后RDMA_READ读回所有块，校验每块都是最后一次写入的内容（验证重放的正确性），
+    并输出故障切换时间的分布。
+*/
+
+#define RECOVERY_BLOCK_SIZE 4096
+#define RECOVERY_BLOCKS 256
+#define RECOVERY_WINDOW 16
+
+// 第id次写入的内容：整块填充id
+void fill_block(char *buf, uint64_t id) {
+    uint64_t *p = (uint64_t *)buf;
+    for (size_t i = 0; i < RECOVERY_BLOCK_SIZE / sizeof(uint64_t); i++) {
+        p[i] = id;
+    }
+}
+
+int verify_blocks(recov_channel *ch, char *readback, uint64_t total_ops) {
+    for (int b = 0; b < RECOVERY_BLOCKS; b++) {
+        if (recov_post(ch, IBV_WR_RDMA_READ, b, readback + (size_t)b * RECOVERY_BLOCK_SIZE, RECOVERY_BLOCK_SIZE,
+                       ch->remote.addr + (uint64_t)b * RECOVERY_BLOCK_SIZE, ch->remote.rkey) < 0) {
+            return -1;
+        }
+        while (ch->inflight.size() >= RECOVERY_WINDOW) {
+            if (recov_progress(ch) < 0) {
+                return -1;
+            }
+        }
+    }
+    while (!ch->inflight.empty()) {
+        if (recov_progress(ch) < 0) {
+            return -1;
+        }
+    }
+    for (uint64_t b = 0; b < RECOVERY_BLOCKS && b < total_ops; b++) {
+        // 写入块b的最后一个操作编号
+        uint64_t last = b + (total_ops - 1 - b) / RECOVERY_BLOCKS * RECOVERY_BLOCKS;
+        const uint64_t *p = (const uint64_t *)(readback + b * RECOVERY_BLOCK_SIZE);
+        for (size_t i = 0; i < RECOVERY_BLOCK_SIZE / sizeof(uint64_t); i++) {
+            if (p[i] != last) {
+                std::cerr << "Block " << b << " mismatch: got " << p[i] << ", expected " << last << std::endl;
+                return -1;
+            }
+        }
+    }
+    std::cout << "Verification passed" << std::endl;
+    return 0;
+}
+
+int rdma_client_recovery(rdma_context *_ctx, int sock_fd, uint64_t total_ops, uint64_t fault_every, bool local_fault) {
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    size_t buf_size = (size_t)(RECOVERY_WINDOW + 1 + RECOVERY_BLOCKS) * RECOVERY_BLOCK_SIZE;
+    if (rdma_alloc_resources(_ctx, buf_size, 4 * RECOVERY_WINDOW, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, 2 * RECOVERY_WINDOW, 1) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, sock_fd, &remote_qp_info, access) < 0 || recov_async_nonblock(_ctx) < 0) {
+        return -1;
+    }
+    char *slots = _ctx->buffer;
+    char *fault_buf = slots + (size_t)RECOVERY_WINDOW * RECOVERY_BLOCK_SIZE;
+    char *readback = fault_buf + RECOVERY_BLOCK_SIZE;
+
+    recov_channel ch;
+    recov_channel_init(&ch, _ctx, sock_fd, access, &remote_qp_info);
+    uint64_t start = now_ns();
+    for (uint64_t id = 0; id < total_ops; id++) {
+        // 槽位 id % WINDOW 在上一个使用者完成（或重放完成）之前不能覆盖
+        while (ch.inflight.size() >= RECOVERY_WINDOW) {
+            if (recov_progress(&ch) < 0) {
+                return -1;
+            }
+        }
+        char *slot = slots + (id % RECOVERY_WINDOW) * RECOVERY_BLOCK_SIZE;
+        fill_block(slot, id);
+        uint64_t remote = remote_qp_info.addr + (id % RECOVERY_BLOCKS) * RECOVERY_BLOCK_SIZE;
+        if (recov_post(&ch, IBV_WR_RDMA_WRITE, id, slot, RECOVERY_BLOCK_SIZE, remote, remote_qp_info.rkey) < 0) {
+            return -1;
+        }
+        if (fault_every > 0 && id % fault_every == fault_every - 1) {
+            if (recov_inject_fault(&ch, !local_fault, fault_buf, RECOVERY_BLOCK_SIZE) < 0) {
+                return -1;
+            }
+        }
+    }
+    while (!ch.inflight.empty()) {
+        if (recov_progress(&ch) < 0) {
+            return -1;
+        }
+    }
+    double secs = (now_ns() - start) / 1e9;
+    std::cout << "Ops: " << total_ops << ", completed: " << ch.completed << ", recoveries: " << ch.recoveries
+              << ", flushed: " << ch.flushed << ", replayed: " << ch.replayed << ", failed: " << ch.failed.size()
+              << ", throughput: " << (uint64_t)(total_ops / secs) << " ops/s" << std::endl;
+    print_latency_stats("Failover time", ch.failover_us);
+    if (!ch.failed.empty()) {
+        std::cerr << "Some operations could not be replayed" << std::endl;
+        return -1;
+    }
+    return verify_blocks(&ch, readback, total_ops);
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [ops] [fault_every] [--local-fault]" << std::endl;
+        return -1;
+    }
+    bool local_fault = strcmp(argv[argc - 1], "--local-fault") == 0;
+    if (local_fault) {
+        argc--;
+    }
+    uint64_t total_ops = argc > 2 ? atoll(argv[2]) : 100000;
+    uint64_t fault_every = argc > 3 ? atoll(argv[3]) : 1000;
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_client_recovery(&ctx, sock_fd, total_ops, fault_every, local_fault);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(sock_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
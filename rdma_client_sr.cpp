@@ -141,10 +141,28 @@ void init_client(rdma_context *ctx) {
     ibv_modify_qp(ctx->qp, &mod_attr, IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN | IBV_QP_MAX_QP_RD_ATOMIC);
 
     // 发送消息到服务器
+    // 收发使用缓冲区的两半，这样可以在发送Ping之前就post好Pong的接收请求，
+    // 避免服务端的Pong先于接收请求到达而依赖RNR重试
+    char *recv_buffer = ctx->buffer + BUFFER_SIZE / 2;
+    struct ibv_sge recv_sge;
+    recv_sge.addr = (uintptr_t)recv_buffer;
+    recv_sge.length = BUFFER_SIZE / 2;
+    recv_sge.lkey = ctx->mr->lkey;
+
+    struct ibv_recv_wr recv_wr, *bad_recv_wr;
+    memset(&recv_wr, 0, sizeof(recv_wr));
+    recv_wr.sg_list = &recv_sge;
+    recv_wr.num_sge = 1;
+
+    if (ibv_post_recv(ctx->qp, &recv_wr, &bad_recv_wr)) {
+        perror("Failed to post receive request");
+        exit(EXIT_FAILURE);
+    }
+
     strcpy(ctx->buffer, "Ping");        //将字符串 "Ping" 复制到发送缓冲区中
     struct ibv_sge sge;  //散列表项 (SGL)
     sge.addr = (uintptr_t)ctx->buffer;  //发送数据缓冲区的地址
-    sge.length = BUFFER_SIZE;
+    sge.length = strlen(ctx->buffer) + 1;   //只发送有效数据
     sge.lkey = ctx->mr->lkey;           //内存密钥
 
     struct ibv_send_wr send_wr, *bad_send_wr;  //发送请求 (WR)
@@ -174,19 +192,9 @@ void init_client(rdma_context *ctx) {
     }
 
     // 接收服务器响应
-    struct ibv_recv_wr recv_wr, *bad_recv_wr;
-    memset(&recv_wr, 0, sizeof(recv_wr));
-    recv_wr.sg_list = &sge;
-    recv_wr.num_sge = 1;
-
-    if (ibv_post_recv(ctx->qp, &recv_wr, &bad_recv_wr)) {
-        perror("Failed to post receive request");
-        exit(EXIT_FAILURE);
-    }
-
     while (ibv_poll_cq(ctx->cq, 1, &wc) == 0);
     if (wc.status == IBV_WC_SUCCESS) {
-        std::cout << "Received response: " << ctx->buffer << std::endl;
+        std::cout << "Received response: " << recv_buffer << std::endl;
     } else {
         std::cerr << "Receive failed with status " << wc.status << std::endl;
     }
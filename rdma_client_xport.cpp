@@ -0,0 +1,155 @@
+#include "rdma_xport.hpp"
+
+/*
+    RDMA与io_uring TCP传输的对比测试
+
+    用法: ./rdma_client_xport <server_ip> [auto|rdma|tcp] [max_kb]
+
+    通过统一的xport接口依次测试：
+      1. 正确性：写一段数据到远端再读回比较；
+      2. 延迟：8B / 4KB / 64KB 的单边写、单边读和双边消息回显（往返）；
+      3. 带宽：4KB / 64KB / max_kb 的单边写和读，保持 XPORT_WINDOW 个操作在途。
+    分别以rdma和tcp运行即可比较两种传输。
+*/
+
+#define XPORT_MSG_MAX (64 * 1024)
+#define XPORT_WINDOW 16
+#define LATENCY_ITERS 1000
+#define BANDWIDTH_BYTES (256ull << 20)
+
+int check_roundtrip(xport *x, uint64_t msg_off) {
+    uint32_t len = XPORT_MSG_MAX;
+    for (uint32_t i = 0; i < len; i++) {
+        x->buffer[i] = (char)(i * 7 + 3);
+    }
+    memset(x->buffer + msg_off, 0, len);
+    if (xport_post(x, XPORT_WRITE, 0, 0, len, 1) < 0 || xport_post(x, XPORT_READ, msg_off, 0, len, 2) < 0 ||
+        xport_wait(x, 2) < 0) {
+        return -1;
+    }
+    if (memcmp(x->buffer, x->buffer + msg_off, len) != 0) {
+        std::cerr << "Read back data does not match" << std::endl;
+        return -1;
+    }
+    std::cout << "Write / read back check passed" << std::endl;
+    return 0;
+}
+
+int measure_latency(xport *x, uint32_t len, uint64_t msg_off) {
+    const char *names[] = {"write", "read", "send echo"};
+    for (int op = XPORT_WRITE; op <= XPORT_SEND; op++) {
+        std::vector<double> samples;
+        for (int i = 0; i < LATENCY_ITERS + 100; i++) {
+            uint64_t start = now_ns();
+            if (xport_post(x, op, 0, 0, len, i) < 0 || xport_wait(x, 1) < 0) {
+                return -1;
+            }
+            if (op == XPORT_SEND && xport_recv(x, msg_off, XPORT_MSG_MAX) < 0) {
+                return -1;
+            }
+            if (i >= 100) {     // 前100次预热
+                samples.push_back((now_ns() - start) / 1000.0);
+            }
+        }
+        std::string label = std::string(names[op]) + " " + std::to_string(len) + " B";
+        print_latency_stats(label.c_str(), samples);
+    }
+    return 0;
+}
+
+int measure_bandwidth(xport *x, uint32_t len) {
+    uint64_t total_ops = std::max<uint64_t>(BANDWIDTH_BYTES / len, 4 * XPORT_WINDOW);
+    const char *names[] = {"write", "read"};
+    for (int op = XPORT_WRITE; op <= XPORT_READ; op++) {
+        uint64_t posted = 0, completed = 0;
+        uint64_t start = now_ns();
+        while (completed < total_ops) {
+            while (posted < total_ops && posted - completed < XPORT_WINDOW) {
+                if (xport_post(x, op, 0, 0, len, posted) < 0) {
+                    return -1;
+                }
+                posted++;
+            }
+            uint64_t wr_ids[XPORT_WINDOW];
+            int got = xport_poll(x, wr_ids, XPORT_WINDOW);
+            if (got < 0) {
+                return -1;
+            }
+            completed += got;
+        }
+        double secs = (now_ns() - start) / 1e9;
+        std::cout << names[op] << " " << len << " B: " << total_ops * len / secs / 1e9 << " GB/s, "
+                  << total_ops / secs / 1e3 << " Kops/s" << std::endl;
+    }
+    return 0;
+}
+
+int rdma_client_xport(xport *x, int sock_fd, int want, uint64_t max_size) {
+    if (sock_send_all(sock_fd, &max_size, sizeof(max_size)) < 0) {
+        std::cerr << "Failed to send config" << std::endl;
+        return -1;
+    }
+    if (xport_open(x, sock_fd, max_size + XPORT_MSG_MAX, want) < 0) {
+        return -1;
+    }
+    std::cout << "Transport: " << xport_name(x->kind) << std::endl;
+    uint64_t msg_off = max_size;
+    if (check_roundtrip(x, msg_off) < 0) {
+        return -1;
+    }
+
+    uint32_t lat_sizes[] = {8, 4096, XPORT_MSG_MAX};
+    for (uint32_t len : lat_sizes) {
+        if (measure_latency(x, len, msg_off) < 0) {
+            return -1;
+        }
+    }
+    uint32_t bw_sizes[] = {4096, XPORT_MSG_MAX, (uint32_t)max_size};
+    for (uint32_t len : bw_sizes) {
+        if (measure_bandwidth(x, len) < 0) {
+            return -1;
+        }
+    }
+    if (x->kind == XPORT_TCP) {
+        std::cout << "io_uring send chains: " << x->uring.chains << ", zero-copy sends: " << x->uring.zc_sends
+                  << ", copied sends: " << x->uring.copy_sends
+                  << (x->uring.fixed ? " (registered buffer)" : " (unregistered buffer)") << std::endl;
+    }
+
+    // 长度为0的消息通知服务端结束
+    if (xport_post(x, XPORT_SEND, 0, 0, 0, 0) < 0 || xport_wait(x, 1) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    int want = argc > 2 ? xport_parse_kind(argv[2]) : XPORT_AUTO;
+    if (argc < 2 || want < 0) {
+        std::cerr << "Usage: " << argv[0] << " <server_ip> [auto|rdma|tcp] [max_kb]" << std::endl;
+        return -1;
+    }
+    uint64_t max_size = (uint64_t)(argc > 3 ? atoi(argv[3]) : 1024) << 10;
+    if (max_size < XPORT_MSG_MAX || max_size > (1ull << 31)) {
+        std::cerr << "max_kb must be between 64 and 2097152" << std::endl;
+        return -1;
+    }
+
+    int sock_fd = tcp_connect(argv[1], PORT);
+    if (sock_fd < 0) {
+        return -1;
+    }
+    std::cout << "Connected to server" << std::endl;
+
+    xport x;
+    xport_init(&x);
+    int ret = rdma_client_xport(&x, sock_fd, want, max_size);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    xport_close(&x);
+    close(sock_fd);
+    return ret;
+}
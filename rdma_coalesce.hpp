@@ -0,0 +1,213 @@
+#ifndef _RDMA_COALESCE_HPP
+#define _RDMA_COALESCE_HPP
+
+// 批次缓冲区比普通消息大，必须在第一次包含 rdma_credit.hpp 之前定义
+#ifndef CREDIT_MSG_SIZE
+#define CREDIT_MSG_SIZE 8192
+#endif
+
+#include "rdma_credit.hpp"
+
+/*
+    小消息合并发送
+
+    32~256字节的小消息各自占用一个SEND WR时，瓶颈在每个WR的固定开销（门铃、WQE、完成、信用）而不是带宽。
+    合并发送方把消息直接追加到信用通道当前的注册发送缓冲区中，每条消息前加2字节长度头：
+      | len (uint16) | payload | len | payload | ...
+    满足以下任一条件时把整个批次作为一个SEND发出：
+      - 批次大小达到 flush_bytes（或放不下下一条消息）；
+      - 批次中最老的消息等待超过 flush_ns（由 coalesce_poll 检查）；
+      - 调用方显式调用 coalesce_flush。
+    自适应模式下用指数平均估计到达间隔和消息大小，在延迟预算 max_delay 内：
+      - 预计等不到第二条消息时立即发送，稀疏流量不增加延迟；
+      - 否则 flush_bytes 取预算内预计到达的字节数（不超过缓冲区），flush_ns 取填满它所需时间的两倍（不超过预算）。
+    接收方 coalesce_recv 直接返回接收缓冲区中消息的指针，不做拷贝，整个批次取完后才重新post接收。
+    批次打开期间占用信用通道的下一个发送缓冲区，不能再对同一通道调用 credit_send。
+*/
+
+#define COALESCE_HDR_SIZE 2
+#define COALESCE_MAX_MSG (CREDIT_MSG_SIZE - COALESCE_HDR_SIZE)
+#define COALESCE_EWMA_ALPHA 0.125
+
+struct coalesce_sender {
+    credit_channel *ch;
+    char *buf;                  // 当前批次所在的发送缓冲区，NULL表示没有打开的批次
+    uint32_t used;
+    uint32_t count;
+    uint64_t first_ns;          // 批次中第一条消息的到达时间
+    uint64_t arrival_sum_ns;    // 批次中所有消息到达时间之和，用于统计附加延迟
+
+    uint32_t flush_bytes;
+    uint64_t flush_ns;
+    bool adaptive;
+    uint64_t max_delay_ns;      // 自适应模式的延迟预算
+    double gap_ewma_ns;         // 平均到达间隔
+    double size_ewma;           // 平均消息大小（含长度头）
+    uint64_t last_arrival_ns;
+
+    // 统计信息
+    uint64_t msgs;
+    uint64_t batches;
+    uint64_t flush_by_size;
+    uint64_t flush_by_timer;
+    uint64_t flush_by_call;
+    double added_ns;            // 所有消息从到达到被post的等待时间之和
+};
+
+struct coalesce_receiver {
+    credit_channel *ch;
+    const char *batch;          // 当前批次在接收缓冲区中的位置
+    uint32_t len;
+    uint32_t pos;
+
+    // 统计信息
+    uint64_t msgs;
+    uint64_t batches;
+};
+
+
+// flush_bytes为1时每条消息单独发送；adaptive为true时两个阈值随到达速率调整，max_delay_us为延迟预算
+void coalesce_sender_init(coalesce_sender *cs, credit_channel *ch, uint32_t flush_bytes, uint32_t max_delay_us,
+                          bool adaptive) {
+    memset(cs, 0, sizeof(*cs));
+    cs->ch = ch;
+    cs->flush_bytes = std::min<uint32_t>(flush_bytes, CREDIT_MSG_SIZE);
+    cs->flush_ns = (uint64_t)max_delay_us * 1000;
+    cs->adaptive = adaptive;
+    cs->max_delay_ns = (uint64_t)max_delay_us * 1000;
+    cs->gap_ewma_ns = (double)cs->max_delay_ns;     // 开始时按稀疏流量处理
+    cs->size_ewma = 128;
+}
+
+void coalesce_receiver_init(coalesce_receiver *cr, credit_channel *ch) {
+    memset(cr, 0, sizeof(*cr));
+    cr->ch = ch;
+}
+
+// 根据一条新到达的消息更新到达间隔和大小的估计，并重新计算两个阈值
+void coalesce_adapt(coalesce_sender *cs, uint64_t now, uint32_t len) {
+    if (cs->last_arrival_ns) {
+        double gap = (double)(now - cs->last_arrival_ns);
+        cs->gap_ewma_ns += COALESCE_EWMA_ALPHA * (gap - cs->gap_ewma_ns);
+    }
+    cs->last_arrival_ns = now;
+    cs->size_ewma += COALESCE_EWMA_ALPHA * (len + COALESCE_HDR_SIZE - cs->size_ewma);
+
+    double expected = cs->max_delay_ns / std::max(cs->gap_ewma_ns, 1.0);   // 预算内预计到达的消息数
+    if (expected < 2) {
+        cs->flush_bytes = 1;
+        cs->flush_ns = 0;
+        return;
+    }
+    double bytes = std::min(expected * cs->size_ewma, (double)CREDIT_MSG_SIZE);
+    cs->flush_bytes = (uint32_t)bytes;
+    double fill_ns = bytes / cs->size_ewma * cs->gap_ewma_ns;
+    cs->flush_ns = (uint64_t)std::min(2 * fill_ns, (double)cs->max_delay_ns);
+}
+
+// 把当前批次作为一个SEND发出
+int coalesce_flush_batch(coalesce_sender *cs, uint64_t *counter) {
+    if (!cs->buf) {
+        return 0;
+    }
+    uint64_t now = now_ns();
+    if (credit_send_commit(cs->ch, cs->used) < 0) {
+        return -1;
+    }
+    cs->added_ns += (double)cs->count * now - (double)cs->arrival_sum_ns;
+    cs->batches++;
+    (*counter)++;
+    cs->buf = NULL;
+    return 0;
+}
+
+// 显式发送当前批次
+int coalesce_flush(coalesce_sender *cs) {
+    return coalesce_flush_batch(cs, &cs->flush_by_call);
+}
+
+// 追加一条消息，达到大小阈值时立即发送
+int coalesce_send(coalesce_sender *cs, const void *data, uint32_t len) {
+    if (len > COALESCE_MAX_MSG || len > 0xffff) {
+        std::cerr << "Message too large: " << len << std::endl;
+        return -1;
+    }
+    uint64_t now = now_ns();
+    if (cs->adaptive) {
+        coalesce_adapt(cs, now, len);
+    }
+    if (cs->buf && cs->used + COALESCE_HDR_SIZE + len > CREDIT_MSG_SIZE) {
+        if (coalesce_flush_batch(cs, &cs->flush_by_size) < 0) {
+            return -1;
+        }
+    }
+    if (!cs->buf) {
+        // 没有信用时在这里等待，等待时间计入附加延迟
+        cs->buf = credit_send_acquire(cs->ch);
+        if (!cs->buf) {
+            return -1;
+        }
+        cs->used = 0;
+        cs->count = 0;
+        cs->first_ns = now;
+        cs->arrival_sum_ns = 0;
+    }
+    uint16_t hdr = (uint16_t)len;
+    memcpy(cs->buf + cs->used, &hdr, COALESCE_HDR_SIZE);
+    memcpy(cs->buf + cs->used + COALESCE_HDR_SIZE, data, len);
+    cs->used += COALESCE_HDR_SIZE + len;
+    cs->count++;
+    cs->arrival_sum_ns += now;
+    cs->msgs++;
+    if (cs->used >= cs->flush_bytes) {
+        return coalesce_flush_batch(cs, &cs->flush_by_size);
+    }
+    return 0;
+}
+
+// 空闲时调用：处理完成和信用归还，并检查定时发送
+int coalesce_poll(coalesce_sender *cs) {
+    if (credit_progress(cs->ch) < 0) {
+        return -1;
+    }
+    if (cs->buf && now_ns() - cs->first_ns >= cs->flush_ns) {
+        return coalesce_flush_batch(cs, &cs->flush_by_timer);
+    }
+    return 0;
+}
+
+// 取下一条消息，返回指向接收缓冲区的指针，在下一次调用前有效；出错返回NULL
+const char *coalesce_recv(coalesce_receiver *cr, uint32_t *len) {
+    while (!cr->batch || cr->pos >= cr->len) {
+        if (cr->batch) {
+            cr->batch = NULL;
+            if (credit_recv_release(cr->ch) < 0) {
+                return NULL;
+            }
+        }
+        cr->batch = credit_recv_peek(cr->ch, &cr->len);
+        if (!cr->batch) {
+            return NULL;
+        }
+        cr->pos = 0;
+        cr->batches++;
+    }
+    uint16_t hdr;
+    if (cr->pos + COALESCE_HDR_SIZE > cr->len) {
+        std::cerr << "Truncated frame header at offset " << cr->pos << std::endl;
+        return NULL;
+    }
+    memcpy(&hdr, cr->batch + cr->pos, COALESCE_HDR_SIZE);
+    if (cr->pos + COALESCE_HDR_SIZE + hdr > cr->len) {
+        std::cerr << "Frame length " << hdr << " exceeds batch at offset " << cr->pos << std::endl;
+        return NULL;
+    }
+    const char *msg = cr->batch + cr->pos + COALESCE_HDR_SIZE;
+    cr->pos += COALESCE_HDR_SIZE + hdr;
+    cr->msgs++;
+    *len = hdr;
+    return msg;
+}
+
+
+#endif  // _RDMA_COALESCE_HPP
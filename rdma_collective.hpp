@@ -0,0 +1,455 @@
+#ifndef _RDMA_COLLECTIVE_HPP
+#define _RDMA_COLLECTIVE_HPP
+
+#include "rdma_common.hpp"
+#include "rdma_reduce.hpp"
+#include <deque>
+
+/*
+    环形 allreduce
+
+    建环：各进程先在任意端口监听，再连接集合点进程(rendezvous)报告自己的端口；集合点收齐 N 个进程后
+    按连接顺序分配 rank，并把右邻居的地址发给每个进程。之后相邻进程之间直接建立TCP连接，
+    用 rdma_connect_qp（即 exchange_qp_info）连接一对RC QP：qp_next 只发，qp_prev 只收。
+
+    缓冲区布局：[ data (max_bytes) | staging ((N-1) 个块) ]，所有进程的 max_bytes 必须相同。
+    数据分成 N 块，每块再切成 COLL_SEGMENT_SIZE 的段，共 2(N-1) 个阶段：
+      - 阶段 t 发送第 (rank - t) mod N 块，接收第 (rank - t - 1) mod N 块；
+      - 前 N-1 个阶段是 reduce-scatter：对端写入本端 staging 的第 t 个槽位，收到后原地归约进 data；
+      - 后 N-1 个阶段是 allgather：对端直接写入本端 data 的对应位置。
+    每段用一个 RDMA_WRITE_WITH_IMM 发送，立即数据为 (阶段 << 16) | 段号。
+    某段在阶段 t 收到（并归约）后立刻作为阶段 t+1 的同一段转发出去，
+    因此归约当前段的同时，后续的段仍在网络上传输。
+
+    立即数据中没有调用序号，所以每次 allreduce 返回前沿环做一次两轮的令牌屏障（零长度 WRITE_WITH_IMM）：
+    第一轮令牌从 rank 0 出发绕环一周，说明所有 rank 都已完成；第二轮再绕一周通知大家返回。
+    否则先完成的 rank 开始下一次调用时，会覆盖右邻居尚未归约的 staging，右邻居也会把下一次的段当作本次的。
+    屏障期间收到的下一次调用的段先暂存，下一次调用开始时再处理。
+*/
+
+#define COLL_SEGMENT_SIZE (256 * 1024)
+#define COLL_SQ_DEPTH 64            // 在途写请求上限
+#define COLL_RECV_DEPTH 128         // 预先post的接收数（只用于消耗立即数据）
+#define COLL_IMM_TOKEN 0xffffffffu  // 屏障令牌的立即数据
+
+struct coll_hello {
+    uint32_t rank;
+    uint32_t nranks;
+    uint32_t next_ip;       // 网络字节序
+    uint16_t next_port;     // 网络字节序
+};
+
+struct coll_ring {
+    rdma_context ctx;       // ctx.qp 与 qp_next 相同
+    struct ibv_qp *qp_next;
+    struct ibv_qp *qp_prev;
+    int rank;
+    int nranks;
+    qp_info next_info;      // 右邻居的缓冲区地址和rkey
+    size_t max_bytes;
+    char *data;
+    char *staging;
+    int send_inflight;
+    uint64_t tokens_received;           // 累计收到的屏障令牌
+    uint64_t tokens_consumed;
+    std::deque<uint32_t> stashed;       // 屏障期间收到的下一次调用的段（立即数据）
+};
+
+struct coll_segment {
+    int stage;
+    int chunk;
+    uint32_t seg;
+};
+
+
+/* 集合点 */
+// 收齐nranks个进程后分配rank并告知各自的右邻居
+int coll_rendezvous(int nranks) {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    std::vector<int> fds;
+    std::vector<uint32_t> ips;
+    std::vector<uint16_t> ports;
+    int ret = 0;
+    while ((int)fds.size() < nranks) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept(server_fd, (sockaddr *)&addr, &addr_len);
+        if (fd < 0) {
+            std::cerr << "Accept failed" << std::endl;
+            ret = -1;
+            break;
+        }
+        uint16_t port;
+        if (sock_recv_all(fd, &port, sizeof(port)) < 0) {
+            std::cerr << "Failed to receive listen port" << std::endl;
+            close(fd);
+            continue;
+        }
+        std::cout << "Rank " << fds.size() << " registered from " << inet_ntoa(addr.sin_addr)
+                  << ":" << ntohs(port) << std::endl;
+        fds.push_back(fd);
+        ips.push_back(addr.sin_addr.s_addr);
+        ports.push_back(port);
+    }
+    for (size_t i = 0; ret == 0 && i < fds.size(); i++) {
+        size_t next = (i + 1) % fds.size();
+        coll_hello hello;
+        memset(&hello, 0, sizeof(hello));
+        hello.rank = htonl((uint32_t)i);
+        hello.nranks = htonl((uint32_t)nranks);
+        hello.next_ip = ips[next];
+        hello.next_port = ports[next];
+        if (sock_send_all(fds[i], &hello, sizeof(hello)) < 0) {
+            std::cerr << "Failed to send ring info to rank " << i << std::endl;
+            ret = -1;
+        }
+    }
+    for (int fd : fds) {
+        close(fd);
+    }
+    close(server_fd);
+    return ret;
+}
+
+
+/* 建环 */
+// 在系统分配的端口上监听，返回监听套接字和端口（网络字节序）
+int coll_listen_any(uint16_t *port) {
+    int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock_fd < 0) {
+        std::cerr << "Socket creation failed" << std::endl;
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = 0;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(sock_fd, (const sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock_fd, 2) < 0 ||
+        getsockname(sock_fd, (sockaddr *)&addr, &addr_len) < 0) {
+        std::cerr << "Failed to listen on ephemeral port" << std::endl;
+        close(sock_fd);
+        return -1;
+    }
+    *port = addr.sin_port;
+    return sock_fd;
+}
+
+// 向集合点注册，得到rank、进程数，以及与左右邻居的TCP连接
+int coll_bootstrap(coll_ring *ring, const char *rendezvous_ip, int *next_fd, int *prev_fd) {
+    uint16_t port;
+    int listen_fd = coll_listen_any(&port);
+    if (listen_fd < 0) {
+        return -1;
+    }
+    int rv_fd = tcp_connect(rendezvous_ip, PORT);
+    if (rv_fd < 0) {
+        close(listen_fd);
+        return -1;
+    }
+    coll_hello hello;
+    if (sock_send_all(rv_fd, &port, sizeof(port)) < 0 || sock_recv_all(rv_fd, &hello, sizeof(hello)) < 0) {
+        std::cerr << "Failed to register with rendezvous" << std::endl;
+        close(rv_fd);
+        close(listen_fd);
+        return -1;
+    }
+    close(rv_fd);
+    ring->rank = (int)ntohl(hello.rank);
+    ring->nranks = (int)ntohl(hello.nranks);
+
+    // 先连接右邻居（对端已在监听，connect不会阻塞在accept上），再接受左邻居
+    char next_ip[INET_ADDRSTRLEN];
+    struct in_addr in;
+    in.s_addr = hello.next_ip;
+    inet_ntop(AF_INET, &in, next_ip, sizeof(next_ip));
+    *next_fd = tcp_connect(next_ip, ntohs(hello.next_port));
+    *prev_fd = *next_fd < 0 ? -1 : accept(listen_fd, NULL, NULL);
+    close(listen_fd);
+    if (*next_fd < 0 || *prev_fd < 0) {
+        std::cerr << "Failed to connect ring neighbours" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int coll_post_recv(coll_ring *ring) {
+    struct ibv_recv_wr recv_wr, *bad_recv_wr;
+    memset(&recv_wr, 0, sizeof(recv_wr));
+    recv_wr.sg_list = NULL;         // WRITE_WITH_IMM 的数据直接写入目标地址，接收请求只用来取立即数据
+    recv_wr.num_sge = 0;
+    if (ibv_post_recv(ring->qp_prev, &recv_wr, &bad_recv_wr)) {
+        std::cerr << "Failed to post receive request" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 通过集合点建立环，max_bytes为单次allreduce的最大字节数
+int coll_ring_init(coll_ring *ring, const char *rendezvous_ip, size_t max_bytes) {
+    memset(&ring->ctx, 0, sizeof(ring->ctx));
+    ring->qp_next = NULL;
+    ring->qp_prev = NULL;
+    ring->send_inflight = 0;
+    ring->tokens_received = 0;
+    ring->tokens_consumed = 0;
+    ring->stashed.clear();
+    ring->max_bytes = max_bytes;
+
+    int next_fd = -1, prev_fd = -1;
+    if (coll_bootstrap(ring, rendezvous_ip, &next_fd, &prev_fd) < 0) {
+        if (next_fd >= 0) close(next_fd);
+        return -1;
+    }
+    std::cout << "Rank " << ring->rank << " of " << ring->nranks << std::endl;
+
+    // staging 每个槽位按最大块大小预留，加上对齐余量
+    size_t max_chunk = (max_bytes + ring->nranks - 1) / ring->nranks + 64;
+    size_t buf_size = max_bytes + (size_t)(ring->nranks - 1) * max_chunk;
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE;
+    int ret = -1;
+    if (rdma_alloc_resources(&ring->ctx, buf_size, 2 * (COLL_SQ_DEPTH + COLL_RECV_DEPTH), access) == 0 &&
+        rdma_create_rc_qp(&ring->ctx, 1, COLL_RECV_DEPTH) == 0) {
+        ring->qp_prev = ring->ctx.qp;
+        if (rdma_create_rc_qp(&ring->ctx, COLL_SQ_DEPTH, 1) == 0) {
+            ring->qp_next = ring->ctx.qp;
+            ring->data = ring->ctx.buffer;
+            ring->staging = ring->ctx.buffer + max_bytes;
+
+            // rank 0 先连右邻居，其余先连左邻居，避免所有进程同时等待右邻居而形成环形等待
+            qp_info prev_info;
+            ret = 0;
+            for (int i = 0; i < 2 && ret == 0; i++) {
+                bool next_side = (ring->rank == 0) == (i == 0);
+                ring->ctx.qp = next_side ? ring->qp_next : ring->qp_prev;
+                ret = rdma_connect_qp(&ring->ctx, next_side ? next_fd : prev_fd,
+                                      next_side ? &ring->next_info : &prev_info, access);
+            }
+            ring->ctx.qp = ring->qp_next;
+            for (int i = 0; i < COLL_RECV_DEPTH && ret == 0; i++) {
+                ret = coll_post_recv(ring);
+            }
+            // 所有接收就绪后再互相确认一次，防止对端过早写入
+            char ack = 0;
+            if (ret == 0 && (sock_send_all(next_fd, &ack, 1) < 0 || sock_send_all(prev_fd, &ack, 1) < 0 ||
+                             sock_recv_all(next_fd, &ack, 1) < 0 || sock_recv_all(prev_fd, &ack, 1) < 0)) {
+                std::cerr << "Failed to synchronize with neighbours" << std::endl;
+                ret = -1;
+            }
+        }
+    }
+    close(next_fd);
+    close(prev_fd);
+    return ret;
+}
+
+void coll_ring_free(coll_ring *ring) {
+    if (ring->qp_prev && ring->qp_prev != ring->ctx.qp) {
+        ibv_destroy_qp(ring->qp_prev);
+    }
+    rdma_free_resources(&ring->ctx);
+    ring->qp_next = NULL;
+    ring->qp_prev = NULL;
+}
+
+
+/* allreduce */
+struct coll_layout {
+    size_t elem_size;
+    size_t chunk_elems;     // 每块元素数（最后一块可能更短或为空）
+    size_t seg_elems;       // 每段元素数
+    size_t count;
+    int nranks;
+};
+
+size_t coll_chunk_len(const coll_layout *l, int chunk) {
+    size_t begin = (size_t)chunk * l->chunk_elems;
+    return begin >= l->count ? 0 : std::min(l->chunk_elems, l->count - begin);
+}
+
+uint32_t coll_chunk_segs(const coll_layout *l, int chunk) {
+    return (uint32_t)((coll_chunk_len(l, chunk) + l->seg_elems - 1) / l->seg_elems);
+}
+
+int coll_chunk_of(const coll_ring *ring, int stage) {
+    return ((ring->rank - stage) % ring->nranks + ring->nranks) % ring->nranks;
+}
+
+// 把segment发给右邻居：reduce-scatter阶段写入对端staging，allgather阶段直接写入对端data
+int coll_post_segment(coll_ring *ring, const coll_layout *l, const coll_segment *s) {
+    size_t elem_off = (size_t)s->chunk * l->chunk_elems + (size_t)s->seg * l->seg_elems;
+    size_t n = std::min(l->seg_elems, coll_chunk_len(l, s->chunk) - (size_t)s->seg * l->seg_elems);
+    uint64_t remote = s->stage < ring->nranks - 1
+        ? ring->next_info.addr + ring->max_bytes + (size_t)s->stage * l->chunk_elems * l->elem_size + (size_t)s->seg * l->seg_elems * l->elem_size
+        : ring->next_info.addr + elem_off * l->elem_size;
+
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)(ring->data + elem_off * l->elem_size);
+    sge.length = (uint32_t)(n * l->elem_size);
+    sge.lkey = ring->ctx.mr->lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.imm_data = htonl(((uint32_t)s->stage << 16) | s->seg);
+    wr.wr.rdma.remote_addr = remote;
+    wr.wr.rdma.rkey = ring->next_info.rkey;
+    if (ibv_post_send(ring->qp_next, &wr, &bad_wr)) {
+        std::cerr << "Failed to post ring write" << std::endl;
+        return -1;
+    }
+    ring->send_inflight++;
+    return 0;
+}
+
+// 发一个屏障令牌给右邻居
+int coll_post_token(coll_ring *ring) {
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.opcode = IBV_WR_RDMA_WRITE_WITH_IMM;
+    wr.sg_list = NULL;
+    wr.num_sge = 0;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.imm_data = htonl(COLL_IMM_TOKEN);
+    wr.wr.rdma.remote_addr = ring->next_info.addr;
+    wr.wr.rdma.rkey = ring->next_info.rkey;
+    if (ibv_post_send(ring->qp_next, &wr, &bad_wr)) {
+        std::cerr << "Failed to post barrier token" << std::endl;
+        return -1;
+    }
+    ring->send_inflight++;
+    return 0;
+}
+
+// 处理一批完成：发送完成减少在途数，令牌计数，其余接收的立即数据追加到imms，返回处理的个数
+int coll_poll(coll_ring *ring, std::deque<uint32_t> *imms) {
+    struct ibv_wc wc[16];
+    int n = ibv_poll_cq(ring->ctx.cq, 16, wc);
+    if (n < 0) {
+        std::cerr << "Failed to poll CQ" << std::endl;
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (wc[i].status != IBV_WC_SUCCESS) {
+            std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc[i].status) << std::endl;
+            return -1;
+        }
+        if (!(wc[i].opcode & IBV_WC_RECV)) {
+            ring->send_inflight--;
+            continue;
+        }
+        if (coll_post_recv(ring) < 0) {
+            return -1;
+        }
+        uint32_t imm = ntohl(wc[i].imm_data);
+        if (imm == COLL_IMM_TOKEN) {
+            ring->tokens_received++;
+        } else {
+            imms->push_back(imm);
+        }
+    }
+    return n;
+}
+
+// 两轮令牌屏障，返回时所有rank都已完成本次调用
+int coll_barrier(coll_ring *ring) {
+    for (int round = 0; round < 2; round++) {
+        if (ring->rank == 0 && coll_post_token(ring) < 0) {
+            return -1;
+        }
+        while (ring->tokens_received == ring->tokens_consumed) {
+            if (coll_poll(ring, &ring->stashed) < 0) {
+                return -1;
+            }
+        }
+        ring->tokens_consumed++;
+        // 最后一个rank的令牌回到rank 0，不再转发
+        if (ring->rank != 0 && coll_post_token(ring) < 0) {
+            return -1;
+        }
+    }
+    while (ring->send_inflight > 0) {
+        if (coll_poll(ring, &ring->stashed) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 对 ring->data 中的 count 个元素原地做 allreduce
+int coll_allreduce(coll_ring *ring, size_t count, reduce_dtype dtype, reduce_op op) {
+    int nranks = ring->nranks;
+    if (nranks == 1 || count == 0) {
+        return 0;
+    }
+    coll_layout l;
+    l.elem_size = reduce_dtype_size(dtype);
+    l.count = count;
+    l.nranks = nranks;
+    l.chunk_elems = (count + nranks - 1) / nranks;
+    l.seg_elems = COLL_SEGMENT_SIZE / l.elem_size;
+    if (count * l.elem_size > ring->max_bytes) {
+        std::cerr << "Allreduce too large: " << count * l.elem_size << " bytes" << std::endl;
+        return -1;
+    }
+    reduce_fn reduce = reduce_select(dtype, op, NULL);
+    int stages = 2 * (nranks - 1);
+
+    uint64_t expected = 0;
+    for (int t = 0; t < stages; t++) {
+        expected += coll_chunk_segs(&l, coll_chunk_of(ring, t + 1));
+    }
+
+    // 阶段0：把自己的第rank块发出去
+    std::deque<coll_segment> pending;
+    for (uint32_t seg = 0; seg < coll_chunk_segs(&l, ring->rank); seg++) {
+        coll_segment s = {0, ring->rank, seg};
+        pending.push_back(s);
+    }
+
+    uint64_t received = 0;
+    std::deque<uint32_t> imms;
+    imms.swap(ring->stashed);       // 上一次调用的屏障期间已经到达的段
+    while (received < expected || !pending.empty() || ring->send_inflight > 0) {
+        while (!pending.empty() && ring->send_inflight < COLL_SQ_DEPTH) {
+            if (coll_post_segment(ring, &l, &pending.front()) < 0) {
+                return -1;
+            }
+            pending.pop_front();
+        }
+        if (imms.empty() && coll_poll(ring, &imms) < 0) {
+            return -1;
+        }
+        while (!imms.empty()) {
+            uint32_t imm = imms.front();
+            imms.pop_front();
+            coll_segment s;
+            s.stage = (int)(imm >> 16);
+            s.seg = imm & 0xffff;
+            s.chunk = coll_chunk_of(ring, s.stage + 1);
+            if (s.stage < nranks - 1) {
+                size_t elem_off = (size_t)s.chunk * l.chunk_elems + (size_t)s.seg * l.seg_elems;
+                size_t len = std::min(l.seg_elems, coll_chunk_len(&l, s.chunk) - (size_t)s.seg * l.seg_elems);
+                char *src = ring->staging + ((size_t)s.stage * l.chunk_elems + (size_t)s.seg * l.seg_elems) * l.elem_size;
+                reduce(ring->data + elem_off * l.elem_size, src, len);
+            }
+            received++;
+            // 阶段t收到的块正是阶段t+1要发送的块
+            if (s.stage + 1 < stages) {
+                s.stage++;
+                pending.push_back(s);
+            }
+        }
+    }
+    return coll_barrier(ring);
+}
+
+
+#endif  // _RDMA_COLLECTIVE_HPP
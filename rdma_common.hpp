@@ -10,6 +10,9 @@
 #include <cstring>              // 用于memset函数
 #include <cstdlib>              // 用于exit函数
 #include <unistd.h>             // 用于close函数
+#include <ctime>                // 用于clock_gettime函数
+#include <vector>               // 用于延迟采样
+#include <algorithm>            // 用于std::sort
 
 #define PORT 8888
 #define BUFFER_SIZE 1024
@@ -34,6 +37,35 @@ struct qp_info {
 };
 
 
+// 完整发送len字节（send可能只发送部分数据）
+int sock_send_all(int sock_fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = send(sock_fd, p, len, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 完整接收len字节（recv可能只返回部分数据）
+int sock_recv_all(int sock_fd, void *buf, size_t len) {
+    char *p = (char *)buf;
+    while (len > 0) {
+        ssize_t n = recv(sock_fd, p, len, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+
 int exchange_qp_info(int sock_fd, qp_info* local_info, qp_info* remote_info) {
     // ssize_t send(int sockfd, const void *buf, size_t len, int flags);
     // 套接字文件描述符，用于标识要发送数据的目标套接字
@@ -41,12 +73,12 @@ int exchange_qp_info(int sock_fd, qp_info* local_info, qp_info* remote_info) {
     // 要发送的数据的长度（字节数）
     // 发送标志，通常为 0
     // 成功时：返回发送的字节数。 失败时：返回 -1，并设置 errno 以指示错误。
-    if (send(sock_fd, local_info, sizeof(*local_info), 0) < 0) {
+    if (sock_send_all(sock_fd, local_info, sizeof(*local_info)) < 0) {
         perror("Failed to send local QP info");
         return -1;
     }
     // 接收远程QP信息
-    if (recv(sock_fd, remote_info, sizeof(*remote_info), 0) < 0) {
+    if (sock_recv_all(sock_fd, remote_info, sizeof(*remote_info)) < 0) {
         perror("Failed to receive remote QP info");
         return -1;
     }
@@ -54,6 +86,315 @@ int exchange_qp_info(int sock_fd, qp_info* local_info, qp_info* remote_info) {
 }
 
 
+/* TCP辅助函数 */
+// 创建监听套接字
+int tcp_listen(int port) {
+    int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock_fd < 0) {
+        std::cerr << "Socket creation failed" << std::endl;
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));  // 允许快速重启
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock_fd, (const sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        std::cerr << "Bind failed" << std::endl;
+        close(sock_fd);
+        return -1;
+    }
+    if (listen(sock_fd, 5) < 0) {
+        std::cerr << "Listen failed" << std::endl;
+        close(sock_fd);
+        return -1;
+    }
+    std::cout << "Server is listening on port " << port << std::endl;
+    return sock_fd;
+}
+
+// 连接到服务器
+int tcp_connect(const char *ip, int port) {
+    int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock_fd < 0) {
+        std::cerr << "Socket creation failed" << std::endl;
+        return -1;
+    }
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &server_addr.sin_addr) <= 0) {
+        std::cerr << "Invalid address / Address not supported" << std::endl;
+        close(sock_fd);
+        return -1;
+    }
+    if (connect(sock_fd, (const sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        std::cerr << "Connect failed" << std::endl;
+        close(sock_fd);
+        return -1;
+    }
+    return sock_fd;
+}
+
+
+/* RDMA资源辅助函数 */
+// 打开第一个RDMA设备，没有设备时返回NULL
+struct ibv_context *open_first_device() {
+    int num_devices = 0;
+    struct ibv_device **dev_list = ibv_get_device_list(&num_devices);
+    if (!dev_list || num_devices == 0) {
+        std::cerr << "No RDMA device found" << std::endl;
+        if (dev_list) {
+            ibv_free_device_list(dev_list);
+        }
+        return NULL;
+    }
+    struct ibv_context *ctx = ibv_open_device(dev_list[0]);
+    ibv_free_device_list(dev_list);
+    if (!ctx) {
+        std::cerr << "Failed to open device" << std::endl;
+    }
+    return ctx;
+}
+
+// 分配设备、PD、完成通道、CQ，以及buf_size字节的缓冲区和对应的MR
+int rdma_alloc_resources(rdma_context *_ctx, size_t buf_size, int cq_size, int mr_access) {
+    memset(_ctx, 0, sizeof(*_ctx));
+    _ctx->ctx = open_first_device();
+    if (!_ctx->ctx) {
+        return -1;
+    }
+    _ctx->pd = ibv_alloc_pd(_ctx->ctx);
+    if (!_ctx->pd) {
+        std::cerr << "Failed to allocate PD" << std::endl;
+        return -1;
+    }
+    _ctx->channel = ibv_create_comp_channel(_ctx->ctx);
+    if (!_ctx->channel) {
+        std::cerr << "Failed to create completion channel" << std::endl;
+        return -1;
+    }
+    _ctx->cq = ibv_create_cq(_ctx->ctx, cq_size, NULL, _ctx->channel, 0);
+    if (!_ctx->cq) {
+        std::cerr << "Failed to create CQ" << std::endl;
+        return -1;
+    }
+    _ctx->buffer = (char *)malloc(buf_size);
+    if (!_ctx->buffer) {
+        std::cerr << "Failed to allocate buffer" << std::endl;
+        return -1;
+    }
+    memset(_ctx->buffer, 0, buf_size);
+    _ctx->mr = ibv_reg_mr(_ctx->pd, _ctx->buffer, buf_size, mr_access);
+    if (!_ctx->mr) {
+        std::cerr << "Failed to register MR" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 创建RC类型的QP，收发共用一个CQ
+int rdma_create_rc_qp(rdma_context *_ctx, int max_send_wr, int max_recv_wr, int max_sge = 1, int max_inline = 0) {
+    struct ibv_qp_init_attr qp_attr;
+    memset(&qp_attr, 0, sizeof(qp_attr));
+    qp_attr.send_cq = _ctx->cq;
+    qp_attr.recv_cq = _ctx->cq;
+    qp_attr.qp_type = IBV_QPT_RC;
+    qp_attr.cap.max_send_wr = max_send_wr;
+    qp_attr.cap.max_recv_wr = max_recv_wr;
+    qp_attr.cap.max_send_sge = max_sge;
+    qp_attr.cap.max_recv_sge = max_sge;
+    qp_attr.cap.max_inline_data = max_inline;
+    _ctx->qp = ibv_create_qp(_ctx->pd, &qp_attr);
+    if (!_ctx->qp) {
+        std::cerr << "Failed to create QP" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 在途RDMA读/原子操作的上限，实际值受设备能力限制
+#define QP_MAX_RD_ATOMIC 16
+
+uint8_t qp_rd_atomic_limit(struct ibv_qp *qp, bool initiator) {
+    struct ibv_device_attr dev_attr;
+    if (ibv_query_device(qp->context, &dev_attr)) {
+        return 1;
+    }
+    int limit = initiator ? dev_attr.max_qp_init_rd_atom : dev_attr.max_qp_rd_atom;
+    return (uint8_t)std::max(1, std::min(limit, QP_MAX_RD_ATOMIC));
+}
+
+// RESET -> INIT
+int modify_qp_to_init(struct ibv_qp *qp, int access) {
+    struct ibv_qp_attr mod_attr;
+    memset(&mod_attr, 0, sizeof(mod_attr));
+    mod_attr.qp_state = IBV_QPS_INIT;
+    mod_attr.pkey_index = 0;
+    mod_attr.port_num = 1;
+    mod_attr.qp_access_flags = access;
+    if (ibv_modify_qp(qp, &mod_attr, IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS)) {
+        std::cerr << "Failed to modify QP to INIT" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// INIT -> RTR，sl和traffic_class决定链路上的服务等级（IB的SL，RoCE的DSCP/优先级）
+int modify_qp_to_rtr(struct ibv_qp *qp, const qp_info *remote_info, uint32_t rq_psn = 0, uint8_t sl = 0,
+                     uint8_t traffic_class = 0) {
+    struct ibv_qp_attr mod_attr;
+    memset(&mod_attr, 0, sizeof(mod_attr));
+    mod_attr.qp_state = IBV_QPS_RTR;
+    mod_attr.path_mtu = IBV_MTU_1024;
+    mod_attr.dest_qp_num = remote_info->qp_num;
+    mod_attr.rq_psn = rq_psn;
+    mod_attr.max_dest_rd_atomic = qp_rd_atomic_limit(qp, false);   // 允许对端同时发起多个RDMA读
+    mod_attr.min_rnr_timer = 12;
+    mod_attr.ah_attr.is_global = 1;
+    memcpy(&mod_attr.ah_attr.grh.dgid, remote_info->gid, 16);
+    mod_attr.ah_attr.grh.sgid_index = 0;
+    mod_attr.ah_attr.grh.hop_limit = 1;
+    mod_attr.ah_attr.grh.traffic_class = traffic_class;
+    mod_attr.ah_attr.dlid = remote_info->lid;
+    mod_attr.ah_attr.sl = sl;
+    mod_attr.ah_attr.src_path_bits = 0;
+    mod_attr.ah_attr.port_num = 1;
+    if (ibv_modify_qp(qp, &mod_attr, IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN | IBV_QP_RQ_PSN | IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER)) {
+        std::cerr << "Failed to modify QP to RTR" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// RTR -> RTS
+int modify_qp_to_rts(struct ibv_qp *qp, uint32_t sq_psn = 0, uint8_t rnr_retry = 7) {
+    struct ibv_qp_attr mod_attr;
+    memset(&mod_attr, 0, sizeof(mod_attr));
+    mod_attr.qp_state = IBV_QPS_RTS;
+    mod_attr.timeout = 14;
+    mod_attr.retry_cnt = 7;
+    mod_attr.rnr_retry = rnr_retry;   // 7表示无限重试，0表示遇到RNR NAK立即报错
+    mod_attr.sq_psn = sq_psn;
+    mod_attr.max_rd_atomic = qp_rd_atomic_limit(qp, true);
+    if (ibv_modify_qp(qp, &mod_attr, IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY | IBV_QP_SQ_PSN | IBV_QP_MAX_QP_RD_ATOMIC)) {
+        std::cerr << "Failed to modify QP to RTS" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 任意状态 -> ERROR，未完成的WR会以IBV_WC_WR_FLUSH_ERR完成
+int modify_qp_to_error(struct ibv_qp *qp) {
+    struct ibv_qp_attr mod_attr;
+    memset(&mod_attr, 0, sizeof(mod_attr));
+    mod_attr.qp_state = IBV_QPS_ERR;
+    if (ibv_modify_qp(qp, &mod_attr, IBV_QP_STATE)) {
+        std::cerr << "Failed to modify QP to ERROR" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 任意状态 -> RESET，之后可以重新走INIT/RTR/RTS连接新的对端
+int modify_qp_to_reset(struct ibv_qp *qp) {
+    struct ibv_qp_attr mod_attr;
+    memset(&mod_attr, 0, sizeof(mod_attr));
+    mod_attr.qp_state = IBV_QPS_RESET;
+    if (ibv_modify_qp(qp, &mod_attr, IBV_QP_STATE)) {
+        std::cerr << "Failed to modify QP to RESET" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 填充本地QP信息（LID、GID、QPN、缓冲区地址和rkey）
+int fill_local_qp_info(rdma_context *_ctx, qp_info *local_info) {
+    struct ibv_port_attr port_attr;
+    if (ibv_query_port(_ctx->ctx, 1, &port_attr)) {
+        std::cerr << "Failed to query port" << std::endl;
+        return -1;
+    }
+    union ibv_gid gid;
+    if (ibv_query_gid(_ctx->ctx, 1, 0, &gid)) {
+        std::cerr << "Failed to query GID" << std::endl;
+        return -1;
+    }
+    memset(local_info, 0, sizeof(*local_info));
+    local_info->qp_num = _ctx->qp->qp_num;
+    local_info->lid = port_attr.lid;
+    memcpy(local_info->gid, &gid, sizeof(gid));
+    local_info->rkey = _ctx->mr->rkey;
+    local_info->addr = (uintptr_t)_ctx->buffer;
+    return 0;
+}
+
+// 通过TCP交换QP信息，并把QP依次切换到INIT、RTR、RTS
+int rdma_connect_qp(rdma_context *_ctx, int sock_fd, qp_info *remote_info, int access, uint8_t rnr_retry = 7,
+                    uint8_t sl = 0, uint8_t traffic_class = 0) {
+    if (modify_qp_to_init(_ctx->qp, access) < 0) {
+        return -1;
+    }
+    qp_info local_info;
+    if (fill_local_qp_info(_ctx, &local_info) < 0) {
+        return -1;
+    }
+    if (exchange_qp_info(sock_fd, &local_info, remote_info) < 0) {
+        std::cerr << "Failed to exchange QP info" << std::endl;
+        return -1;
+    }
+    std::cout << "Local QP Info - QP Num: " << local_info.qp_num << ", LID: " << local_info.lid << std::endl;
+    std::cout << "Remote QP Info - QP Num: " << remote_info->qp_num << ", LID: " << remote_info->lid << std::endl;
+    if (modify_qp_to_rtr(_ctx->qp, remote_info, 0, sl, traffic_class) < 0) {
+        return -1;
+    }
+    return modify_qp_to_rts(_ctx->qp, 0, rnr_retry);
+}
+
+// 释放rdma_alloc_resources/rdma_create_rc_qp分配的资源，允许部分初始化
+void rdma_free_resources(rdma_context *_ctx) {
+    if (_ctx->qp) ibv_destroy_qp(_ctx->qp);
+    if (_ctx->mr) ibv_dereg_mr(_ctx->mr);
+    free(_ctx->buffer);
+    if (_ctx->cq) ibv_destroy_cq(_ctx->cq);
+    if (_ctx->channel) ibv_destroy_comp_channel(_ctx->channel);
+    if (_ctx->pd) ibv_dealloc_pd(_ctx->pd);
+    if (_ctx->ctx) ibv_close_device(_ctx->ctx);
+    memset(_ctx, 0, sizeof(*_ctx));
+}
+
+
+/* 基准测试辅助函数 */
+// 单调时钟，单位纳秒
+uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// 输出延迟分布（单位微秒）
+void print_latency_stats(const char *label, std::vector<double> &samples_us) {
+    if (samples_us.empty()) {
+        return;
+    }
+    std::sort(samples_us.begin(), samples_us.end());
+    double sum = 0;
+    for (double v : samples_us) {
+        sum += v;
+    }
+    size_t n = samples_us.size();
+    std::cout << label << " - samples: " << n
+              << ", avg: " << sum / n << " us"
+              << ", p50: " << samples_us[n / 2] << " us"
+              << ", p99: " << samples_us[std::min(n - 1, n * 99 / 100)] << " us"
+              << ", max: " << samples_us[n - 1] << " us" << std::endl;
+}
+
+
 #endif  // _RDMA_COMMON_HPP
 
 
@@ -62,4 +403,31 @@ int exchange_qp_info(int sock_fd, qp_info* local_info, qp_info* remote_info) {
     g++ -o rdma_client_sr rdma_client_sr.cpp rdma_common.hpp -libverbs
     g++ -o rdma_server_rw rdma_server_rw.cpp rdma_common.hpp -libverbs
     g++ -o rdma_client_rw rdma_client_rw.cpp rdma_common.hpp -libverbs
+    g++ -o rdma_server_credit rdma_server_credit.cpp -libverbs
+    g++ -o rdma_client_credit rdma_client_credit.cpp -libverbs
+    g++ -o rdma_server_daemon rdma_server_daemon.cpp -libverbs
+    g++ -o rdma_server_msg rdma_server_msg.cpp -libverbs
+    g++ -o rdma_client_msg rdma_client_msg.cpp -libverbs
+    g++ -O2 -o rdma_server_crc rdma_server_crc.cpp -libverbs
+    g++ -O2 -o rdma_client_crc rdma_client_crc.cpp -libverbs
+    g++ -O2 -o rdma_server_farmem rdma_server_farmem.cpp -libverbs
+    g++ -O2 -o rdma_client_farmem rdma_client_farmem.cpp -libverbs
+    g++ -O2 -o rdma_allreduce rdma_allreduce.cpp -libverbs
+    g++ -O2 -o rdma_server_mpsc rdma_server_mpsc.cpp -libverbs
+    g++ -O2 -pthread -o rdma_client_mpsc rdma_client_mpsc.cpp -libverbs
+    g++ -O2 -o rdma_server_recovery rdma_server_recovery.cpp -libverbs
+    g++ -O2 -o rdma_client_recovery rdma_client_recovery.cpp -libverbs
+    g++ -O2 -o rdma_server_mw rdma_server_mw.cpp -libverbs
+    g++ -O2 -o rdma_client_mw rdma_client_mw.cpp -libverbs
+    g++ -O2 -o rdma_server_coalesce rdma_server_coalesce.cpp -libverbs
+    g++ -O2 -o rdma_client_coalesce rdma_client_coalesce.cpp -libverbs
+    g++ -O2 -o rdma_client_ec rdma_client_ec.cpp -libverbs
+    g++ -O2 -o rdma_server_qos rdma_server_qos.cpp -libverbs
+    g++ -O2 -o rdma_client_qos rdma_client_qos.cpp -libverbs
+    g++ -O2 -pthread -o rdma_server_delta rdma_server_delta.cpp -libverbs
+    g++ -O2 -pthread -o rdma_client_delta rdma_client_delta.cpp -libverbs
+    g++ -O2 -o rdma_server_proto rdma_server_proto.cpp -libverbs
+    g++ -O2 -o rdma_client_proto rdma_client_proto.cpp -libverbs
+    g++ -O2 -o rdma_server_xport rdma_server_xport.cpp -libverbs
+    g++ -O2 -o rdma_client_xport rdma_client_xport.cpp -libverbs
 */
\ No newline at end of file
@@ -0,0 +1,241 @@
+#ifndef _RDMA_CRC32C_HPP
+#define _RDMA_CRC32C_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <immintrin.h>
+
+/*
+    CRC32C (Castagnoli) 校验，三种实现按CPU特性在运行时选择：
+      - crc32c_sw      查表法（slice-by-8），任何CPU都可用
+      - crc32c_sse42   SSE4.2 的 crc32 指令，每次处理8字节
+      - crc32c_avx512  AVX-512 VPCLMULQDQ 无进位乘法折叠，每轮处理256字节，剩余部分交给crc32指令
+
+    所有实现的语义相同：crc32c(0, "123456789", 9) == 0xE3069283，
+    对同一数据分段计算时把上一段的结果作为下一段的crc参数传入即可。
+    通过target属性单独为每个函数打开指令集，编译时不需要额外的-m参数。
+*/
+
+#define CRC32C_POLY_REFLECTED 0x82F63B78u   // 反射形式的多项式
+#define CRC32C_POLY_NORMAL    0x1EDC6F41u   // 正常形式的多项式（不含x^32项）
+
+typedef uint32_t (*crc32c_fn)(uint32_t crc, const void *buf, size_t len);
+
+
+/* 查表法 */
+static uint32_t g_crc32c_table[8][256];
+
+void crc32c_init_table() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c >> 1) ^ ((c & 1) ? CRC32C_POLY_REFLECTED : 0);
+        }
+        g_crc32c_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t prev = g_crc32c_table[t - 1][i];
+            g_crc32c_table[t][i] = (prev >> 8) ^ g_crc32c_table[0][prev & 0xff];
+        }
+    }
+}
+
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len) {
+    if (g_crc32c_table[0][1] == 0) {
+        crc32c_init_table();
+    }
+    const uint8_t *p = (const uint8_t *)buf;
+    uint32_t state = ~crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        v ^= state;
+        state = g_crc32c_table[7][v & 0xff] ^ g_crc32c_table[6][(v >> 8) & 0xff] ^
+                g_crc32c_table[5][(v >> 16) & 0xff] ^ g_crc32c_table[4][(v >> 24) & 0xff] ^
+                g_crc32c_table[3][(v >> 32) & 0xff] ^ g_crc32c_table[2][(v >> 40) & 0xff] ^
+                g_crc32c_table[1][(v >> 48) & 0xff] ^ g_crc32c_table[0][v >> 56];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        state = (state >> 8) ^ g_crc32c_table[0][(state ^ *p++) & 0xff];
+    }
+    return ~state;
+}
+
+
+/* SSE4.2 */
+// 对原始寄存器值（未取反）做更新
+__attribute__((target("sse4.2")))
+uint32_t crc32c_raw_sse42(uint32_t state, const uint8_t *p, size_t len) {
+    uint64_t s = state;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        s = _mm_crc32_u64(s, v);
+        p += 8;
+        len -= 8;
+    }
+    uint32_t s32 = (uint32_t)s;
+    while (len--) {
+        s32 = _mm_crc32_u8(s32, *p++);
+    }
+    return s32;
+}
+
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(uint32_t crc, const void *buf, size_t len) {
+    return ~crc32c_raw_sse42(~crc, (const uint8_t *)buf, len);
+}
+
+
+/* AVX-512 VPCLMULQDQ 折叠 */
+// x^e mod P（正常形式）
+uint32_t crc32c_xpow_mod(uint32_t e) {
+    uint64_t r = 1;
+    for (uint32_t i = 0; i < e; i++) {
+        r <<= 1;
+        if (r & (1ull << 32)) {
+            r ^= (1ull << 32) | CRC32C_POLY_NORMAL;
+        }
+    }
+    return (uint32_t)r;
+}
+
+uint64_t crc32c_reflect32(uint32_t v) {
+    uint32_t r = 0;
+    for (int i = 0; i < 32; i++) {
+        r |= ((v >> i) & 1) << (31 - i);
+    }
+    return r;
+}
+
+// 把128位数据向后折叠distance位所用的常数对（低64位 <- x^(d+32)，高64位 <- x^(d-32)）
+void crc32c_fold_constants(uint32_t distance, uint64_t *lo, uint64_t *hi) {
+    *lo = crc32c_reflect32(crc32c_xpow_mod(distance + 32)) << 1;
+    *hi = crc32c_reflect32(crc32c_xpow_mod(distance - 32)) << 1;
+}
+
+struct crc32c_fold_table {
+    uint64_t k2048[2];  // 4个zmm累加器并行，每轮前进256字节
+    uint64_t k512[2];
+    uint64_t k384[2];
+    uint64_t k256[2];
+    uint64_t k128[2];
+};
+
+static crc32c_fold_table g_crc32c_fold;
+
+void crc32c_init_fold_table() {
+    crc32c_fold_constants(2048, &g_crc32c_fold.k2048[0], &g_crc32c_fold.k2048[1]);
+    crc32c_fold_constants(512, &g_crc32c_fold.k512[0], &g_crc32c_fold.k512[1]);
+    crc32c_fold_constants(384, &g_crc32c_fold.k384[0], &g_crc32c_fold.k384[1]);
+    crc32c_fold_constants(256, &g_crc32c_fold.k256[0], &g_crc32c_fold.k256[1]);
+    crc32c_fold_constants(128, &g_crc32c_fold.k128[0], &g_crc32c_fold.k128[1]);
+}
+
+#define CRC32C_AVX512_TARGET "avx512f,avx512vl,avx512bw,vpclmulqdq,pclmul,sse4.2"
+
+__attribute__((target(CRC32C_AVX512_TARGET)))
+static inline __m512i crc32c_fold512(__m512i x, __m512i k, __m512i next) {
+    return _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x, k, 0x00),
+                                     _mm512_clmulepi64_epi128(x, k, 0x11), next, 0x96);
+}
+
+__attribute__((target(CRC32C_AVX512_TARGET)))
+static inline __m128i crc32c_fold128(__m128i x, const uint64_t *k) {
+    __m128i kv = _mm_set_epi64x((long long)k[1], (long long)k[0]);
+    return _mm_xor_si128(_mm_clmulepi64_si128(x, kv, 0x00), _mm_clmulepi64_si128(x, kv, 0x11));
+}
+
+#define CRC32C_BROADCAST(k) _mm512_set_epi64((long long)(k)[1], (long long)(k)[0], (long long)(k)[1], (long long)(k)[0], \
+                                             (long long)(k)[1], (long long)(k)[0], (long long)(k)[1], (long long)(k)[0])
+
+__attribute__((target(CRC32C_AVX512_TARGET)))
+uint32_t crc32c_avx512(uint32_t crc, const void *buf, size_t len) {
+    const uint8_t *p = (const uint8_t *)buf;
+    if (len < 256) {
+        return ~crc32c_raw_sse42(~crc, p, len);
+    }
+    const crc32c_fold_table &t = g_crc32c_fold;
+
+    // 初始状态异或到消息的前32位
+    __m512i x0 = _mm512_xor_si512(_mm512_loadu_si512(p), _mm512_castsi128_si512(_mm_cvtsi32_si128((int)~crc)));
+    __m512i x1 = _mm512_loadu_si512(p + 64);
+    __m512i x2 = _mm512_loadu_si512(p + 128);
+    __m512i x3 = _mm512_loadu_si512(p + 192);
+    p += 256;
+    len -= 256;
+
+    __m512i k = CRC32C_BROADCAST(t.k2048);
+    while (len >= 256) {
+        x0 = crc32c_fold512(x0, k, _mm512_loadu_si512(p));
+        x1 = crc32c_fold512(x1, k, _mm512_loadu_si512(p + 64));
+        x2 = crc32c_fold512(x2, k, _mm512_loadu_si512(p + 128));
+        x3 = crc32c_fold512(x3, k, _mm512_loadu_si512(p + 192));
+        p += 256;
+        len -= 256;
+    }
+
+    // 4个累加器合并为1个
+    k = CRC32C_BROADCAST(t.k512);
+    __m512i x = crc32c_fold512(x0, k, x1);
+    x = crc32c_fold512(x, k, x2);
+    x = crc32c_fold512(x, k, x3);
+    while (len >= 64) {
+        x = crc32c_fold512(x, k, _mm512_loadu_si512(p));
+        p += 64;
+        len -= 64;
+    }
+
+    // 512位合并为128位（经内存取出各通道，GCC的extract内建函数会误报未初始化警告）
+    alignas(64) __m128i lanes[4];
+    _mm512_store_si512(lanes, x);
+    __m128i r = lanes[3];
+    r = _mm_xor_si128(r, crc32c_fold128(lanes[0], t.k384));
+    r = _mm_xor_si128(r, crc32c_fold128(lanes[1], t.k256));
+    r = _mm_xor_si128(r, crc32c_fold128(lanes[2], t.k128));
+
+    // 剩余的128位和尾部字节交给crc32指令
+    uint64_t s = _mm_crc32_u64(0, (uint64_t)_mm_cvtsi128_si64(r));
+    s = _mm_crc32_u64(s, (uint64_t)_mm_extract_epi64(r, 1));
+    return ~crc32c_raw_sse42((uint32_t)s, p, len);
+}
+
+
+/* 运行时选择 */
+static crc32c_fn g_crc32c_impl = NULL;
+static const char *g_crc32c_impl_name = NULL;
+
+crc32c_fn crc32c_select(const char **name) {
+    if (!g_crc32c_impl) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+            __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("vpclmulqdq") &&
+            __builtin_cpu_supports("sse4.2")) {
+            crc32c_init_fold_table();
+            g_crc32c_impl = crc32c_avx512;
+            g_crc32c_impl_name = "avx512-vpclmulqdq";
+        } else if (__builtin_cpu_supports("sse4.2")) {
+            g_crc32c_impl = crc32c_sse42;
+            g_crc32c_impl_name = "sse4.2";
+        } else {
+            crc32c_init_table();    // 在这里建表，多线程第一次调用crc32c_sw时不会同时建表
+            g_crc32c_impl = crc32c_sw;
+            g_crc32c_impl_name = "scalar";
+        }
+    }
+    if (name) {
+        *name = g_crc32c_impl_name;
+    }
+    return g_crc32c_impl;
+}
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+    return crc32c_select(NULL)(crc, buf, len);
+}
+
+
+#endif  // _RDMA_CRC32C_HPP
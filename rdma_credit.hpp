@@ -0,0 +1,307 @@
+#ifndef _RDMA_CREDIT_HPP
+#define _RDMA_CREDIT_HPP
+
+#include "rdma_common.hpp"
+#include <deque>
+
+/*
+    基于信用(credit)的SEND/RECV流控
+
+    每端预先post CREDIT_WINDOW 个数据接收和 CREDIT_CTRL_SLOTS 个控制接收，并通过TCP告知对端。
+    发送方每发送一条数据消息消耗一个信用，信用为0时只轮询CQ而不发送，因此对端永远有可用的接收请求，
+    不会触发RNR NAK。接收方重新post接收后把信用攒起来：
+      - 有反向流量时，通过SEND_WITH_IMM的立即数据捎带归还；
+      - 单向流量时，攒够 CREDIT_RETURN_THRESHOLD 个后发送一条零长度的纯信用消息。
+    纯信用消息本身消耗对端的控制接收，控制信用同样通过立即数据归还。
+
+    立即数据格式（主机字节序）：
+      bit 31      纯信用消息标志
+      bit 16..23  归还的控制信用数
+      bit 0..15   归还的数据信用数
+*/
+
+#define CREDIT_WINDOW 16                            // 数据接收窗口
+#define CREDIT_CTRL_SLOTS 2                         // 为纯信用消息保留的接收数
+#define CREDIT_RECV_SLOTS (CREDIT_WINDOW + CREDIT_CTRL_SLOTS)
+#define CREDIT_SEND_SLOTS 16                        // 发送缓冲区个数
+#ifndef CREDIT_MSG_SIZE
+#define CREDIT_MSG_SIZE BUFFER_SIZE                 // 每个缓冲区大小，包含本文件前可以重新定义
+#endif
+#define CREDIT_RETURN_THRESHOLD (CREDIT_WINDOW / 2) // 单向流量时归还信用的阈值
+#define CREDIT_BUF_SIZE ((CREDIT_SEND_SLOTS + CREDIT_RECV_SLOTS) * CREDIT_MSG_SIZE)
+
+#define CREDIT_IMM_CTRL_FLAG 0x80000000u
+#define CREDIT_WR_SEND_FLAG  0x100000000ull         // 区分发送与接收的wr_id
+
+struct credit_msg {
+    uint32_t slot;      // 接收缓冲区下标
+    uint32_t len;       // 消息长度
+};
+
+struct credit_channel {
+    rdma_context *ctx;
+    char *send_bufs;
+    char *recv_bufs;
+    int data_credits;       // 还能向对端发送的数据消息数
+    int ctrl_credits;       // 还能向对端发送的纯信用消息数
+    int data_to_return;     // 已重新post但尚未归还给对端的数据接收数
+    int ctrl_to_return;     // 已重新post但尚未归还给对端的控制接收数
+    int send_inflight;      // 已post但未完成的发送
+    uint32_t next_send_slot;
+    bool ignore_credits;    // 对照组：忽略信用，依赖RNR重试
+    std::deque<credit_msg> ready;   // 已到达但尚未被取走的数据消息
+
+    // 统计信息
+    uint64_t credit_msgs_sent;      // 发送的纯信用消息数
+    uint64_t piggybacked;           // 捎带归还的信用总数
+    uint64_t credit_stalls;         // 因信用不足而等待的次数
+    uint64_t rnr_errors;            // RNR重试耗尽错误数
+};
+
+
+int credit_post_recv(credit_channel *ch, uint32_t slot) {
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)(ch->recv_bufs + (size_t)slot * CREDIT_MSG_SIZE);
+    sge.length = CREDIT_MSG_SIZE;
+    sge.lkey = ch->ctx->mr->lkey;
+
+    struct ibv_recv_wr recv_wr, *bad_recv_wr;
+    memset(&recv_wr, 0, sizeof(recv_wr));
+    recv_wr.wr_id = slot;
+    recv_wr.sg_list = &sge;
+    recv_wr.num_sge = 1;
+    if (ibv_post_recv(ch->ctx->qp, &recv_wr, &bad_recv_wr)) {
+        std::cerr << "Failed to post receive request" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 初始化信用通道并post全部接收，ctx->buffer至少要有CREDIT_BUF_SIZE字节
+int credit_channel_init(credit_channel *ch, rdma_context *_ctx) {
+    ch->ctx = _ctx;
+    ch->send_bufs = _ctx->buffer;
+    ch->recv_bufs = _ctx->buffer + (size_t)CREDIT_SEND_SLOTS * CREDIT_MSG_SIZE;
+    ch->data_credits = 0;
+    ch->ctrl_credits = 0;
+    ch->data_to_return = 0;
+    ch->ctrl_to_return = 0;
+    ch->send_inflight = 0;
+    ch->next_send_slot = 0;
+    ch->ignore_credits = false;
+    ch->ready.clear();
+    ch->credit_msgs_sent = 0;
+    ch->piggybacked = 0;
+    ch->credit_stalls = 0;
+    ch->rnr_errors = 0;
+    for (uint32_t i = 0; i < CREDIT_RECV_SLOTS; i++) {
+        if (credit_post_recv(ch, i) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 接收全部post完成后，通过TCP互相通告初始信用，同时作为开始发送前的同步点
+int credit_handshake(credit_channel *ch, int sock_fd) {
+    uint32_t local_credits[2] = {htonl(CREDIT_WINDOW), htonl(CREDIT_CTRL_SLOTS)};
+    uint32_t remote_credits[2];
+    if (sock_send_all(sock_fd, local_credits, sizeof(local_credits)) < 0 ||
+        sock_recv_all(sock_fd, remote_credits, sizeof(remote_credits)) < 0) {
+        std::cerr << "Failed to exchange initial credits" << std::endl;
+        return -1;
+    }
+    ch->data_credits = ntohl(remote_credits[0]);
+    ch->ctrl_credits = ntohl(remote_credits[1]);
+    return 0;
+}
+
+// 取出待归还的信用，编码到立即数据中
+uint32_t credit_take_imm(credit_channel *ch, bool ctrl_only) {
+    uint32_t data = std::min(ch->data_to_return, 0xffff);
+    uint32_t ctrl = std::min(ch->ctrl_to_return, 0xff);
+    ch->data_to_return -= data;
+    ch->ctrl_to_return -= ctrl;
+    ch->piggybacked += data;
+    return (ctrl_only ? CREDIT_IMM_CTRL_FLAG : 0) | (ctrl << 16) | data;
+}
+
+// 发送零长度的纯信用消息
+int credit_send_ctrl(credit_channel *ch) {
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = CREDIT_WR_SEND_FLAG | CREDIT_SEND_SLOTS;  // 不占用发送缓冲区
+    wr.opcode = IBV_WR_SEND_WITH_IMM;
+    wr.sg_list = NULL;
+    wr.num_sge = 0;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.imm_data = htonl(credit_take_imm(ch, true));
+    if (ibv_post_send(ch->ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post credit message" << std::endl;
+        return -1;
+    }
+    ch->ctrl_credits--;
+    ch->send_inflight++;
+    ch->credit_msgs_sent++;
+    return 0;
+}
+
+// 单向流量时，攒够阈值就主动归还信用
+int credit_maybe_return(credit_channel *ch) {
+    if (ch->data_to_return >= CREDIT_RETURN_THRESHOLD && ch->ctrl_credits > 0) {
+        return credit_send_ctrl(ch);
+    }
+    return 0;
+}
+
+// 轮询一次CQ，处理发送完成和接收完成，返回处理的完成数，出错返回-1
+int credit_progress(credit_channel *ch) {
+    struct ibv_wc wc[16];
+    int n = ibv_poll_cq(ch->ctx->cq, 16, wc);
+    if (n < 0) {
+        std::cerr << "Failed to poll CQ" << std::endl;
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (wc[i].status != IBV_WC_SUCCESS) {
+            if (wc[i].status == IBV_WC_RNR_RETRY_EXC_ERR) {
+                ch->rnr_errors++;
+            }
+            std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc[i].status) << std::endl;
+            return -1;
+        }
+        if (wc[i].wr_id & CREDIT_WR_SEND_FLAG) {
+            ch->send_inflight--;
+            continue;
+        }
+        uint32_t imm = (wc[i].wc_flags & IBV_WC_WITH_IMM) ? ntohl(wc[i].imm_data) : 0;
+        ch->data_credits += imm & 0xffff;
+        ch->ctrl_credits += (imm >> 16) & 0xff;
+        if (imm & CREDIT_IMM_CTRL_FLAG) {
+            // 纯信用消息：立即重新post，并记下要归还的控制信用
+            if (credit_post_recv(ch, (uint32_t)wc[i].wr_id) < 0) {
+                return -1;
+            }
+            ch->ctrl_to_return++;
+        } else {
+            credit_msg msg;
+            msg.slot = (uint32_t)wc[i].wr_id;
+            msg.len = wc[i].byte_len;
+            ch->ready.push_back(msg);
+        }
+    }
+    return n;
+}
+
+// 当前是否可以立即发送而不阻塞
+bool credit_can_send(credit_channel *ch) {
+    return (ch->ignore_credits || ch->data_credits > 0) && ch->send_inflight < CREDIT_SEND_SLOTS;
+}
+
+// 取得下一个发送缓冲区，信用不足时轮询CQ等待对端归还；调用方直接在其中填写数据后调用credit_send_commit
+char *credit_send_acquire(credit_channel *ch) {
+    bool stalled = false;
+    while (!credit_can_send(ch)) {
+        stalled = true;
+        if (credit_progress(ch) < 0) {
+            return NULL;
+        }
+    }
+    if (stalled) {
+        ch->credit_stalls++;
+    }
+    return ch->send_bufs + (size_t)ch->next_send_slot * CREDIT_MSG_SIZE;
+}
+
+// 发送credit_send_acquire返回的缓冲区中的len字节
+int credit_send_commit(credit_channel *ch, uint32_t len) {
+    uint32_t slot = ch->next_send_slot;
+    ch->next_send_slot = (ch->next_send_slot + 1) % CREDIT_SEND_SLOTS;
+    char *buf = ch->send_bufs + (size_t)slot * CREDIT_MSG_SIZE;
+
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)buf;
+    sge.length = len;                       // 只发送有效负载，而不是整个缓冲区
+    sge.lkey = ch->ctx->mr->lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = CREDIT_WR_SEND_FLAG | slot;
+    wr.opcode = IBV_WR_SEND_WITH_IMM;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.imm_data = htonl(credit_take_imm(ch, false));    // 捎带归还信用
+    if (ibv_post_send(ch->ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post send request" << std::endl;
+        return -1;
+    }
+    ch->data_credits--;
+    ch->send_inflight++;
+    return 0;
+}
+
+// 发送一条数据消息，信用不足时轮询CQ等待对端归还
+int credit_send(credit_channel *ch, const void *data, uint32_t len) {
+    if (len > CREDIT_MSG_SIZE) {
+        std::cerr << "Message too large: " << len << std::endl;
+        return -1;
+    }
+    char *buf = credit_send_acquire(ch);
+    if (!buf) {
+        return -1;
+    }
+    memcpy(buf, data, len);
+    return credit_send_commit(ch, len);
+}
+
+// 取得下一条数据消息在接收缓冲区中的位置（不拷贝），用完后调用credit_recv_release
+const char *credit_recv_peek(credit_channel *ch, uint32_t *len) {
+    while (ch->ready.empty()) {
+        if (credit_progress(ch) < 0) {
+            return NULL;
+        }
+    }
+    const credit_msg &msg = ch->ready.front();
+    *len = msg.len;
+    return ch->recv_bufs + (size_t)msg.slot * CREDIT_MSG_SIZE;
+}
+
+// 释放credit_recv_peek取得的消息：重新post接收并记下要归还的信用
+int credit_recv_release(credit_channel *ch) {
+    credit_msg msg = ch->ready.front();
+    ch->ready.pop_front();
+    if (credit_post_recv(ch, msg.slot) < 0) {
+        return -1;
+    }
+    ch->data_to_return++;
+    return credit_maybe_return(ch);
+}
+
+// 接收一条数据消息，拷贝到buf后立即重新post接收，返回消息长度
+int credit_recv(credit_channel *ch, void *buf, uint32_t max_len) {
+    uint32_t msg_len;
+    const char *data = credit_recv_peek(ch, &msg_len);
+    if (!data) {
+        return -1;
+    }
+    uint32_t len = std::min(msg_len, max_len);
+    memcpy(buf, data, len);
+    if (credit_recv_release(ch) < 0) {
+        return -1;
+    }
+    return (int)len;
+}
+
+// 等待所有发送完成
+int credit_drain(credit_channel *ch) {
+    while (ch->send_inflight > 0) {
+        if (credit_progress(ch) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+#endif  // _RDMA_CREDIT_HPP
@@ -0,0 +1,228 @@
+#ifndef _RDMA_DELTA_HPP
+#define _RDMA_DELTA_HPP
+
+#include "rdma_common.hpp"
+#include "rdma_crc32c.hpp"
+#include <thread>
+#include <random>
+
+/*
+    基于块指纹的增量同步
+
+    服务端缓冲区布局：[ 数据 (size) | 指纹数组 (nblocks × uint32) ]，指纹为每块的CRC32C，
+    服务端在数据变化后自行重新计算。同步一次的过程：
+      1. RDMA_READ 整个指纹数组；读的同时多线程计算本地每块的指纹；
+      2. 逐块比较，相邻的变化块合并成一段（不超过 DELTA_MAX_RUN 字节）；
+      3. 每段一个RDMA_WRITE，每 DELTA_CHAIN 个WR串成一条链post，只有最后一个带完成通知。
+    全量传输走同一条路径，只是把所有块都当作变化块。
+    CRC32C能检出任意不超过32位的突发错误，其他修改漏检的概率约为 2^-32 每块。
+*/
+
+#define DELTA_CHAIN 32                  // 每条WR链的长度
+#define DELTA_SQ_DEPTH 128              // 在途WR数上限
+#define DELTA_MAX_RUN (1 << 20)         // 合并后每个WR的最大长度
+#define DELTA_WR_READ 0x44520000ull
+
+// 客户端通过TCP发给服务端的命令
+enum delta_cmd {
+    DELTA_CMD_VERIFY = 1,
+    DELTA_CMD_DONE = 2,
+};
+
+// 客户端在开始时发给服务端的参数
+struct delta_config {
+    uint64_t size;
+    uint32_t block_size;
+    uint32_t seed;
+};
+
+struct delta_run {
+    uint64_t offset;
+    uint32_t length;
+};
+
+struct delta_stats {
+    uint64_t changed_blocks;
+    uint64_t wrs;
+    uint64_t chains;
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+};
+
+
+// 由种子生成初始数据，两端相同
+void fill_base(char *data, uint64_t size, uint32_t seed) {
+    std::mt19937_64 rng(seed);
+    for (uint64_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t v = rng();
+        memcpy(data + i, &v, sizeof(v));
+    }
+}
+
+// 多线程计算nblocks个块的指纹，最后一块可以不满
+void delta_fingerprints(const char *data, uint64_t size, uint32_t block_size, uint32_t *fps, int nthreads) {
+    uint64_t nblocks = (size + block_size - 1) / block_size;
+    crc32c_select(NULL);    // 在启动线程之前完成实现选择和表初始化
+    auto worker = [=](uint64_t begin, uint64_t end) {
+        for (uint64_t b = begin; b < end; b++) {
+            uint64_t off = b * block_size;
+            fps[b] = crc32c(0, data + off, std::min<uint64_t>(block_size, size - off));
+        }
+    };
+    std::vector<std::thread> threads;
+    uint64_t per_thread = (nblocks + nthreads - 1) / nthreads;
+    for (int t = 1; t < nthreads; t++) {
+        uint64_t begin = std::min(nblocks, t * per_thread);
+        threads.emplace_back(worker, begin, std::min(nblocks, begin + per_thread));
+    }
+    worker(0, std::min(nblocks, per_thread));
+    for (std::thread &th : threads) {
+        th.join();
+    }
+}
+
+// 比较本地和远端指纹，把变化的块合并成段，返回变化的块数
+uint64_t delta_diff(const uint32_t *local_fps, const uint32_t *remote_fps, uint64_t size, uint32_t block_size,
+                    std::vector<delta_run> *runs) {
+    uint64_t nblocks = (size + block_size - 1) / block_size;
+    uint64_t changed = 0;
+    runs->clear();
+    for (uint64_t b = 0; b < nblocks; b++) {
+        if (local_fps[b] == remote_fps[b]) {
+            continue;
+        }
+        changed++;
+        uint64_t off = b * block_size;
+        uint32_t len = (uint32_t)std::min<uint64_t>(block_size, size - off);
+        if (!runs->empty()) {
+            delta_run &last = runs->back();
+            if (last.offset + last.length == off && last.length + len <= DELTA_MAX_RUN) {
+                last.length += len;
+                continue;
+            }
+        }
+        runs->push_back({off, len});
+    }
+    return changed;
+}
+
+// 把所有块作为变化块（全量传输）
+void delta_full_runs(uint64_t size, std::vector<delta_run> *runs) {
+    runs->clear();
+    for (uint64_t off = 0; off < size; off += DELTA_MAX_RUN) {
+        runs->push_back({off, (uint32_t)std::min<uint64_t>(DELTA_MAX_RUN, size - off)});
+    }
+}
+
+// 等待一条WR链完成
+int delta_wait_one(rdma_context *_ctx) {
+    struct ibv_wc wc;
+    int n;
+    while ((n = ibv_poll_cq(_ctx->cq, 1, &wc)) == 0);
+    if (n < 0) {
+        std::cerr << "Failed to poll CQ" << std::endl;
+        return -1;
+    }
+    if (wc.status != IBV_WC_SUCCESS) {
+        std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc.status) << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// post读取远端指纹数组，不等待完成
+int delta_post_read_fps(rdma_context *_ctx, uint32_t *local_fps, uint64_t bytes, uint64_t remote_addr, uint32_t rkey) {
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)local_fps;
+    sge.length = (uint32_t)bytes;
+    sge.lkey = _ctx->mr->lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = DELTA_WR_READ;
+    wr.opcode = IBV_WR_RDMA_READ;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = remote_addr;
+    wr.wr.rdma.rkey = rkey;
+    if (ibv_post_send(_ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post fingerprint read" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 把各段从本地local写到远端remote_addr的相同偏移处，等待全部完成
+int delta_write_runs(rdma_context *_ctx, const std::vector<delta_run> &runs, const char *local, uint64_t remote_addr,
+                     uint32_t rkey, delta_stats *stats) {
+    struct ibv_sge sges[DELTA_CHAIN];
+    struct ibv_send_wr wrs[DELTA_CHAIN];
+    int chains_inflight = 0;
+    size_t i = 0;
+    while (i < runs.size()) {
+        // 发送队列满时先等最早的一条链完成
+        if ((chains_inflight + 1) * DELTA_CHAIN > DELTA_SQ_DEPTH) {
+            if (delta_wait_one(_ctx) < 0) {
+                return -1;
+            }
+            chains_inflight--;
+        }
+        int n = 0;
+        while (n < DELTA_CHAIN && i < runs.size()) {
+            const delta_run &run = runs[i++];
+            sges[n].addr = (uintptr_t)(local + run.offset);
+            sges[n].length = run.length;
+            sges[n].lkey = _ctx->mr->lkey;
+            memset(&wrs[n], 0, sizeof(wrs[n]));
+            wrs[n].opcode = IBV_WR_RDMA_WRITE;
+            wrs[n].sg_list = &sges[n];
+            wrs[n].num_sge = 1;
+            wrs[n].wr.rdma.remote_addr = remote_addr + run.offset;
+            wrs[n].wr.rdma.rkey = rkey;
+            if (n > 0) {
+                wrs[n - 1].next = &wrs[n];
+            }
+            stats->bytes_written += run.length;
+            n++;
+        }
+        wrs[n - 1].send_flags = IBV_SEND_SIGNALED;
+        struct ibv_send_wr *bad_wr;
+        if (ibv_post_send(_ctx->qp, &wrs[0], &bad_wr)) {
+            std::cerr << "Failed to post write chain" << std::endl;
+            return -1;
+        }
+        chains_inflight++;
+        stats->wrs += n;
+        stats->chains++;
+    }
+    while (chains_inflight > 0) {
+        if (delta_wait_one(_ctx) < 0) {
+            return -1;
+        }
+        chains_inflight--;
+    }
+    return 0;
+}
+
+// 一次增量同步：local为本地数据，local_fps / remote_fps 为两个指纹数组的本地暂存区（必须在注册内存中）
+int delta_sync(rdma_context *_ctx, const char *local, uint64_t size, uint32_t block_size, uint32_t *local_fps,
+               uint32_t *remote_fps, uint64_t remote_addr, uint32_t rkey, int nthreads, delta_stats *stats) {
+    uint64_t nblocks = (size + block_size - 1) / block_size;
+    uint64_t fp_bytes = nblocks * sizeof(uint32_t);
+    if (delta_post_read_fps(_ctx, remote_fps, fp_bytes, remote_addr + size, rkey) < 0) {
+        return -1;
+    }
+    delta_fingerprints(local, size, block_size, local_fps, nthreads);    // 与读指纹数组重叠
+    if (delta_wait_one(_ctx) < 0) {
+        return -1;
+    }
+    stats->bytes_read += fp_bytes;
+
+    std::vector<delta_run> runs;
+    stats->changed_blocks += delta_diff(local_fps, remote_fps, size, block_size, &runs);
+    return delta_write_runs(_ctx, runs, local, remote_addr, rkey, stats);
+}
+
+
+#endif  // _RDMA_DELTA_HPP
@@ -0,0 +1,317 @@
+#ifndef _RDMA_EC_HPP
+#define _RDMA_EC_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <immintrin.h>
+
+/*
+    GF(2^8) 上的 Reed-Solomon 纠删码（系统码）
+
+    k个数据分片 + m个校验分片，任意k个分片即可恢复原始数据。
+    生成矩阵的前k行是单位矩阵，后m行是柯西矩阵 c[i][j] = 1 / ((k + i) ^ j)，其任意k×k子矩阵都可逆。
+    本原多项式为 x^8 + x^4 + x^3 + x^2 + 1 (0x11d)。
+
+    乘以常数c用两次16项查表完成：c*x = c*(x & 0x0f) ^ c*(x & 0xf0)，
+    SSSE3/AVX2 版本用 pshufb 一次查16/32个字节。每个系数预先展开成64字节的表：
+      [0, 32)   低半字节表，16字节重复两次（AVX2直接加载，SSSE3取前16字节）
+      [32, 64)  高半字节表
+    内核计算 dst = sum(c_j * src_j)，所有源在寄存器中累加，目标只写一次。
+*/
+
+#define EC_MAX_FRAGS 32
+#define EC_TABLE_SIZE 64
+#define EC_CHUNK 16384      // 编码时按块处理，使源分片的这一段留在L2中供m个校验分片复用
+
+enum ec_level { EC_SCALAR, EC_SSSE3, EC_AVX2 };
+
+typedef void (*ec_dot_fn)(const uint8_t *tbls, int nsrc, const uint8_t *const *src, uint8_t *dst, size_t len);
+
+static uint8_t g_gf_exp[512];
+static uint8_t g_gf_log[256];
+static bool g_gf_ready = false;
+
+void gf_init_tables() {
+    if (g_gf_ready) {
+        return;
+    }
+    uint32_t x = 1;
+    for (int i = 0; i < 255; i++) {
+        g_gf_exp[i] = (uint8_t)x;
+        g_gf_log[x] = (uint8_t)i;
+        x <<= 1;
+        if (x & 0x100) {
+            x ^= 0x11d;
+        }
+    }
+    for (int i = 255; i < 512; i++) {
+        g_gf_exp[i] = g_gf_exp[i - 255];
+    }
+    g_gf_ready = true;
+}
+
+inline uint8_t gf_mul(uint8_t a, uint8_t b) {
+    if (a == 0 || b == 0) {
+        return 0;
+    }
+    return g_gf_exp[g_gf_log[a] + g_gf_log[b]];
+}
+
+inline uint8_t gf_inv(uint8_t a) {
+    return g_gf_exp[255 - g_gf_log[a]];
+}
+
+// 展开常数c的查表
+void gf_expand_table(uint8_t c, uint8_t *tbl) {
+    for (int x = 0; x < 16; x++) {
+        tbl[x] = tbl[x + 16] = gf_mul(c, (uint8_t)x);
+        tbl[x + 32] = tbl[x + 48] = gf_mul(c, (uint8_t)(x << 4));
+    }
+}
+
+// 求n×n矩阵的逆（高斯-约当消元），不可逆返回-1
+int gf_invert_matrix(std::vector<uint8_t> &a, std::vector<uint8_t> &inv, int n) {
+    inv.assign((size_t)n * n, 0);
+    for (int i = 0; i < n; i++) {
+        inv[i * n + i] = 1;
+    }
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        while (pivot < n && a[pivot * n + col] == 0) {
+            pivot++;
+        }
+        if (pivot == n) {
+            return -1;
+        }
+        if (pivot != col) {
+            for (int j = 0; j < n; j++) {
+                std::swap(a[pivot * n + j], a[col * n + j]);
+                std::swap(inv[pivot * n + j], inv[col * n + j]);
+            }
+        }
+        uint8_t scale = gf_inv(a[col * n + col]);
+        for (int j = 0; j < n; j++) {
+            a[col * n + j] = gf_mul(a[col * n + j], scale);
+            inv[col * n + j] = gf_mul(inv[col * n + j], scale);
+        }
+        for (int row = 0; row < n; row++) {
+            uint8_t f = a[row * n + col];
+            if (row == col || f == 0) {
+                continue;
+            }
+            for (int j = 0; j < n; j++) {
+                a[row * n + j] ^= gf_mul(f, a[col * n + j]);
+                inv[row * n + j] ^= gf_mul(f, inv[col * n + j]);
+            }
+        }
+    }
+    return 0;
+}
+
+
+/* 内核 */
+void ec_dot_scalar(const uint8_t *tbls, int nsrc, const uint8_t *const *src, uint8_t *dst, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        uint8_t acc = 0;
+        for (int j = 0; j < nsrc; j++) {
+            const uint8_t *t = tbls + j * EC_TABLE_SIZE;
+            uint8_t x = src[j][i];
+            acc ^= t[x & 0x0f] ^ t[32 + (x >> 4)];
+        }
+        dst[i] = acc;
+    }
+}
+
+__attribute__((target("ssse3")))
+void ec_dot_ssse3(const uint8_t *tbls, int nsrc, const uint8_t *const *src, uint8_t *dst, size_t len) {
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i acc = _mm_setzero_si128();
+        for (int j = 0; j < nsrc; j++) {
+            const uint8_t *t = tbls + j * EC_TABLE_SIZE;
+            __m128i x = _mm_loadu_si128((const __m128i *)(src[j] + i));
+            __m128i lo = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)t), _mm_and_si128(x, mask));
+            __m128i hi = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(t + 32)),
+                                          _mm_and_si128(_mm_srli_epi64(x, 4), mask));
+            acc = _mm_xor_si128(acc, _mm_xor_si128(lo, hi));
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), acc);
+    }
+    if (i < len) {
+        const uint8_t *tail[EC_MAX_FRAGS];
+        for (int j = 0; j < nsrc; j++) {
+            tail[j] = src[j] + i;
+        }
+        ec_dot_scalar(tbls, nsrc, tail, dst + i, len - i);
+    }
+}
+
+// 每次处理64字节（两个累加器），表在循环内从L1加载
+__attribute__((target("avx2")))
+void ec_dot_avx2(const uint8_t *tbls, int nsrc, const uint8_t *const *src, uint8_t *dst, size_t len) {
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        for (int j = 0; j < nsrc; j++) {
+            const uint8_t *t = tbls + j * EC_TABLE_SIZE;
+            __m256i tlo = _mm256_loadu_si256((const __m256i *)t);
+            __m256i thi = _mm256_loadu_si256((const __m256i *)(t + 32));
+            __m256i x0 = _mm256_loadu_si256((const __m256i *)(src[j] + i));
+            __m256i x1 = _mm256_loadu_si256((const __m256i *)(src[j] + i + 32));
+            acc0 = _mm256_xor_si256(acc0, _mm256_xor_si256(
+                _mm256_shuffle_epi8(tlo, _mm256_and_si256(x0, mask)),
+                _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(x0, 4), mask))));
+            acc1 = _mm256_xor_si256(acc1, _mm256_xor_si256(
+                _mm256_shuffle_epi8(tlo, _mm256_and_si256(x1, mask)),
+                _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(x1, 4), mask))));
+        }
+        _mm256_storeu_si256((__m256i *)(dst + i), acc0);
+        _mm256_storeu_si256((__m256i *)(dst + i + 32), acc1);
+    }
+    if (i < len) {
+        const uint8_t *tail[EC_MAX_FRAGS];
+        for (int j = 0; j < nsrc; j++) {
+            tail[j] = src[j] + i;
+        }
+        ec_dot_ssse3(tbls, nsrc, tail, dst + i, len - i);
+    }
+}
+
+static const ec_dot_fn g_ec_kernels[3] = {ec_dot_scalar, ec_dot_ssse3, ec_dot_avx2};
+static const char *g_ec_level_names[3] = {"scalar", "ssse3", "avx2"};
+
+// 当前CPU支持的最高级别
+ec_level ec_best_level() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return EC_AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return EC_SSSE3;
+    }
+    return EC_SCALAR;
+}
+
+// 取指定级别的内核，level超过CPU能力时返回NULL
+ec_dot_fn ec_kernel(ec_level level, const char **name) {
+    if (level > ec_best_level()) {
+        return NULL;
+    }
+    if (name) {
+        *name = g_ec_level_names[level];
+    }
+    return g_ec_kernels[level];
+}
+
+
+/* 编解码 */
+struct ec_codec {
+    int k;
+    int m;
+    std::vector<uint8_t> matrix;        // (k + m) × k 生成矩阵
+    std::vector<uint8_t> parity_tbls;   // m × k 个校验系数的查表
+    ec_dot_fn dot;
+};
+
+int ec_codec_init(ec_codec *codec, int k, int m, ec_level level) {
+    if (k < 1 || m < 0 || k + m > EC_MAX_FRAGS) {
+        std::cerr << "Unsupported code: k = " << k << ", m = " << m << std::endl;
+        return -1;
+    }
+    codec->dot = ec_kernel(level, NULL);
+    if (!codec->dot) {
+        std::cerr << "Kernel level " << g_ec_level_names[level] << " not supported by this CPU" << std::endl;
+        return -1;
+    }
+    gf_init_tables();
+    codec->k = k;
+    codec->m = m;
+    codec->matrix.assign((size_t)(k + m) * k, 0);
+    for (int r = 0; r < k; r++) {
+        codec->matrix[r * k + r] = 1;
+    }
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < k; j++) {
+            codec->matrix[(k + i) * k + j] = gf_inv((uint8_t)((k + i) ^ j));
+        }
+    }
+    codec->parity_tbls.resize((size_t)m * k * EC_TABLE_SIZE);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < k; j++) {
+            gf_expand_table(codec->matrix[(k + i) * k + j], &codec->parity_tbls[(i * k + j) * EC_TABLE_SIZE]);
+        }
+    }
+    return 0;
+}
+
+// 由k个数据分片计算m个校验分片
+void ec_encode(const ec_codec *codec, const uint8_t *const *data, uint8_t *const *parity, size_t frag_size) {
+    const uint8_t *src[EC_MAX_FRAGS];
+    for (size_t off = 0; off < frag_size; off += EC_CHUNK) {
+        size_t len = std::min((size_t)EC_CHUNK, frag_size - off);
+        for (int j = 0; j < codec->k; j++) {
+            src[j] = data[j] + off;
+        }
+        for (int i = 0; i < codec->m; i++) {
+            codec->dot(&codec->parity_tbls[(size_t)i * codec->k * EC_TABLE_SIZE], codec->k, src, parity[i] + off, len);
+        }
+    }
+}
+
+// frags[0..k+m) 指向各分片，avail标记可用的分片；用前k个可用分片重建所有缺失的数据分片（写入frags[j]）
+int ec_reconstruct(const ec_codec *codec, uint8_t *const *frags, const bool *avail, size_t frag_size) {
+    int k = codec->k;
+    int rows[EC_MAX_FRAGS];
+    int nrows = 0;
+    for (int i = 0; i < k + codec->m && nrows < k; i++) {
+        if (avail[i]) {
+            rows[nrows++] = i;
+        }
+    }
+    if (nrows < k) {
+        std::cerr << "Only " << nrows << " fragments available, need " << k << std::endl;
+        return -1;
+    }
+    bool missing = false;
+    for (int j = 0; j < k; j++) {
+        missing |= !avail[j];
+    }
+    if (!missing) {
+        return 0;
+    }
+
+    // 可用分片 = 子矩阵 × 数据，数据 = 子矩阵的逆 × 可用分片
+    std::vector<uint8_t> sub((size_t)k * k), inv;
+    for (int r = 0; r < k; r++) {
+        memcpy(&sub[r * k], &codec->matrix[rows[r] * k], k);
+    }
+    if (gf_invert_matrix(sub, inv, k) < 0) {
+        std::cerr << "Decode matrix is singular" << std::endl;
+        return -1;
+    }
+    const uint8_t *src[EC_MAX_FRAGS];
+    for (int r = 0; r < k; r++) {
+        src[r] = frags[rows[r]];
+    }
+    std::vector<uint8_t> tbls((size_t)k * EC_TABLE_SIZE);
+    for (int j = 0; j < k; j++) {
+        if (avail[j]) {
+            continue;
+        }
+        for (int r = 0; r < k; r++) {
+            gf_expand_table(inv[j * k + r], &tbls[r * EC_TABLE_SIZE]);
+        }
+        codec->dot(tbls.data(), k, src, frags[j], frag_size);
+    }
+    return 0;
+}
+
+
+#endif  // _RDMA_EC_HPP
@@ -0,0 +1,396 @@
+#ifndef _RDMA_FARMEM_HPP
+#define _RDMA_FARMEM_HPP
+
+#include "rdma_common.hpp"
+
+/*
+    远端内存页缓存 (far memory)
+
+    服务端只负责捐出一大块注册内存（qp_info.addr + rkey），客户端把它按 page_size 切页，
+    在本地维护 nframes 个页框的缓存：
+      - 缺页时用RDMA_READ把整页读入本地页框；
+      - 淘汰采用CLOCK算法，扫描时遇到脏页先加入写回批次，攒够 FARMEM_WB_BATCH 个后
+        串成一条RDMA_WRITE链一次写回，尽量找干净页淘汰；
+      - 缺页序列呈现固定步长（顺序访问即步长为1）时，异步预取后续 FARMEM_PREFETCH_DEPTH 页。
+    farmem_access 返回的指针只在下一次访问前有效。
+*/
+
+#define FARMEM_WB_BATCH 16          // 一次写回的脏页数
+#define FARMEM_PREFETCH_DEPTH 8     // 预取深度
+#define FARMEM_MAX_INFLIGHT 32      // 在途RDMA请求上限
+#define FARMEM_NO_FRAME -1
+
+struct farmem_frame {
+    int64_t page_no;        // 对应的远端页号，-1表示空闲
+    bool referenced;        // CLOCK引用位
+    bool dirty;
+    bool loading;           // RDMA_READ尚未完成
+    bool queued;            // 已加入写回批次但尚未post
+    bool writing;           // 写回尚未完成
+    bool prefetched;        // 由预取读入且尚未被访问
+};
+
+struct farmem_stats {
+    uint64_t accesses;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t prefetch_issued;
+    uint64_t prefetch_hits;     // 缺页被预取提前满足的次数
+    uint64_t evictions;
+    uint64_t writebacks;
+    uint64_t writeback_batches;
+};
+
+struct farmem_cache {
+    rdma_context *ctx;              // ctx->buffer 即本地页框
+    uint64_t remote_addr;
+    uint32_t rkey;
+    uint64_t remote_pages;
+    uint32_t page_size;
+    uint32_t nframes;
+    std::vector<int32_t> page_table;    // 远端页号 -> 页框号
+    std::vector<farmem_frame> frames;
+    std::vector<uint32_t> wb_batch;     // 待写回的页框
+    uint32_t clock_hand;
+    int inflight;
+
+    // 步长检测
+    bool prefetch_enabled;
+    int64_t last_miss;          // 上一次缺页（或预取命中）的页号
+    int64_t last_stride;
+    int stride_hits;            // 连续出现相同步长的次数
+    int64_t prefetch_next;      // 下一个要预取的页号
+
+    farmem_stats stats;
+};
+
+
+// ctx->buffer 需要至少 nframes * page_size 字节并已注册
+void farmem_init(farmem_cache *fc, rdma_context *_ctx, const qp_info *remote_info, uint64_t remote_size,
+                 uint32_t page_size, uint32_t nframes) {
+    fc->ctx = _ctx;
+    fc->remote_addr = remote_info->addr;
+    fc->rkey = remote_info->rkey;
+    fc->remote_pages = remote_size / page_size;
+    fc->page_size = page_size;
+    fc->nframes = nframes;
+    fc->page_table.assign(fc->remote_pages, FARMEM_NO_FRAME);
+    farmem_frame empty = {-1, false, false, false, false, false, false};
+    fc->frames.assign(nframes, empty);
+    fc->wb_batch.clear();
+    fc->clock_hand = 0;
+    fc->inflight = 0;
+    fc->prefetch_enabled = true;
+    fc->last_miss = -1;
+    fc->last_stride = 0;
+    fc->stride_hits = 0;
+    fc->prefetch_next = -1;
+    memset(&fc->stats, 0, sizeof(fc->stats));
+}
+
+char *farmem_frame_addr(farmem_cache *fc, uint32_t frame) {
+    return fc->ctx->buffer + (size_t)frame * fc->page_size;
+}
+
+// 处理完成队列，wr_id为页框号；block为true时至少等到一个完成
+int farmem_poll(farmem_cache *fc, bool block) {
+    struct ibv_wc wc[16];
+    int n;
+    do {
+        n = ibv_poll_cq(fc->ctx->cq, 16, wc);
+    } while (block && n == 0);
+    if (n < 0) {
+        std::cerr << "Failed to poll CQ" << std::endl;
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (wc[i].status != IBV_WC_SUCCESS) {
+            std::cerr << "RDMA operation failed with status " << ibv_wc_status_str(wc[i].status) << std::endl;
+            return -1;
+        }
+        farmem_frame &f = fc->frames[wc[i].wr_id];
+        f.loading = false;
+        f.writing = false;
+        fc->inflight--;
+    }
+    return n;
+}
+
+// 给一条RDMA链预留在途名额
+int farmem_reserve(farmem_cache *fc, int count) {
+    while (fc->inflight + count > FARMEM_MAX_INFLIGHT) {
+        if (farmem_poll(fc, true) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 把写回批次串成一条RDMA_WRITE链post出去
+int farmem_flush_batch(farmem_cache *fc) {
+    if (fc->wb_batch.empty()) {
+        return 0;
+    }
+    size_t count = fc->wb_batch.size();
+    if (farmem_reserve(fc, (int)count) < 0) {
+        return -1;
+    }
+    std::vector<struct ibv_sge> sges(count);
+    std::vector<struct ibv_send_wr> wrs(count);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t frame = fc->wb_batch[i];
+        farmem_frame &f = fc->frames[frame];
+        sges[i].addr = (uintptr_t)farmem_frame_addr(fc, frame);
+        sges[i].length = fc->page_size;
+        sges[i].lkey = fc->ctx->mr->lkey;
+        memset(&wrs[i], 0, sizeof(wrs[i]));
+        wrs[i].wr_id = frame;
+        wrs[i].opcode = IBV_WR_RDMA_WRITE;
+        wrs[i].sg_list = &sges[i];
+        wrs[i].num_sge = 1;
+        wrs[i].send_flags = IBV_SEND_SIGNALED;
+        wrs[i].wr.rdma.remote_addr = fc->remote_addr + (uint64_t)f.page_no * fc->page_size;
+        wrs[i].wr.rdma.rkey = fc->rkey;
+        wrs[i].next = i + 1 < count ? &wrs[i + 1] : NULL;
+        f.dirty = false;      // post之前的修改都会被这次写回带走
+        f.queued = false;
+        f.writing = true;
+    }
+    struct ibv_send_wr *bad_wr;
+    if (ibv_post_send(fc->ctx->qp, &wrs[0], &bad_wr)) {
+        std::cerr << "Failed to post write-back batch" << std::endl;
+        return -1;
+    }
+    fc->inflight += (int)count;
+    fc->stats.writebacks += count;
+    fc->stats.writeback_batches++;
+    fc->wb_batch.clear();
+    return 0;
+}
+
+// CLOCK选择一个可用页框，并把原来的页从页表中摘除
+int64_t farmem_evict(farmem_cache *fc) {
+    uint32_t scanned = 0;
+    while (true) {
+        uint32_t frame = fc->clock_hand;
+        fc->clock_hand = (fc->clock_hand + 1) % fc->nframes;
+        farmem_frame &f = fc->frames[frame];
+
+        if (f.page_no < 0 && !f.loading && !f.writing) {
+            return frame;
+        }
+        if (!f.loading && !f.writing && !f.queued) {
+            if (f.referenced) {
+                f.referenced = false;           // 第二次机会
+            } else if (f.dirty) {
+                fc->wb_batch.push_back(frame);  // 先攒起来批量写回，继续找干净页
+                f.queued = true;
+                if (fc->wb_batch.size() >= FARMEM_WB_BATCH && farmem_flush_batch(fc) < 0) {
+                    return -1;
+                }
+            } else {
+                fc->page_table[f.page_no] = FARMEM_NO_FRAME;
+                f.page_no = -1;
+                f.prefetched = false;
+                fc->stats.evictions++;
+                return frame;
+            }
+        }
+        // 扫描了两圈仍没有干净页，说明都在写回或读入中，写出批次并等待
+        if (++scanned >= 2 * fc->nframes) {
+            if (farmem_flush_batch(fc) < 0 || farmem_poll(fc, true) < 0) {
+                return -1;
+            }
+            scanned = 0;
+        }
+    }
+}
+
+// 把远端页page_no读入一个页框，异步完成
+int64_t farmem_fetch(farmem_cache *fc, uint64_t page_no, bool prefetch) {
+    int64_t frame = farmem_evict(fc);
+    if (frame < 0 || farmem_reserve(fc, 1) < 0) {
+        return -1;
+    }
+    farmem_frame &f = fc->frames[frame];
+    f.page_no = (int64_t)page_no;
+    f.referenced = !prefetch;
+    f.dirty = false;
+    f.loading = true;
+    f.prefetched = prefetch;
+    fc->page_table[page_no] = (int32_t)frame;
+
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)farmem_frame_addr(fc, (uint32_t)frame);
+    sge.length = fc->page_size;
+    sge.lkey = fc->ctx->mr->lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = frame;
+    wr.opcode = IBV_WR_RDMA_READ;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = fc->remote_addr + page_no * fc->page_size;
+    wr.wr.rdma.rkey = fc->rkey;
+    if (ibv_post_send(fc->ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post page read" << std::endl;
+        return -1;
+    }
+    fc->inflight++;
+    return frame;
+}
+
+// 记录一次缺页或预取命中，检测访问步长
+void farmem_detect_stride(farmem_cache *fc, uint64_t page_no) {
+    int64_t stride = fc->last_miss >= 0 ? (int64_t)page_no - fc->last_miss : 0;
+    if (stride != 0 && stride == fc->last_stride) {
+        fc->stride_hits++;
+    } else {
+        fc->stride_hits = 0;
+        fc->prefetch_next = -1;
+    }
+    fc->last_stride = stride;
+    fc->last_miss = (int64_t)page_no;
+    if (fc->stride_hits >= 1 && fc->prefetch_next < 0) {
+        fc->prefetch_next = (int64_t)page_no + stride;
+    }
+}
+
+// 连续两次步长相同后，保持预取窗口领先当前页 FARMEM_PREFETCH_DEPTH 个步长
+int farmem_prefetch_ahead(farmem_cache *fc, uint64_t page_no) {
+    if (!fc->prefetch_enabled || fc->stride_hits < 1 || fc->prefetch_next < 0) {
+        return 0;
+    }
+    int64_t stride = fc->last_stride;
+    int64_t limit = (int64_t)page_no + stride * FARMEM_PREFETCH_DEPTH;
+    while (stride > 0 ? fc->prefetch_next <= limit : fc->prefetch_next >= limit) {
+        int64_t target = fc->prefetch_next;
+        if (target < 0 || (uint64_t)target >= fc->remote_pages) {
+            break;
+        }
+        if (fc->page_table[target] == FARMEM_NO_FRAME) {
+            if (farmem_fetch(fc, (uint64_t)target, true) < 0) {
+                return -1;
+            }
+            fc->stats.prefetch_issued++;
+        }
+        fc->prefetch_next += stride;
+    }
+    return 0;
+}
+
+// 访问远端地址addr所在的页，返回本地指针；write为true时标记为脏页
+char *farmem_access(farmem_cache *fc, uint64_t addr, bool write) {
+    uint64_t page_no = addr / fc->page_size;
+    if (page_no >= fc->remote_pages) {
+        std::cerr << "Far memory address out of range: " << addr << std::endl;
+        return NULL;
+    }
+    fc->stats.accesses++;
+    int32_t frame = fc->page_table[page_no];
+    bool advance = false;
+    if (frame == FARMEM_NO_FRAME) {
+        fc->stats.misses++;
+        int64_t f = farmem_fetch(fc, page_no, false);
+        if (f < 0) {
+            return NULL;
+        }
+        frame = (int32_t)f;
+        advance = true;
+    } else {
+        fc->stats.hits++;
+        if (fc->frames[frame].prefetched) {
+            // 预取页被命中，视作一次缺页继续步长检测，并推进预取窗口
+            fc->stats.prefetch_hits++;
+            fc->frames[frame].prefetched = false;
+            advance = true;
+        }
+    }
+    fc->frames[frame].referenced = true;
+    if (advance) {
+        farmem_detect_stride(fc, page_no);
+        if (farmem_prefetch_ahead(fc, page_no) < 0) {
+            return NULL;
+        }
+        // 预取可能在极小的缓存中淘汰了当前页，此时重新读入
+        while ((frame = fc->page_table[page_no]) == FARMEM_NO_FRAME) {
+            int64_t f = farmem_fetch(fc, page_no, false);
+            if (f < 0) {
+                return NULL;
+            }
+        }
+    }
+    farmem_frame &f = fc->frames[frame];
+    while (f.loading || (write && f.writing)) {
+        if (farmem_poll(fc, true) < 0) {
+            return NULL;
+        }
+    }
+    f.referenced = true;
+    if (write) {
+        f.dirty = true;
+    }
+    return farmem_frame_addr(fc, frame) + addr % fc->page_size;
+}
+
+// 拷贝读取，可以跨页
+int farmem_read(farmem_cache *fc, uint64_t addr, void *buf, size_t len) {
+    char *out = (char *)buf;
+    while (len > 0) {
+        size_t n = std::min(len, (size_t)(fc->page_size - addr % fc->page_size));
+        char *p = farmem_access(fc, addr, false);
+        if (!p) {
+            return -1;
+        }
+        memcpy(out, p, n);
+        out += n;
+        addr += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 拷贝写入，可以跨页
+int farmem_write(farmem_cache *fc, uint64_t addr, const void *buf, size_t len) {
+    const char *in = (const char *)buf;
+    while (len > 0) {
+        size_t n = std::min(len, (size_t)(fc->page_size - addr % fc->page_size));
+        char *p = farmem_access(fc, addr, true);
+        if (!p) {
+            return -1;
+        }
+        memcpy(p, in, n);
+        in += n;
+        addr += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// 把所有脏页写回远端并等待完成
+int farmem_flush(farmem_cache *fc) {
+    for (uint32_t i = 0; i < fc->nframes; i++) {
+        farmem_frame &f = fc->frames[i];
+        if (f.page_no >= 0 && f.dirty && !f.writing && !f.queued) {
+            f.queued = true;
+            fc->wb_batch.push_back(i);
+            if (fc->wb_batch.size() >= FARMEM_WB_BATCH && farmem_flush_batch(fc) < 0) {
+                return -1;
+            }
+        }
+    }
+    if (farmem_flush_batch(fc) < 0) {
+        return -1;
+    }
+    while (fc->inflight > 0) {
+        if (farmem_poll(fc, true) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+#endif  // _RDMA_FARMEM_HPP
@@ -0,0 +1,275 @@
+#ifndef _RDMA_MPSC_HPP
+#define _RDMA_MPSC_HPP
+
+#include "rdma_common.hpp"
+#include <atomic>
+#include <thread>
+#include <deque>
+#include <immintrin.h>
+
+/*
+    多生产者提交队列 + QP属主线程
+
+    ibv_post_send 在同一个QP上并发调用需要外部加锁。这里让一个属主线程独占QP和CQ，
+    应用线程把操作描述符放进有界无锁MPSC环形队列，然后在各自操作的完成标志上等待：
+      - 入队：Vyukov 有界队列，每个槽位带序号，生产者用一次CAS抢占位置，不需要锁；
+      - 属主线程一次取出最多 MPSC_MAX_BATCH 个描述符，串成一条WR链post，只有最后一个带 IBV_SEND_SIGNALED；
+      - RC按序完成，批次最后一个WR完成时，它之前的所有操作也都已完成，逐个置位完成标志。
+    描述符由调用方持有，在 mpsc_wait 返回前不能释放或复用。
+*/
+
+#define MPSC_RING_SIZE 1024         // 必须是2的幂
+#define MPSC_MAX_BATCH 32           // 每条WR链的最大长度
+#define MPSC_SQ_DEPTH 256           // 属主线程允许的在途WR数
+
+struct mpsc_op {
+    enum ibv_wr_opcode opcode;
+    void *local_addr;
+    uint32_t length;
+    uint32_t lkey;
+    uint64_t remote_addr;
+    uint32_t rkey;
+    std::atomic<int> done;          // 0: 未完成，1: 已完成
+    enum ibv_wc_status status;
+};
+
+struct mpsc_slot {
+    std::atomic<uint64_t> seq;
+    mpsc_op *op;
+};
+
+struct mpsc_engine {
+    rdma_context *ctx;
+    mpsc_slot slots[MPSC_RING_SIZE];
+    alignas(64) std::atomic<uint64_t> tail;     // 生产者共享
+    alignas(64) uint64_t head;                  // 只有属主线程访问
+    std::atomic<bool> stop;
+    std::thread owner;
+    std::deque<mpsc_op *> posted;               // 已post但未完成的操作，按post顺序
+    int outstanding;
+    bool has_fence_target;                      // 最近post过的RDMA写的远端地址，部分post失败时补发零长度写用
+    uint64_t fence_addr;
+    uint32_t fence_rkey;
+
+    // 统计信息
+    uint64_t batches;
+    uint64_t ops;
+};
+
+
+// 等待时先忙等，再让出CPU，生产者线程数多于核数时避免饿死属主线程
+inline void mpsc_relax(uint32_t *spins) {
+    if (++*spins < 64) {
+        _mm_pause();
+    } else {
+        std::this_thread::yield();
+    }
+}
+
+// 准备一个操作描述符
+void mpsc_op_init(mpsc_op *op, enum ibv_wr_opcode opcode, void *local_addr, uint32_t length, uint32_t lkey,
+                  uint64_t remote_addr, uint32_t rkey) {
+    op->opcode = opcode;
+    op->local_addr = local_addr;
+    op->length = length;
+    op->lkey = lkey;
+    op->remote_addr = remote_addr;
+    op->rkey = rkey;
+    op->status = IBV_WC_SUCCESS;
+    op->done.store(0, std::memory_order_relaxed);
+}
+
+// 入队，队列满时等待属主线程取走
+void mpsc_submit(mpsc_engine *eng, mpsc_op *op) {
+    uint32_t spins = 0;
+    uint64_t pos = eng->tail.load(std::memory_order_relaxed);
+    while (true) {
+        mpsc_slot &slot = eng->slots[pos & (MPSC_RING_SIZE - 1)];
+        uint64_t seq = slot.seq.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0) {
+            if (eng->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.op = op;
+                slot.seq.store(pos + 1, std::memory_order_release);
+                return;
+            }
+        } else if (diff < 0) {
+            mpsc_relax(&spins);                          // 队列已满
+            pos = eng->tail.load(std::memory_order_relaxed);
+        } else {
+            pos = eng->tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// 等待操作完成，返回0表示成功
+int mpsc_wait(mpsc_op *op) {
+    uint32_t spins = 0;
+    while (!op->done.load(std::memory_order_acquire)) {
+        mpsc_relax(&spins);
+    }
+    return op->status == IBV_WC_SUCCESS ? 0 : -1;
+}
+
+// 属主线程：从队列取出一个描述符，队列为空返回NULL
+mpsc_op *mpsc_dequeue(mpsc_engine *eng) {
+    mpsc_slot &slot = eng->slots[eng->head & (MPSC_RING_SIZE - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != eng->head + 1) {
+        return NULL;
+    }
+    mpsc_op *op = slot.op;
+    slot.seq.store(eng->head + MPSC_RING_SIZE, std::memory_order_release);
+    eng->head++;
+    return op;
+}
+
+// 完成到last为止的所有操作。RC按序执行，出错的WR即使不带信号也会产生完成，
+// 所以last之前的操作都已成功，只有last取完成的状态
+void mpsc_complete_until(mpsc_engine *eng, mpsc_op *last, enum ibv_wc_status status) {
+    while (!eng->posted.empty()) {
+        mpsc_op *op = eng->posted.front();
+        eng->posted.pop_front();
+        eng->outstanding--;
+        op->status = op == last ? status : IBV_WC_SUCCESS;
+        op->done.store(1, std::memory_order_release);
+        if (op == last) {
+            break;
+        }
+    }
+}
+
+// 部分post失败后补一个带信号的零长度写，完成时带出到last为止的操作。
+// 目标取最近post的RDMA写：它排在补发的写之前，远端没有写权限时它自己会先出错
+int mpsc_post_fence(mpsc_engine *eng, mpsc_op *last) {
+    if (!eng->has_fence_target) {
+        return -1;
+    }
+    struct ibv_send_wr fence, *bad_wr;
+    memset(&fence, 0, sizeof(fence));
+    fence.wr_id = (uintptr_t)last;
+    fence.opcode = IBV_WR_RDMA_WRITE;
+    fence.num_sge = 0;
+    fence.send_flags = IBV_SEND_SIGNALED;
+    fence.wr.rdma.remote_addr = eng->fence_addr;
+    fence.wr.rdma.rkey = eng->fence_rkey;
+    return ibv_post_send(eng->ctx->qp, &fence, &bad_wr) ? -1 : 0;
+}
+
+// 把最多count个描述符串成一条WR链post出去，返回post的个数
+int mpsc_post_batch(mpsc_engine *eng, int count) {
+    struct ibv_sge sges[MPSC_MAX_BATCH];
+    struct ibv_send_wr wrs[MPSC_MAX_BATCH];
+    mpsc_op *ops[MPSC_MAX_BATCH];
+    int n = 0;
+    while (n < count) {
+        mpsc_op *op = mpsc_dequeue(eng);
+        if (!op) {
+            break;
+        }
+        sges[n].addr = (uintptr_t)op->local_addr;
+        sges[n].length = op->length;
+        sges[n].lkey = op->lkey;
+        memset(&wrs[n], 0, sizeof(wrs[n]));
+        wrs[n].wr_id = (uintptr_t)op;
+        wrs[n].opcode = op->opcode;
+        wrs[n].sg_list = &sges[n];
+        wrs[n].num_sge = 1;
+        wrs[n].wr.rdma.remote_addr = op->remote_addr;
+        wrs[n].wr.rdma.rkey = op->rkey;
+        if (n > 0) {
+            wrs[n - 1].next = &wrs[n];
+        }
+        ops[n++] = op;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    wrs[n - 1].send_flags = IBV_SEND_SIGNALED;
+    struct ibv_send_wr *bad_wr = NULL;
+    int ret = ibv_post_send(eng->ctx->qp, &wrs[0], &bad_wr);
+    // bad_wr之前的WR已经post但都不带信号，补一个带信号的零长度写，其完成带出这些操作；
+    // 从bad_wr开始的操作直接以失败完成
+    int accepted = ret ? (int)(bad_wr - wrs) : n;
+    for (int i = 0; i < accepted; i++) {
+        eng->posted.push_back(ops[i]);
+        if (ops[i]->opcode == IBV_WR_RDMA_WRITE) {
+            eng->has_fence_target = true;
+            eng->fence_addr = ops[i]->remote_addr;
+            eng->fence_rkey = ops[i]->rkey;
+        }
+    }
+    eng->outstanding += accepted;
+    if (ret) {
+        std::cerr << "Failed to post batch" << std::endl;
+        if (accepted > 0 && mpsc_post_fence(eng, ops[accepted - 1]) < 0) {
+            // 没有完成会带出这些操作（它们在posted的末尾）：直接以失败完成，结果不确定
+            std::cerr << "Failed to post completion fence" << std::endl;
+            for (int i = accepted - 1; i >= 0; i--) {
+                eng->posted.pop_back();
+                eng->outstanding--;
+                ops[i]->status = IBV_WC_GENERAL_ERR;
+                ops[i]->done.store(1, std::memory_order_release);
+            }
+        }
+        for (int i = accepted; i < n; i++) {
+            ops[i]->status = IBV_WC_GENERAL_ERR;
+            ops[i]->done.store(1, std::memory_order_release);
+        }
+    }
+    eng->batches++;
+    eng->ops += accepted;
+    return n;
+}
+
+void mpsc_owner_loop(mpsc_engine *eng) {
+    struct ibv_wc wc[32];
+    while (true) {
+        int n = ibv_poll_cq(eng->ctx->cq, 32, wc);
+        if (n < 0) {
+            std::cerr << "Failed to poll CQ" << std::endl;
+            n = 0;
+        }
+        for (int i = 0; i < n; i++) {
+            if (wc[i].status != IBV_WC_SUCCESS) {
+                std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc[i].status) << std::endl;
+            }
+            mpsc_complete_until(eng, (mpsc_op *)wc[i].wr_id, wc[i].status);
+        }
+        int room = std::min(MPSC_MAX_BATCH, MPSC_SQ_DEPTH - eng->outstanding);
+        int posted = room > 0 ? mpsc_post_batch(eng, room) : 0;
+        if (posted == 0 && n == 0 && eng->outstanding == 0 && eng->stop.load(std::memory_order_acquire)) {
+            break;
+        }
+    }
+}
+
+// 启动属主线程，之后只能通过mpsc_submit使用ctx->qp，QP至少要有MPSC_SQ_DEPTH个发送WR
+void mpsc_engine_start(mpsc_engine *eng, rdma_context *_ctx) {
+    eng->ctx = _ctx;
+    for (uint64_t i = 0; i < MPSC_RING_SIZE; i++) {
+        eng->slots[i].seq.store(i, std::memory_order_relaxed);
+        eng->slots[i].op = NULL;
+    }
+    eng->tail.store(0, std::memory_order_relaxed);
+    eng->head = 0;
+    eng->stop.store(false, std::memory_order_relaxed);
+    eng->posted.clear();
+    eng->outstanding = 0;
+    eng->has_fence_target = false;
+    eng->fence_addr = 0;
+    eng->fence_rkey = 0;
+    eng->batches = 0;
+    eng->ops = 0;
+    eng->owner = std::thread(mpsc_owner_loop, eng);
+}
+
+// 处理完队列中剩余的操作后停止属主线程
+void mpsc_engine_stop(mpsc_engine *eng) {
+    eng->stop.store(true, std::memory_order_release);
+    if (eng->owner.joinable()) {
+        eng->owner.join();
+    }
+}
+
+
+#endif  // _RDMA_MPSC_HPP
@@ -0,0 +1,313 @@
+#ifndef _RDMA_MSG_HPP
+#define _RDMA_MSG_HPP
+
+#include "rdma_common.hpp"
+
+/*
+    大消息分片与零拷贝重组 (SEND/RECV)
+
+    发送方把任意长度的消息切成 frag_size 大小的分片，每个分片是一个带两个SGE的SEND：
+      SGE[0] 指向消息头 msg_frag_hdr（消息id、偏移、总长度）
+      SGE[1] 指向用户数据中对应的区间（已注册时零拷贝，否则先拷贝到发送中转区）
+    接收方post的接收同样带两个SGE：SGE[0]接收消息头，SGE[1]直接指向用户目的缓冲区中该分片的位置，
+    RC保证分片按序到达，因此分片i一定落在 dst + i * frag_size，不需要再拷贝。
+
+    由接收方驱动流控：接收方每post一个分片接收，就把累计的已post数通过RDMA_WRITE（内联）
+    写到发送方的 grant 计数器里，发送方只在 sent < grant 时发送，所以永远不会触发RNR。
+    grant不经过接收队列，所以两端可以在同一个QP上轮流收发消息而不会互相占用接收。
+    msg_send / msg_recv 都是同步调用，同一时刻一个通道只进行一个方向：msg_send 期间出现接收完成视为错误。
+    第一个分片到达前接收方不知道消息长度，只post一个接收，拿到总长度后再按 MSG_WINDOW 流水。
+*/
+
+#define MSG_WINDOW 32                   // 每个方向最多在途的分片数
+#define MSG_DEFAULT_FRAG (64 * 1024)    // 默认分片大小，RC会再按path MTU切包
+#define MSG_HDR_SLOT 32                 // 每个消息头槽位的大小
+
+struct msg_frag_hdr {
+    uint64_t msg_id;
+    uint64_t offset;        // 分片在消息中的偏移
+    uint64_t total_len;     // 消息总长度
+};
+
+// ctx->buffer 的布局
+struct msg_layout {
+    size_t grant_off;       // 对端写入的grant计数器
+    size_t send_hdr_off;    // 发送消息头环
+    size_t recv_hdr_off;    // 接收消息头环
+    size_t send_bounce_off; // 发送中转区
+    size_t recv_bounce_off; // 接收中转区
+    size_t total;
+};
+
+struct msg_channel {
+    rdma_context *ctx;
+    msg_layout layout;
+    uint32_t frag_size;
+    uint64_t remote_grant_addr;     // 对端grant计数器的地址
+    uint32_t remote_grant_rkey;
+
+    // 发送方向
+    uint64_t next_msg_id;
+    uint64_t frags_sent;            // 累计发送的分片数
+    int send_inflight;              // 未完成的发送（含grant写）
+
+    // 接收方向
+    uint64_t frags_posted;          // 累计post的分片接收数
+    uint64_t grant_published;       // 已写给对端的grant值
+
+    // 统计
+    uint64_t zero_copy_frags;
+    uint64_t copied_frags;
+};
+
+#define MSG_WR_GRANT 0xffffffffffffffffull
+
+
+size_t msg_buffer_size(uint32_t frag_size) {
+    return 64 + 2 * MSG_WINDOW * MSG_HDR_SLOT + 2 * (size_t)MSG_WINDOW * frag_size;
+}
+
+volatile uint64_t *msg_grant_counter(msg_channel *ch) {
+    return (volatile uint64_t *)(ch->ctx->buffer + ch->layout.grant_off);
+}
+
+// 初始化通道，ctx->buffer至少要有msg_buffer_size(frag_size)字节，QP至少支持2个SGE和8字节内联
+void msg_channel_init(msg_channel *ch, rdma_context *_ctx, uint32_t frag_size) {
+    memset(ch, 0, sizeof(*ch));
+    ch->ctx = _ctx;
+    ch->frag_size = frag_size;
+    ch->layout.grant_off = 0;
+    ch->layout.send_hdr_off = 64;
+    ch->layout.recv_hdr_off = ch->layout.send_hdr_off + MSG_WINDOW * MSG_HDR_SLOT;
+    ch->layout.send_bounce_off = ch->layout.recv_hdr_off + MSG_WINDOW * MSG_HDR_SLOT;
+    ch->layout.recv_bounce_off = ch->layout.send_bounce_off + (size_t)MSG_WINDOW * frag_size;
+    ch->layout.total = ch->layout.recv_bounce_off + (size_t)MSG_WINDOW * frag_size;
+    *msg_grant_counter(ch) = 0;
+}
+
+// 连接建立后调用：remote_info->addr/rkey 指向对端的ctx->buffer
+void msg_channel_set_remote(msg_channel *ch, const qp_info *remote_info) {
+    ch->remote_grant_addr = remote_info->addr;   // grant计数器位于缓冲区开头
+    ch->remote_grant_rkey = remote_info->rkey;
+}
+
+// 处理一个发送方向的完成
+int msg_handle_send_wc(msg_channel *ch, const struct ibv_wc *wc) {
+    if (wc->status != IBV_WC_SUCCESS) {
+        std::cerr << "Send completion failed with status " << ibv_wc_status_str(wc->status) << std::endl;
+        return -1;
+    }
+    ch->send_inflight--;
+    return 0;
+}
+
+// 把累计的已post接收数写到对端的grant计数器
+int msg_publish_grant(msg_channel *ch) {
+    if (ch->grant_published == ch->frags_posted) {
+        return 0;
+    }
+    uint64_t value = ch->frags_posted;
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)&value;
+    sge.length = sizeof(value);
+    sge.lkey = 0;                       // 内联发送不检查lkey
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = MSG_WR_GRANT;
+    wr.opcode = IBV_WR_RDMA_WRITE;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED | IBV_SEND_INLINE;
+    wr.wr.rdma.remote_addr = ch->remote_grant_addr;
+    wr.wr.rdma.rkey = ch->remote_grant_rkey;
+    if (ibv_post_send(ch->ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post grant write" << std::endl;
+        return -1;
+    }
+    ch->send_inflight++;
+    ch->grant_published = value;
+    return 0;
+}
+
+// post第frag_idx个分片的接收，dst_mr为NULL时落到接收中转区
+int msg_post_frag_recv(msg_channel *ch, uint64_t frag_idx, char *dst, size_t dst_len, struct ibv_mr *dst_mr) {
+    uint32_t ring = ch->frags_posted % MSG_WINDOW;
+    struct ibv_sge sge[2];
+    sge[0].addr = (uintptr_t)(ch->ctx->buffer + ch->layout.recv_hdr_off + ring * MSG_HDR_SLOT);
+    sge[0].length = sizeof(msg_frag_hdr);
+    sge[0].lkey = ch->ctx->mr->lkey;
+
+    size_t offset = frag_idx * ch->frag_size;
+    size_t len = dst_len > offset ? std::min((size_t)ch->frag_size, dst_len - offset) : 0;
+    if (dst_mr) {
+        sge[1].addr = (uintptr_t)(dst + offset);
+        sge[1].lkey = dst_mr->lkey;
+    } else {
+        sge[1].addr = (uintptr_t)(ch->ctx->buffer + ch->layout.recv_bounce_off + (size_t)ring * ch->frag_size);
+        sge[1].lkey = ch->ctx->mr->lkey;
+        len = ch->frag_size;
+    }
+    sge[1].length = len;
+
+    struct ibv_recv_wr recv_wr, *bad_recv_wr;
+    memset(&recv_wr, 0, sizeof(recv_wr));
+    recv_wr.wr_id = frag_idx;
+    recv_wr.sg_list = sge;
+    recv_wr.num_sge = len > 0 ? 2 : 1;
+    if (ibv_post_recv(ch->ctx->qp, &recv_wr, &bad_recv_wr)) {
+        std::cerr << "Failed to post fragment receive" << std::endl;
+        return -1;
+    }
+    ch->frags_posted++;
+    return 0;
+}
+
+// 发送一条任意长度的消息。data_mr非NULL时直接从用户缓冲区发送，否则经发送中转区拷贝
+int msg_send(msg_channel *ch, const char *data, size_t len, struct ibv_mr *data_mr) {
+    uint64_t msg_id = ch->next_msg_id++;
+    uint64_t nfrags = len == 0 ? 1 : (len + ch->frag_size - 1) / ch->frag_size;
+    uint64_t next = 0;
+    struct ibv_wc wc[16];
+
+    while (next < nfrags || ch->send_inflight > 0) {
+        // 在信用和发送队列允许的范围内，把分片串成一条WR链一次post
+        uint64_t granted = *msg_grant_counter(ch);
+        struct ibv_send_wr wrs[MSG_WINDOW];
+        struct ibv_sge sges[MSG_WINDOW][2];
+        int batch = 0;
+        while (next < nfrags && ch->frags_sent < granted && ch->send_inflight + batch < MSG_WINDOW) {
+            uint32_t ring = ch->frags_sent % MSG_WINDOW;
+            uint64_t offset = next * ch->frag_size;
+            uint32_t frag_len = (uint32_t)std::min((uint64_t)ch->frag_size, len - offset);
+
+            msg_frag_hdr *hdr = (msg_frag_hdr *)(ch->ctx->buffer + ch->layout.send_hdr_off + ring * MSG_HDR_SLOT);
+            hdr->msg_id = msg_id;
+            hdr->offset = offset;
+            hdr->total_len = len;
+            sges[batch][0].addr = (uintptr_t)hdr;
+            sges[batch][0].length = sizeof(msg_frag_hdr);
+            sges[batch][0].lkey = ch->ctx->mr->lkey;
+            if (data_mr) {
+                sges[batch][1].addr = (uintptr_t)(data + offset);
+                sges[batch][1].lkey = data_mr->lkey;
+                ch->zero_copy_frags++;
+            } else {
+                char *bounce = ch->ctx->buffer + ch->layout.send_bounce_off + (size_t)ring * ch->frag_size;
+                memcpy(bounce, data + offset, frag_len);
+                sges[batch][1].addr = (uintptr_t)bounce;
+                sges[batch][1].lkey = ch->ctx->mr->lkey;
+                ch->copied_frags++;
+            }
+            sges[batch][1].length = frag_len;
+
+            memset(&wrs[batch], 0, sizeof(wrs[batch]));
+            wrs[batch].wr_id = ch->frags_sent;
+            wrs[batch].opcode = IBV_WR_SEND;
+            wrs[batch].sg_list = sges[batch];
+            wrs[batch].num_sge = frag_len > 0 ? 2 : 1;
+            wrs[batch].send_flags = IBV_SEND_SIGNALED;
+            if (batch > 0) {
+                wrs[batch - 1].next = &wrs[batch];
+            }
+            batch++;
+            next++;
+            ch->frags_sent++;
+        }
+        if (batch > 0) {
+            struct ibv_send_wr *bad_wr;
+            if (ibv_post_send(ch->ctx->qp, &wrs[0], &bad_wr)) {
+                std::cerr << "Failed to post fragment send" << std::endl;
+                return -1;
+            }
+            ch->send_inflight += batch;
+        }
+
+        int n = ibv_poll_cq(ch->ctx->cq, 16, wc);
+        if (n < 0) {
+            std::cerr << "Failed to poll CQ" << std::endl;
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (wc[i].status == IBV_WC_SUCCESS && (wc[i].opcode & IBV_WC_RECV)) {
+                std::cerr << "Unexpected receive completion while sending" << std::endl;
+                return -1;
+            }
+            if (msg_handle_send_wc(ch, &wc[i]) < 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// 接收一条消息到dst（容量cap），dst_mr非NULL时分片直接落到dst中。返回消息长度，出错返回-1
+int64_t msg_recv(msg_channel *ch, char *dst, size_t cap, struct ibv_mr *dst_mr) {
+    // 先只post第一个分片的接收，从消息头中得到总长度
+    if (msg_post_frag_recv(ch, 0, dst, cap, dst_mr) < 0 || msg_publish_grant(ch) < 0) {
+        return -1;
+    }
+
+    uint64_t nfrags = 1, posted = 1, received = 0;
+    uint64_t total_len = 0, msg_id = 0;
+    struct ibv_wc wc[16];
+    while (received < nfrags || ch->send_inflight > 0) {
+        int n = ibv_poll_cq(ch->ctx->cq, 16, wc);
+        if (n < 0) {
+            std::cerr << "Failed to poll CQ" << std::endl;
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            // 出错时opcode无效，只能先检查状态
+            if (wc[i].status != IBV_WC_SUCCESS) {
+                std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc[i].status) << std::endl;
+                return -1;
+            }
+            if (!(wc[i].opcode & IBV_WC_RECV)) {
+                ch->send_inflight--;
+                continue;
+            }
+            uint64_t frag_idx = wc[i].wr_id;
+            uint32_t ring = (ch->frags_posted - posted + frag_idx) % MSG_WINDOW;
+            msg_frag_hdr *hdr = (msg_frag_hdr *)(ch->ctx->buffer + ch->layout.recv_hdr_off + ring * MSG_HDR_SLOT);
+            if (frag_idx == 0) {
+                total_len = hdr->total_len;
+                msg_id = hdr->msg_id;
+                if (total_len > cap) {
+                    std::cerr << "Message of " << total_len << " bytes exceeds buffer of " << cap << " bytes" << std::endl;
+                    return -1;
+                }
+                nfrags = total_len == 0 ? 1 : (total_len + ch->frag_size - 1) / ch->frag_size;
+            }
+            if (hdr->msg_id != msg_id || hdr->offset != frag_idx * ch->frag_size) {
+                std::cerr << "Fragment out of order: msg " << hdr->msg_id << ", offset " << hdr->offset << std::endl;
+                return -1;
+            }
+            if (!dst_mr) {
+                uint32_t frag_len = wc[i].byte_len - sizeof(msg_frag_hdr);
+                memcpy(dst + hdr->offset, ch->ctx->buffer + ch->layout.recv_bounce_off + (size_t)ring * ch->frag_size, frag_len);
+                ch->copied_frags++;
+            } else {
+                ch->zero_copy_frags++;
+            }
+            received++;
+        }
+        // 保持 MSG_WINDOW 个分片接收在途，攒够四分之一窗口或全部post完再更新grant
+        while (posted < nfrags && posted - received < MSG_WINDOW) {
+            if (msg_post_frag_recv(ch, posted, dst, cap, dst_mr) < 0) {
+                return -1;
+            }
+            posted++;
+        }
+        uint64_t pending = ch->frags_posted - ch->grant_published;
+        if (pending > 0 && (pending >= MSG_WINDOW / 4 || posted == nfrags) && ch->send_inflight < MSG_WINDOW) {
+            if (msg_publish_grant(ch) < 0) {
+                return -1;
+            }
+        }
+    }
+    return (int64_t)total_len;
+}
+
+
+#endif  // _RDMA_MSG_HPP
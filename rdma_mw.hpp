@@ -0,0 +1,179 @@
+#ifndef _RDMA_MW_HPP
+#define _RDMA_MW_HPP
+
+#include "rdma_common.hpp"
+#include <unordered_map>
+
+/*
+    基于内存窗口 (type 2 memory window) 的细粒度远程访问授权
+
+    大块内存只注册一次，MR只带 IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_MW_BIND，MR自身的rkey不能被远程使用。
+    每次授权从窗口池中取一个预先 ibv_alloc_mw 的窗口，在QP上post一个 IBV_WR_BIND_MW，
+    把它绑定到 [offset, offset + length) 子区间并指定远程访问权限，得到一个新的rkey交给对端。
+    撤销有两种方式：
+      - 本端post IBV_WR_LOCAL_INV；
+      - 对端用完后发送 IBV_WR_SEND_WITH_INV，网卡在接收时使rkey失效，
+        接收完成带 IBV_WC_WITH_INV 标志，invalidated_rkey 即被撤销的rkey，本端只需回收窗口。
+    每次重新绑定时rkey的低8位递增，旧rkey在撤销后立即失效。
+    type 2 窗口只能被绑定它的QP的对端使用。
+*/
+
+#define MW_POOL_SIZE 64
+#define MW_WR_BIND 0x4d570000ull        // wr_id：绑定
+#define MW_WR_INV  0x4d580000ull        // wr_id：本地撤销
+
+// rdma_server_mw / rdma_client_mw 之间的控制消息
+enum mw_req_type {
+    MW_REQ_GRANT = 1,
+    MW_REQ_RELEASE = 2,
+    MW_REQ_DONE = 3,
+};
+
+struct mw_request {
+    uint32_t type;
+    uint32_t access;
+    uint64_t offset;
+    uint64_t length;
+};
+
+struct mw_reply {
+    uint64_t addr;
+    uint32_t rkey;
+    uint32_t status;        // 0表示成功
+};
+
+struct mw_slot {
+    struct ibv_mw *mw;
+    uint32_t rkey;              // 最近一次绑定使用的rkey
+};
+
+struct mw_grant {
+    uint64_t addr;              // 授权区间的起始地址（对端RDMA操作使用的地址）
+    uint64_t length;
+    uint32_t rkey;
+};
+
+struct mw_pool {
+    rdma_context *ctx;
+    std::vector<mw_slot> slots;
+    std::vector<int> free_slots;
+    std::unordered_map<uint32_t, int> active;   // rkey -> 槽位
+
+    // 统计信息
+    uint64_t grants;
+    uint64_t local_revokes;
+    uint64_t remote_revokes;
+};
+
+
+// 分配count个type 2窗口，ctx->mr 必须带 IBV_ACCESS_MW_BIND
+int mw_pool_init(mw_pool *pool, rdma_context *_ctx, int count) {
+    pool->ctx = _ctx;
+    pool->slots.clear();
+    pool->free_slots.clear();
+    pool->active.clear();
+    pool->grants = 0;
+    pool->local_revokes = 0;
+    pool->remote_revokes = 0;
+    for (int i = 0; i < count; i++) {
+        mw_slot slot;
+        slot.mw = ibv_alloc_mw(_ctx->pd, IBV_MW_TYPE_2);
+        if (!slot.mw) {
+            std::cerr << "Failed to allocate memory window" << std::endl;
+            return -1;
+        }
+        slot.rkey = slot.mw->rkey;
+        pool->slots.push_back(slot);
+        pool->free_slots.push_back(i);
+    }
+    return 0;
+}
+
+void mw_pool_free(mw_pool *pool) {
+    for (mw_slot &slot : pool->slots) {
+        ibv_dealloc_mw(slot.mw);
+    }
+    pool->slots.clear();
+    pool->free_slots.clear();
+    pool->active.clear();
+}
+
+// post绑定请求，把一个空闲窗口绑到缓冲区的[offset, offset + length)，完成后grant即可交给对端
+int mw_grant_post(mw_pool *pool, uint64_t offset, uint64_t length, int access, mw_grant *grant) {
+    if (offset + length > pool->ctx->mr->length || length == 0) {
+        std::cerr << "Grant out of range: offset " << offset << ", length " << length << std::endl;
+        return -1;
+    }
+    if (pool->free_slots.empty()) {
+        std::cerr << "No free memory window" << std::endl;
+        return -1;
+    }
+    int idx = pool->free_slots.back();
+    mw_slot &slot = pool->slots[idx];
+    uint32_t rkey = ibv_inc_rkey(slot.rkey);
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = MW_WR_BIND | (uint64_t)idx;
+    wr.opcode = IBV_WR_BIND_MW;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.bind_mw.mw = slot.mw;
+    wr.bind_mw.rkey = rkey;
+    wr.bind_mw.bind_info.mr = pool->ctx->mr;
+    wr.bind_mw.bind_info.addr = (uintptr_t)pool->ctx->buffer + offset;
+    wr.bind_mw.bind_info.length = length;
+    wr.bind_mw.bind_info.mw_access_flags = access;
+    if (ibv_post_send(pool->ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post bind request" << std::endl;
+        return -1;
+    }
+    pool->free_slots.pop_back();
+    slot.rkey = rkey;
+    pool->active[rkey] = idx;
+    pool->grants++;
+    grant->addr = wr.bind_mw.bind_info.addr;
+    grant->length = length;
+    grant->rkey = rkey;
+    return 0;
+}
+
+// post本地撤销请求，窗口立即回到空闲列表（同一QP上后续的绑定按序执行，不会早于撤销）
+int mw_revoke_post(mw_pool *pool, uint32_t rkey) {
+    auto it = pool->active.find(rkey);
+    if (it == pool->active.end()) {
+        std::cerr << "Unknown rkey " << rkey << std::endl;
+        return -1;
+    }
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = MW_WR_INV | (uint64_t)it->second;
+    wr.opcode = IBV_WR_LOCAL_INV;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.invalidate_rkey = rkey;
+    if (ibv_post_send(pool->ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post local invalidate" << std::endl;
+        return -1;
+    }
+    pool->free_slots.push_back(it->second);
+    pool->active.erase(it);
+    pool->local_revokes++;
+    return 0;
+}
+
+// 处理一个接收完成：对端用SEND_WITH_INV撤销了授权时回收窗口
+void mw_handle_recv(mw_pool *pool, const struct ibv_wc *wc) {
+    if (!(wc->wc_flags & IBV_WC_WITH_INV)) {
+        return;
+    }
+    auto it = pool->active.find(wc->invalidated_rkey);
+    if (it == pool->active.end()) {
+        std::cerr << "Peer invalidated unknown rkey " << wc->invalidated_rkey << std::endl;
+        return;
+    }
+    pool->free_slots.push_back(it->second);
+    pool->active.erase(it);
+    pool->remote_revokes++;
+}
+
+
+#endif  // _RDMA_MW_HPP
@@ -0,0 +1,441 @@
+#ifndef _RDMA_PROTO_HPP
+#define _RDMA_PROTO_HPP
+
+#include "rdma_common.hpp"
+#include <deque>
+
+/*
+    按消息大小自动选择传输协议
+
+      - 内联 (PROTO_INLINE)：SEND_WITH_IMM + IBV_SEND_INLINE，数据由CPU直接写进WQE，网卡不需要再DMA读，
+        上限为QP实际的 max_inline_data；
+      - eager (PROTO_EAGER)：SEND_WITH_IMM 到对端预先post的接收缓冲区，接收方拷贝到目的地址，
+        上限为接收缓冲区大小 PROTO_EAGER_MAX；
+      - rendezvous (PROTO_RNDV)：发送方只发一个带地址和rkey的RTS，接收方直接RDMA_READ到目的地址，
+        读完后回复FIN，发送方收到FIN后缓冲区才可复用。大消息省去了拷贝。
+    立即数据的低8位为消息类型。两个阈值 inline_max / rndv_min 在启动时由 proto_calibrate 测出：
+    对各候选长度分别用两种协议做乒乓，取较快的一方。
+
+    proto_send / proto_recv 的缓冲区都必须位于 ctx->mr 中，MR需要 IBV_ACCESS_REMOTE_READ。
+    proto_send 返回时缓冲区即可复用。
+    两端可能同时发送rendezvous消息，各自等待对方的FIN。所以等FIN期间如果收到了RTS，就先把数据读进
+    临时注册的缓冲区并回复FIN，之后 proto_recv 再从临时缓冲区拷贝到目的地址。
+*/
+
+#define PROTO_RECV_SLOTS 16
+#define PROTO_EAGER_MAX (64 * 1024)         // 每个接收缓冲区的大小
+#define PROTO_INLINE_REQ 256                // 创建QP时请求的内联上限，实际值以查询结果为准
+#define PROTO_CTRL_SIZE 64
+#define PROTO_SQ_DEPTH 32                   // 在途发送数上限，rendezvous的RDMA_READ也计入
+#define PROTO_CQ_DEPTH (PROTO_SQ_DEPTH + PROTO_RECV_SLOTS + 1)
+#define PROTO_RECV_AREA_SIZE (PROTO_RECV_SLOTS * PROTO_EAGER_MAX)
+#define PROTO_CTRL_AREA_SIZE (PROTO_SQ_DEPTH * PROTO_CTRL_SIZE)
+#define PROTO_RESERVED_SIZE (PROTO_RECV_AREA_SIZE + PROTO_CTRL_AREA_SIZE)   // ctx->buffer 开头保留给通道
+
+#define PROTO_WR_SEND 0x100000000ull
+#define PROTO_WR_READ 0x200000000ull
+
+enum proto_kind {
+    PROTO_AUTO = -1,
+    PROTO_INLINE = 0,
+    PROTO_EAGER = 1,
+    PROTO_RNDV = 2,
+};
+
+enum proto_imm {
+    PROTO_IMM_INLINE = 0,
+    PROTO_IMM_EAGER = 1,
+    PROTO_IMM_RTS = 2,
+    PROTO_IMM_FIN = 3,
+};
+
+struct proto_rts {
+    uint64_t addr;
+    uint32_t rkey;
+    uint32_t length;
+    uint64_t id;
+};
+
+struct proto_msg {
+    uint32_t slot;
+    uint32_t len;
+    uint32_t type;
+    char *data;                     // 等FIN期间提前读完的rendezvous消息，否则为NULL
+    struct ibv_mr *mr;
+};
+
+struct proto_channel {
+    rdma_context *ctx;
+    char *recv_area;
+    char *ctrl_area;                // RTS/FIN 的发送缓冲区（内联发送，只用于组装）
+    uint32_t inline_cap;            // QP实际支持的内联上限
+    uint32_t inline_max;            // 不超过此长度用内联
+    uint32_t rndv_min;              // 不小于此长度用rendezvous
+    uint64_t sends_posted;          // 包括RDMA_READ
+    uint64_t sends_done;            // RC按序完成，已完成的发送数
+    uint64_t next_rts_id;
+    uint64_t fins_received;         // 对端确认读完的RTS数
+    bool read_done;
+    std::deque<proto_msg> ready;    // 已到达、尚未取走的消息
+};
+
+
+const char *proto_name(int proto) {
+    static const char *names[] = {"inline", "eager", "rndv"};
+    return proto >= PROTO_INLINE && proto <= PROTO_RNDV ? names[proto] : "auto";
+}
+
+// 创建QP：请求 PROTO_INLINE_REQ 字节的内联上限
+int proto_create_qp(rdma_context *_ctx) {
+    return rdma_create_rc_qp(_ctx, PROTO_SQ_DEPTH, PROTO_RECV_SLOTS, 1, PROTO_INLINE_REQ);
+}
+
+int proto_post_recv(proto_channel *ch, uint32_t slot) {
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)(ch->recv_area + (size_t)slot * PROTO_EAGER_MAX);
+    sge.length = PROTO_EAGER_MAX;
+    sge.lkey = ch->ctx->mr->lkey;
+
+    struct ibv_recv_wr recv_wr, *bad_recv_wr;
+    memset(&recv_wr, 0, sizeof(recv_wr));
+    recv_wr.wr_id = slot;
+    recv_wr.sg_list = &sge;
+    recv_wr.num_sge = 1;
+    if (ibv_post_recv(ch->ctx->qp, &recv_wr, &bad_recv_wr)) {
+        std::cerr << "Failed to post receive request" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 在QP连接之后调用：查询内联上限并post所有接收，ctx->buffer 的前 PROTO_RESERVED_SIZE 字节归通道使用
+int proto_channel_init(proto_channel *ch, rdma_context *_ctx) {
+    ch->ctx = _ctx;
+    ch->recv_area = _ctx->buffer;
+    ch->ctrl_area = _ctx->buffer + PROTO_RECV_AREA_SIZE;
+    struct ibv_qp_attr attr;
+    struct ibv_qp_init_attr init_attr;
+    if (ibv_query_qp(_ctx->qp, &attr, IBV_QP_CAP, &init_attr)) {
+        std::cerr << "Failed to query QP" << std::endl;
+        return -1;
+    }
+    ch->inline_cap = init_attr.cap.max_inline_data;
+    ch->inline_max = ch->inline_cap;
+    ch->rndv_min = PROTO_EAGER_MAX + 1;
+    ch->sends_posted = 0;
+    ch->sends_done = 0;
+    ch->next_rts_id = 0;
+    ch->fins_received = 0;
+    ch->read_done = false;
+    ch->ready.clear();
+    for (uint32_t i = 0; i < PROTO_RECV_SLOTS; i++) {
+        if (proto_post_recv(ch, i) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 两端都post好接收之后才开始发送
+int proto_handshake(int sock_fd) {
+    char local_ready = 1, remote_ready;
+    if (sock_send_all(sock_fd, &local_ready, 1) < 0 || sock_recv_all(sock_fd, &remote_ready, 1) < 0) {
+        std::cerr << "Failed to synchronize with peer" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 轮询一次CQ
+int proto_progress(proto_channel *ch) {
+    struct ibv_wc wc[16];
+    int n = ibv_poll_cq(ch->ctx->cq, 16, wc);
+    if (n < 0) {
+        std::cerr << "Failed to poll CQ" << std::endl;
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (wc[i].status != IBV_WC_SUCCESS) {
+            std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc[i].status) << std::endl;
+            return -1;
+        }
+        if (wc[i].wr_id & (PROTO_WR_SEND | PROTO_WR_READ)) {
+            ch->sends_done++;
+            if (wc[i].wr_id & PROTO_WR_READ) {
+                ch->read_done = true;
+            }
+        } else {
+            uint32_t slot = (uint32_t)wc[i].wr_id;
+            uint32_t type = ntohl(wc[i].imm_data) & 0xff;
+            if (type == PROTO_IMM_FIN) {
+                ch->fins_received++;
+                if (proto_post_recv(ch, slot) < 0) {
+                    return -1;
+                }
+            } else {
+                ch->ready.push_back({slot, wc[i].byte_len, type, NULL, NULL});
+            }
+        }
+    }
+    return n;
+}
+
+// 发送队列满时先回收完成
+int proto_wait_sq(proto_channel *ch) {
+    while (ch->sends_posted - ch->sends_done >= PROTO_SQ_DEPTH) {
+        if (proto_progress(ch) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int proto_post_send(proto_channel *ch, const char *buf, uint32_t len, uint32_t type, bool inline_data) {
+    if (proto_wait_sq(ch) < 0) {
+        return -1;
+    }
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)buf;
+    sge.length = len;
+    sge.lkey = ch->ctx->mr->lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = PROTO_WR_SEND | ch->sends_posted;
+    wr.opcode = IBV_WR_SEND_WITH_IMM;
+    wr.sg_list = &sge;
+    wr.num_sge = len > 0 ? 1 : 0;
+    wr.send_flags = IBV_SEND_SIGNALED | (inline_data ? IBV_SEND_INLINE : 0);
+    wr.imm_data = htonl(type);
+    if (ibv_post_send(ch->ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post send request" << std::endl;
+        return -1;
+    }
+    ch->sends_posted++;
+    return 0;
+}
+
+// 等待到目前为止post的所有发送完成
+int proto_wait_sends(proto_channel *ch) {
+    while (ch->sends_done < ch->sends_posted) {
+        if (proto_progress(ch) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// RDMA_READ 对端RTS描述的数据到dst（lkey所属的MR中），读完后回复FIN
+int proto_read_rts(proto_channel *ch, const proto_rts *rts, char *dst, uint32_t lkey, uint32_t len) {
+    if (proto_wait_sq(ch) < 0) {
+        return -1;
+    }
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)dst;
+    sge.length = len;
+    sge.lkey = lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = PROTO_WR_READ | ch->sends_posted;
+    wr.opcode = IBV_WR_RDMA_READ;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = rts->addr;
+    wr.wr.rdma.rkey = rts->rkey;
+    ch->read_done = false;
+    if (ibv_post_send(ch->ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post RDMA read" << std::endl;
+        return -1;
+    }
+    ch->sends_posted++;
+    while (!ch->read_done) {
+        if (proto_progress(ch) < 0) {
+            return -1;
+        }
+    }
+    return proto_post_send(ch, NULL, 0, PROTO_IMM_FIN, true);
+}
+
+// 把已到达、尚未处理的RTS读进临时缓冲区并回复FIN，避免两端同时等待对方的FIN
+int proto_serve_rts(proto_channel *ch) {
+    for (size_t i = 0; i < ch->ready.size(); i++) {
+        if (ch->ready[i].type != PROTO_IMM_RTS || ch->ready[i].data) {
+            continue;
+        }
+        proto_rts rts;
+        memcpy(&rts, ch->recv_area + (size_t)ch->ready[i].slot * PROTO_EAGER_MAX, sizeof(rts));
+        if (proto_post_recv(ch, ch->ready[i].slot) < 0) {
+            return -1;
+        }
+        size_t alloc = std::max(rts.length, 1u);
+        char *data = (char *)malloc(alloc);
+        struct ibv_mr *mr = data ? ibv_reg_mr(ch->ctx->pd, data, alloc, IBV_ACCESS_LOCAL_WRITE) : NULL;
+        if (!mr) {
+            std::cerr << "Failed to allocate rendezvous bounce buffer" << std::endl;
+            free(data);
+            return -1;
+        }
+        ch->ready[i].data = data;
+        ch->ready[i].mr = mr;
+        ch->ready[i].len = rts.length;
+        if (proto_read_rts(ch, &rts, data, mr->lkey, rts.length) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// 按指定协议发送（PROTO_AUTO 时按阈值选择），返回时buf可复用
+int proto_send_as(proto_channel *ch, const char *buf, uint32_t len, int proto) {
+    if (proto == PROTO_AUTO) {
+        proto = len <= ch->inline_max ? PROTO_INLINE : (len < ch->rndv_min ? PROTO_EAGER : PROTO_RNDV);
+    }
+    if (proto == PROTO_INLINE && len > ch->inline_cap) {
+        proto = PROTO_EAGER;
+    }
+    if (proto == PROTO_EAGER && len > PROTO_EAGER_MAX) {
+        proto = PROTO_RNDV;
+    }
+
+    if (proto == PROTO_INLINE) {
+        return proto_post_send(ch, buf, len, PROTO_IMM_INLINE, true);     // 内联数据在post时已被拷贝
+    }
+    if (proto == PROTO_EAGER) {
+        return proto_post_send(ch, buf, len, PROTO_IMM_EAGER, false) < 0 ? -1 : proto_wait_sends(ch);
+    }
+
+    proto_rts rts;
+    rts.addr = (uintptr_t)buf;
+    rts.rkey = ch->ctx->mr->rkey;
+    rts.length = len;
+    rts.id = ch->next_rts_id++;
+    char *slot = ch->ctrl_area + (ch->sends_posted % PROTO_SQ_DEPTH) * PROTO_CTRL_SIZE;
+    memcpy(slot, &rts, sizeof(rts));
+    if (proto_post_send(ch, slot, sizeof(rts), PROTO_IMM_RTS, sizeof(rts) <= ch->inline_cap) < 0) {
+        return -1;
+    }
+    // 对端读完并回复FIN后buf才可复用
+    while (ch->fins_received <= rts.id) {
+        if (proto_progress(ch) < 0 || proto_serve_rts(ch) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int proto_send(proto_channel *ch, const char *buf, uint32_t len) {
+    return proto_send_as(ch, buf, len, PROTO_AUTO);
+}
+
+// 接收一条消息到dst，返回长度，proto返回对端使用的协议
+int proto_recv(proto_channel *ch, char *dst, uint32_t max_len, int *proto) {
+    while (ch->ready.empty()) {
+        if (proto_progress(ch) < 0) {
+            return -1;
+        }
+    }
+    proto_msg msg = ch->ready.front();
+    ch->ready.pop_front();
+    const char *src = ch->recv_area + (size_t)msg.slot * PROTO_EAGER_MAX;
+    uint32_t len;
+    if (msg.data) {
+        len = std::min(msg.len, max_len);
+        memcpy(dst, msg.data, len);
+        ibv_dereg_mr(msg.mr);
+        free(msg.data);
+        if (proto) {
+            *proto = PROTO_RNDV;
+        }
+        return (int)len;
+    }
+    if (msg.type != PROTO_IMM_RTS) {
+        len = std::min(msg.len, max_len);
+        memcpy(dst, src, len);
+        if (proto) {
+            *proto = msg.type == PROTO_IMM_INLINE ? PROTO_INLINE : PROTO_EAGER;
+        }
+        return proto_post_recv(ch, msg.slot) < 0 ? -1 : (int)len;
+    }
+
+    proto_rts rts;
+    memcpy(&rts, src, sizeof(rts));
+    if (proto_post_recv(ch, msg.slot) < 0) {
+        return -1;
+    }
+    len = std::min(rts.length, max_len);
+    if (proto_read_rts(ch, &rts, dst, ch->ctx->mr->lkey, len) < 0) {
+        return -1;
+    }
+    if (proto) {
+        *proto = PROTO_RNDV;
+    }
+    return (int)len;
+}
+
+
+/* 校准 */
+// 用指定协议做rounds次乒乓（对端用 proto_serve_echo 以相同协议回显），返回单程时间（微秒）
+double proto_pingpong(proto_channel *ch, char *sbuf, char *rbuf, uint32_t len, int proto, int rounds) {
+    uint64_t start = now_ns();
+    for (int i = 0; i < rounds; i++) {
+        if (proto_send_as(ch, sbuf, len, proto) < 0 || proto_recv(ch, rbuf, len, NULL) < 0) {
+            return -1;
+        }
+    }
+    return (now_ns() - start) / 1000.0 / rounds / 2;
+}
+
+// 对各候选长度比较相邻两种协议，得到 inline_max 和 rndv_min
+int proto_calibrate(proto_channel *ch, char *sbuf, char *rbuf, int rounds) {
+    ch->inline_max = 0;
+    for (uint32_t len = 16; len <= ch->inline_cap; len *= 2) {
+        double t_inline = proto_pingpong(ch, sbuf, rbuf, len, PROTO_INLINE, rounds);
+        double t_eager = proto_pingpong(ch, sbuf, rbuf, len, PROTO_EAGER, rounds);
+        if (t_inline < 0 || t_eager < 0) {
+            return -1;
+        }
+        if (t_inline > t_eager) {
+            break;
+        }
+        ch->inline_max = len;
+    }
+    if (ch->inline_max * 2 > ch->inline_cap && ch->inline_max > 0) {
+        ch->inline_max = ch->inline_cap;    // 直到上限内联都更快
+    }
+
+    ch->rndv_min = PROTO_EAGER_MAX + 1;
+    for (uint32_t len = 1024; len <= PROTO_EAGER_MAX; len *= 2) {
+        double t_eager = proto_pingpong(ch, sbuf, rbuf, len, PROTO_EAGER, rounds);
+        double t_rndv = proto_pingpong(ch, sbuf, rbuf, len, PROTO_RNDV, rounds);
+        if (t_eager < 0 || t_rndv < 0) {
+            return -1;
+        }
+        if (t_rndv < t_eager) {
+            ch->rndv_min = len;
+            break;
+        }
+    }
+    return 0;
+}
+
+// 被动端：以收到的协议回显每条消息，收到长度为0的消息时返回
+int proto_serve_echo(proto_channel *ch, char *buf, uint32_t max_len) {
+    while (true) {
+        int proto;
+        int len = proto_recv(ch, buf, max_len, &proto);
+        if (len < 0) {
+            return -1;
+        }
+        if (len == 0) {
+            return 0;
+        }
+        if (proto_send_as(ch, buf, (uint32_t)len, proto) < 0) {
+            return -1;
+        }
+    }
+}
+
+
+#endif  // _RDMA_PROTO_HPP
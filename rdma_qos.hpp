@@ -0,0 +1,305 @@
+#ifndef _RDMA_QOS_HPP
+#define _RDMA_QOS_HPP
+
+#include "rdma_common.hpp"
+#include <deque>
+
+/*
+    按流量类别调度的QoS
+
+    每个流量类别对应一个服务等级：QP在RTR时带上类别的 sl / traffic_class，交换机和网卡据此分队列。
+    一条连接上每个类别一个QP（一个流，qos_flow），多条连接的流由同一个调度器管理：
+      - 大操作在提交时切成 QOS_SEGMENT_SIZE 的段，调度的粒度是段而不是整个操作；
+      - 差额轮询(DRR)：每轮给积压的流增加 weight × QOS_QUANTUM 字节的额度，额度够队首段时才post，
+        积压的流之间按权重分享带宽，队列为空时额度清零；
+      - 每个类别限制在网卡中排队的字节数(max_inflight)，其余留在软件队列中，
+        大流量不会在发送队列里堆积几十MB把后来的控制消息挡在后面；
+      - 限速：优先用 ibv_modify_qp_rate_limit 交给网卡，设备不支持时退回到软件令牌桶。
+    只有 RDMA_WRITE / RDMA_READ 可以分段，其余操作作为一个段发送。
+*/
+
+#define QOS_SEGMENT_SIZE (256 * 1024)
+#define QOS_QUANTUM (64 * 1024)         // 权重为1时每轮增加的额度
+#define QOS_SQ_DEPTH 256                // 每个流在途WR数上限
+#define QOS_MAX_CLASSES 8
+
+struct qos_class_config {
+    const char *name;
+    uint8_t sl;
+    uint8_t traffic_class;          // RoCE：DSCP << 2
+    uint32_t weight;
+    uint32_t rate_mbps;             // 0 表示不限速
+    uint64_t max_inflight;          // 在网卡中排队的字节数上限，0 表示不限制
+};
+
+// 每个类别在连接两端的链路参数，通过TCP发给对端使对端QP的SL一致（ACK也走相同的SL）
+struct qos_wire_class {
+    uint8_t sl;
+    uint8_t traffic_class;
+};
+
+struct qos_segment {
+    enum ibv_wr_opcode opcode;
+    char *local;
+    uint32_t lkey;
+    uint32_t length;
+    uint64_t remote_addr;
+    uint32_t rkey;
+    uint64_t user_id;
+    uint64_t enqueue_ns;
+    bool last;                      // 操作的最后一段，完成时上报
+};
+
+struct qos_completion {
+    uint64_t user_id;
+    int cls;
+    uint64_t enqueue_ns;
+    uint64_t complete_ns;
+    enum ibv_wc_status status;
+};
+
+struct qos_flow {
+    int cls;
+    struct ibv_qp *qp;
+    std::deque<qos_segment> queue;      // 等待调度
+    std::deque<qos_segment> posted;     // 已post，按post顺序
+    int64_t deficit;
+    uint64_t inflight_bytes;
+    bool hw_rate_limit;
+    double tokens;                      // 软件令牌桶（字节）
+    uint64_t last_refill_ns;
+
+    // 统计信息
+    uint64_t bytes_done;
+    uint64_t ops_done;
+};
+
+struct qos_sched {
+    rdma_context *ctx;
+    qos_class_config classes[QOS_MAX_CLASSES];
+    int nclasses;
+    std::vector<qos_flow> flows;
+    size_t rr;                          // DRR当前轮到的流
+};
+
+
+void qos_init(qos_sched *s, rdma_context *_ctx, const qos_class_config *classes, int nclasses) {
+    s->ctx = _ctx;
+    s->nclasses = std::min(nclasses, QOS_MAX_CLASSES);
+    for (int i = 0; i < s->nclasses; i++) {
+        s->classes[i] = classes[i];
+    }
+    s->flows.clear();
+    s->rr = 0;
+}
+
+// 令牌桶容量：限速下1ms的字节数，至少一个段
+double qos_bucket_size(const qos_class_config *cfg) {
+    return std::max((double)cfg->rate_mbps * 1e6 / 8 / 1000, (double)QOS_SEGMENT_SIZE);
+}
+
+// 设置流的限速（0表示不限速），优先交给网卡，不支持时由qos_dispatch用令牌桶限速
+void qos_set_rate(qos_sched *s, int flow_idx, uint32_t rate_mbps) {
+    qos_flow &flow = s->flows[flow_idx];
+    qos_class_config *cfg = &s->classes[flow.cls];
+    struct ibv_qp_rate_limit_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.rate_limit = rate_mbps * 1000;     // kbps，0表示取消限速
+    bool hw = ibv_modify_qp_rate_limit(flow.qp, &attr) == 0;
+    cfg->rate_mbps = rate_mbps;
+    flow.hw_rate_limit = hw;
+    flow.tokens = qos_bucket_size(cfg);
+    flow.last_refill_ns = now_ns();
+    if (rate_mbps) {
+        std::cout << "Class " << cfg->name << ": " << rate_mbps << " Mbps limit in "
+                  << (hw ? "hardware" : "software (token bucket)") << std::endl;
+    }
+}
+
+// 在ctx上为类别cls新建一个QP，按类别的SL连接对端，并设置限速，返回流的下标
+int qos_add_flow(qos_sched *s, int cls, int sock_fd, qp_info *remote_info, int access) {
+    const qos_class_config *cfg = &s->classes[cls];
+    if (rdma_create_rc_qp(s->ctx, QOS_SQ_DEPTH, 1) < 0) {
+        return -1;
+    }
+    qos_flow flow;
+    flow.cls = cls;
+    flow.qp = s->ctx->qp;
+    flow.deficit = 0;
+    flow.inflight_bytes = 0;
+    flow.hw_rate_limit = false;
+    flow.tokens = qos_bucket_size(cfg);
+    flow.last_refill_ns = now_ns();
+    flow.bytes_done = 0;
+    flow.ops_done = 0;
+    s->flows.push_back(flow);       // 先记下，出错时由qos_free释放
+    if (rdma_connect_qp(s->ctx, sock_fd, remote_info, access, 7, cfg->sl, cfg->traffic_class) < 0) {
+        return -1;
+    }
+
+    if (cfg->rate_mbps) {
+        qos_set_rate(s, (int)s->flows.size() - 1, cfg->rate_mbps);
+    }
+    return (int)s->flows.size() - 1;
+}
+
+// 销毁除ctx->qp以外的所有流的QP，ctx->qp由rdma_free_resources释放
+void qos_free(qos_sched *s) {
+    for (qos_flow &flow : s->flows) {
+        if (flow.qp && flow.qp != s->ctx->qp) {
+            ibv_destroy_qp(flow.qp);
+        }
+    }
+    s->flows.clear();
+}
+
+// 提交一个操作到流，大的RDMA读写切成多段
+void qos_submit(qos_sched *s, int flow_idx, enum ibv_wr_opcode opcode, char *local, uint32_t lkey, uint32_t length,
+                uint64_t remote_addr, uint32_t rkey, uint64_t user_id) {
+    qos_flow &flow = s->flows[flow_idx];
+    bool splittable = opcode == IBV_WR_RDMA_WRITE || opcode == IBV_WR_RDMA_READ;
+    uint32_t seg_size = splittable ? QOS_SEGMENT_SIZE : std::max<uint32_t>(length, 1);
+    uint64_t now = now_ns();
+    uint32_t off = 0;
+    do {
+        qos_segment seg;
+        seg.opcode = opcode;
+        seg.local = local + off;
+        seg.lkey = lkey;
+        seg.length = std::min(seg_size, length - off);
+        seg.remote_addr = remote_addr + off;
+        seg.rkey = rkey;
+        seg.user_id = user_id;
+        seg.enqueue_ns = now;
+        off += seg.length;
+        seg.last = off >= length;
+        flow.queue.push_back(seg);
+    } while (off < length);
+}
+
+// 流的队首段当前能否post（网卡排队上限、发送队列深度和软件令牌桶）
+bool qos_flow_ready(qos_sched *s, qos_flow &flow, uint64_t now) {
+    const qos_class_config *cfg = &s->classes[flow.cls];
+    const qos_segment &seg = flow.queue.front();
+    if (flow.posted.size() >= QOS_SQ_DEPTH) {
+        return false;
+    }
+    if (cfg->max_inflight && flow.inflight_bytes > 0 && flow.inflight_bytes + seg.length > cfg->max_inflight) {
+        return false;
+    }
+    if (cfg->rate_mbps && !flow.hw_rate_limit) {
+        double rate = (double)cfg->rate_mbps * 1e6 / 8 / 1e9;   // 字节/纳秒
+        flow.tokens = std::min(flow.tokens + rate * (now - flow.last_refill_ns), qos_bucket_size(cfg));
+        flow.last_refill_ns = now;
+        if (flow.tokens < std::min((double)seg.length, qos_bucket_size(cfg))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int qos_post_segment(qos_sched *s, int flow_idx) {
+    qos_flow &flow = s->flows[flow_idx];
+    qos_segment &seg = flow.queue.front();
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)seg.local;
+    sge.length = seg.length;
+    sge.lkey = seg.lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = (uint64_t)flow_idx;
+    wr.opcode = seg.opcode;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = seg.remote_addr;
+    wr.wr.rdma.rkey = seg.rkey;
+    if (ibv_post_send(flow.qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post segment" << std::endl;
+        return -1;
+    }
+    if (s->classes[flow.cls].rate_mbps && !flow.hw_rate_limit) {
+        flow.tokens -= seg.length;
+    }
+    flow.deficit -= seg.length;
+    flow.inflight_bytes += seg.length;
+    flow.posted.push_back(seg);
+    flow.queue.pop_front();
+    return 0;
+}
+
+// 一轮DRR：依次给每个积压的流增加额度并post额度允许的段，返回post的段数
+int qos_dispatch(qos_sched *s) {
+    int posted = 0;
+    size_t n = s->flows.size();
+    uint64_t now = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        size_t idx = (s->rr + i) % n;
+        qos_flow &flow = s->flows[idx];
+        if (flow.queue.empty()) {
+            flow.deficit = 0;
+            continue;
+        }
+        if (!qos_flow_ready(s, flow, now)) {
+            continue;       // 被排队上限或限速挡住，本轮不增加额度
+        }
+        if (flow.deficit < (int64_t)flow.queue.front().length) {
+            flow.deficit += (int64_t)s->classes[flow.cls].weight * QOS_QUANTUM;
+        }
+        while (!flow.queue.empty() && flow.deficit >= (int64_t)flow.queue.front().length &&
+               qos_flow_ready(s, flow, now)) {
+            if (qos_post_segment(s, (int)idx) < 0) {
+                return -1;
+            }
+            posted++;
+        }
+    }
+    s->rr = n ? (s->rr + 1) % n : 0;
+    return posted;
+}
+
+// 轮询CQ，把完成的操作（最后一段完成时）写入done，返回个数，出错返回-1
+int qos_progress(qos_sched *s, qos_completion *done, int max_done) {
+    struct ibv_wc wc[32];
+    int n = ibv_poll_cq(s->ctx->cq, std::min(32, max_done), wc);
+    if (n < 0) {
+        std::cerr << "Failed to poll CQ" << std::endl;
+        return -1;
+    }
+    int count = 0;
+    uint64_t now = now_ns();
+    for (int i = 0; i < n; i++) {
+        qos_flow &flow = s->flows[wc[i].wr_id];
+        qos_segment seg = flow.posted.front();     // RC按post顺序完成
+        flow.posted.pop_front();
+        flow.inflight_bytes -= seg.length;
+        flow.bytes_done += seg.length;
+        if (wc[i].status != IBV_WC_SUCCESS) {
+            std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc[i].status) << std::endl;
+        }
+        if (seg.last) {     // QP出错后剩余的段都以错误完成，最后一段带出错误状态
+            flow.ops_done++;
+            done[count].user_id = seg.user_id;
+            done[count].cls = flow.cls;
+            done[count].enqueue_ns = seg.enqueue_ns;
+            done[count].complete_ns = now;
+            done[count].status = wc[i].status;
+            count++;
+        }
+    }
+    return count;
+}
+
+// 流是否还有未完成的段
+bool qos_idle(const qos_sched *s) {
+    for (const qos_flow &flow : s->flows) {
+        if (!flow.queue.empty() || !flow.posted.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+#endif  // _RDMA_QOS_HPP
@@ -0,0 +1,341 @@
+#ifndef _RDMA_RECOVERY_HPP
+#define _RDMA_RECOVERY_HPP
+
+#include "rdma_common.hpp"
+#include <deque>
+#include <random>
+#include <fcntl.h>
+
+/*
+    QP错误恢复：不销毁PD/MR/CQ/QP，只把同一个QP重新走一遍状态机
+
+    检测：CQ上出现非成功的完成，或异步事件（IBV_EVENT_QP_FATAL 等）报告QP出错。
+    恢复（发起方，一般是客户端）：
+      1. QP切到ERROR，轮询CQ直到所有在途WR都以错误或冲刷完成，逐个记账；
+      2. RESET -> INIT，随机生成新的PSN，通过原有TCP连接发送 RECOV_REQ；
+      3. 对端同样 ERROR -> RESET -> INIT，用双方的新PSN切到RTR/RTS后回复 RECOV_REPLY；
+      4. 发起方切到RTR/RTS，发送 RECOV_READY，然后按原顺序重放幂等操作（RDMA_WRITE/READ），
+         非幂等操作（SEND、原子操作等）以失败返回给调用方。
+    QPN、MR和rkey都不变，对端持有的地址和rkey在恢复后依然有效。
+*/
+
+#define RECOV_MAX_ATTEMPTS 3        // 单个操作最多重放的次数，防止确定性错误无限重试
+
+enum recov_msg_type {
+    RECOV_REQ = 1,
+    RECOV_REPLY = 2,
+    RECOV_READY = 3,
+};
+
+struct recov_msg {
+    uint32_t type;
+    uint32_t psn;
+};
+
+struct recov_op {
+    uint64_t id;
+    enum ibv_wr_opcode opcode;
+    char *local;
+    uint32_t length;
+    uint64_t remote_addr;
+    uint32_t rkey;
+    int attempts;
+    bool fault;                 // 注入的故障操作，出错后直接丢弃
+};
+
+struct recov_channel {
+    rdma_context *ctx;
+    int sock_fd;                // 建链用的TCP连接，恢复时复用
+    int access;
+    qp_info remote;
+    std::deque<recov_op> inflight;      // 已post的操作，RC保证按此顺序完成
+    std::vector<recov_op> failed;       // 无法重放而放弃的操作
+    uint64_t detect_ns;                 // 本次故障被检测到的时间
+
+    // 统计信息
+    uint64_t completed;
+    uint64_t recoveries;
+    uint64_t replayed;
+    uint64_t flushed;
+    std::vector<double> failover_us;    // 检测到故障到QP重新可用并重放完成的时间
+};
+
+
+uint32_t recov_random_psn() {
+    static std::mt19937 rng(std::random_device{}());
+    return rng() & 0xffffff;            // PSN只有24位
+}
+
+bool recov_idempotent(enum ibv_wr_opcode opcode) {
+    return opcode == IBV_WR_RDMA_WRITE || opcode == IBV_WR_RDMA_READ;
+}
+
+// 把异步事件fd设为非阻塞，以便在轮询循环中检查
+int recov_async_nonblock(rdma_context *_ctx) {
+    int flags = fcntl(_ctx->ctx->async_fd, F_GETFL);
+    if (flags < 0 || fcntl(_ctx->ctx->async_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        std::cerr << "Failed to make async event fd non-blocking" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 读取所有待处理的异步事件，出现QP级致命错误时返回true
+bool recov_check_async(rdma_context *_ctx) {
+    bool qp_error = false;
+    struct ibv_async_event event;
+    while (ibv_get_async_event(_ctx->ctx, &event) == 0) {
+        std::cerr << "Async event: " << ibv_event_type_str(event.event_type) << std::endl;
+        if (event.event_type == IBV_EVENT_QP_FATAL || event.event_type == IBV_EVENT_QP_REQ_ERR ||
+            event.event_type == IBV_EVENT_QP_ACCESS_ERR) {
+            qp_error = true;
+        }
+        ibv_ack_async_event(&event);
+    }
+    return qp_error;
+}
+
+// ERROR -> RESET -> INIT，调用前在途WR必须已经全部冲刷完
+int recov_reinit_qp(rdma_context *_ctx, int access) {
+    if (modify_qp_to_reset(_ctx->qp) < 0) {
+        return -1;
+    }
+    return modify_qp_to_init(_ctx->qp, access);
+}
+
+// INIT -> RTR -> RTS，使用双方交换后的新PSN
+int recov_activate_qp(rdma_context *_ctx, const qp_info *remote, uint32_t local_psn, uint32_t remote_psn) {
+    if (modify_qp_to_rtr(_ctx->qp, remote, remote_psn) < 0) {
+        return -1;
+    }
+    return modify_qp_to_rts(_ctx->qp, local_psn);
+}
+
+int recov_send_msg(int sock_fd, uint32_t type, uint32_t psn) {
+    recov_msg msg;
+    msg.type = htonl(type);
+    msg.psn = htonl(psn);
+    return sock_send_all(sock_fd, &msg, sizeof(msg));
+}
+
+int recov_recv_msg(int sock_fd, uint32_t expected_type, uint32_t *psn) {
+    recov_msg msg;
+    if (sock_recv_all(sock_fd, &msg, sizeof(msg)) < 0) {
+        return -1;
+    }
+    if (ntohl(msg.type) != expected_type) {
+        std::cerr << "Unexpected recovery message type " << ntohl(msg.type) << std::endl;
+        return -1;
+    }
+    if (psn) {
+        *psn = ntohl(msg.psn);
+    }
+    return 0;
+}
+
+
+/* 对端（被动方） */
+// 收到 RECOV_REQ 后调用：QP重新走状态机并回复自己的新PSN；被动方不post WR，没有需要排空的完成
+int recov_serve_request(rdma_context *_ctx, int sock_fd, int access, const qp_info *remote, uint32_t remote_psn) {
+    if (modify_qp_to_error(_ctx->qp) < 0) {
+        return -1;
+    }
+    recov_check_async(_ctx);
+    uint32_t psn = recov_random_psn();
+    if (recov_reinit_qp(_ctx, access) < 0 || recov_activate_qp(_ctx, remote, psn, remote_psn) < 0) {
+        return -1;
+    }
+    if (recov_send_msg(sock_fd, RECOV_REPLY, psn) < 0 || recov_recv_msg(sock_fd, RECOV_READY, NULL) < 0) {
+        std::cerr << "Recovery handshake failed" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+
+/* 发起方 */
+void recov_channel_init(recov_channel *ch, rdma_context *_ctx, int sock_fd, int access, const qp_info *remote) {
+    ch->ctx = _ctx;
+    ch->sock_fd = sock_fd;
+    ch->access = access;
+    ch->remote = *remote;
+    ch->inflight.clear();
+    ch->failed.clear();
+    ch->detect_ns = 0;
+    ch->completed = 0;
+    ch->recoveries = 0;
+    ch->replayed = 0;
+    ch->flushed = 0;
+    ch->failover_us.clear();
+}
+
+int recov_post_wr(recov_channel *ch, const recov_op *op) {
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)op->local;
+    sge.length = op->length;
+    sge.lkey = ch->ctx->mr->lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = op->id;
+    wr.opcode = op->opcode;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = op->remote_addr;
+    wr.wr.rdma.rkey = op->rkey;
+    if (ibv_post_send(ch->ctx->qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post send request" << std::endl;
+        return -1;
+    }
+    ch->inflight.push_back(*op);
+    return 0;
+}
+
+// 一个在途操作以错误完成：幂等且未超过重试次数的放入重放列表，其余记为失败
+void recov_account(recov_channel *ch, const recov_op &op, std::vector<recov_op> *replay) {
+    if (op.fault) {
+        return;
+    }
+    if (recov_idempotent(op.opcode) && op.attempts < RECOV_MAX_ATTEMPTS) {
+        replay->push_back(op);
+    } else {
+        ch->failed.push_back(op);
+    }
+}
+
+// 一个在途操作的完成：按post顺序与inflight队首对应
+void recov_complete_one(recov_channel *ch, const struct ibv_wc *wc, std::vector<recov_op> *replay) {
+    recov_op op = ch->inflight.front();
+    ch->inflight.pop_front();
+    if (wc->status == IBV_WC_SUCCESS) {
+        ch->completed++;
+        return;
+    }
+    if (wc->status == IBV_WC_WR_FLUSH_ERR) {
+        ch->flushed++;
+    }
+    recov_account(ch, op, replay);
+}
+
+// 完整的恢复流程，wcs为检测到错误时已经从CQ中取出、尚未处理的count个完成
+int recov_recover(recov_channel *ch, const struct ibv_wc *wcs, int count) {
+    if (ch->detect_ns == 0) {
+        ch->detect_ns = now_ns();
+    }
+    std::vector<recov_op> replay;
+    for (int i = 0; i < count && !ch->inflight.empty(); i++) {
+        recov_complete_one(ch, &wcs[i], &replay);
+    }
+
+    // 1. 切到ERROR，其余在途WR以IBV_WC_WR_FLUSH_ERR完成
+    if (modify_qp_to_error(ch->ctx->qp) < 0) {
+        return -1;
+    }
+    struct ibv_wc wc;
+    while (!ch->inflight.empty()) {
+        int n = ibv_poll_cq(ch->ctx->cq, 1, &wc);
+        if (n < 0) {
+            std::cerr << "Failed to poll CQ" << std::endl;
+            return -1;
+        }
+        if (n == 1) {
+            recov_complete_one(ch, &wc, &replay);
+        }
+    }
+    recov_check_async(ch->ctx);
+
+    // 2~4. 复用TCP连接交换新PSN，双方重新连接同一对QP
+    uint32_t psn = recov_random_psn(), remote_psn;
+    if (recov_reinit_qp(ch->ctx, ch->access) < 0) {
+        return -1;
+    }
+    if (recov_send_msg(ch->sock_fd, RECOV_REQ, psn) < 0 || recov_recv_msg(ch->sock_fd, RECOV_REPLY, &remote_psn) < 0) {
+        std::cerr << "Recovery handshake failed" << std::endl;
+        return -1;
+    }
+    if (recov_activate_qp(ch->ctx, &ch->remote, psn, remote_psn) < 0) {
+        return -1;
+    }
+    if (recov_send_msg(ch->sock_fd, RECOV_READY, psn) < 0) {
+        std::cerr << "Recovery handshake failed" << std::endl;
+        return -1;
+    }
+
+    // 按原顺序重放
+    for (recov_op &op : replay) {
+        op.attempts++;
+        if (recov_post_wr(ch, &op) < 0) {
+            return -1;
+        }
+        ch->replayed++;
+    }
+    ch->recoveries++;
+    ch->failover_us.push_back((now_ns() - ch->detect_ns) / 1000.0);
+    ch->detect_ns = 0;
+    return 0;
+}
+
+// 提交一个操作，op->id 由调用方分配
+int recov_post(recov_channel *ch, enum ibv_wr_opcode opcode, uint64_t id, char *local, uint32_t length,
+               uint64_t remote_addr, uint32_t rkey) {
+    recov_op op;
+    op.id = id;
+    op.opcode = opcode;
+    op.local = local;
+    op.length = length;
+    op.remote_addr = remote_addr;
+    op.rkey = rkey;
+    op.attempts = 0;
+    op.fault = false;
+    return recov_post_wr(ch, &op);
+}
+
+// 轮询CQ和异步事件，发现错误时就地恢复，返回本次成功完成的操作数
+int recov_progress(recov_channel *ch) {
+    struct ibv_wc wc[16];
+    int n = ibv_poll_cq(ch->ctx->cq, 16, wc);
+    if (n < 0) {
+        std::cerr << "Failed to poll CQ" << std::endl;
+        return -1;
+    }
+    int done = 0;
+    for (int i = 0; i < n; i++) {
+        if (wc[i].status != IBV_WC_SUCCESS) {
+            std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc[i].status)
+                      << ", recovering QP" << std::endl;
+            return recov_recover(ch, &wc[i], n - i) < 0 ? -1 : done;
+        }
+        ch->inflight.pop_front();
+        ch->completed++;
+        done++;
+    }
+    if (n == 0 && recov_check_async(ch->ctx)) {
+        if (recov_recover(ch, NULL, 0) < 0) {
+            return -1;
+        }
+    }
+    return done;
+}
+
+// 故障注入：bad_rkey为true时post一个rkey错误的RDMA_WRITE（对端返回远程访问错误），
+// 否则直接把本端QP切到ERROR（模拟本地故障）
+int recov_inject_fault(recov_channel *ch, bool bad_rkey, char *local, uint32_t length) {
+    if (!bad_rkey) {
+        ch->detect_ns = now_ns();
+        return modify_qp_to_error(ch->ctx->qp);
+    }
+    recov_op op;
+    op.id = UINT64_MAX;
+    op.opcode = IBV_WR_RDMA_WRITE;
+    op.local = local;
+    op.length = length;
+    op.remote_addr = ch->remote.addr;
+    op.rkey = ch->remote.rkey ^ 0x5a5a5a5a;
+    op.attempts = 0;
+    op.fault = true;
+    return recov_post_wr(ch, &op);
+}
+
+
+#endif  // _RDMA_RECOVERY_HPP
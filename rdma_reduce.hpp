@@ -0,0 +1,342 @@
+#ifndef _RDMA_REDUCE_HPP
+#define _RDMA_REDUCE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <immintrin.h>
+
+/*
+    集合通信用的归约内核：dst[i] = op(dst[i], src[i])，原地归约
+    数据类型支持 float32 / float16 / int64，运算支持 sum / max。
+    每种组合有标量、AVX2（float16 依赖 F16C）和 AVX-512 三个版本，运行时按CPU特性选择。
+    float16 一律转换成 float32 计算，再按就近偶数舍入转换回去，三个版本的结果逐位一致
+    （标量转换对NaN的处理也与F16C相同：置quiet位，截断时保留尾数的高位）。
+*/
+
+enum reduce_dtype { REDUCE_F32, REDUCE_F16, REDUCE_I64 };
+enum reduce_op { REDUCE_SUM, REDUCE_MAX };
+enum reduce_level { REDUCE_SCALAR, REDUCE_AVX2, REDUCE_AVX512 };
+
+typedef void (*reduce_fn)(void *dst, const void *src, size_t count);
+
+size_t reduce_dtype_size(reduce_dtype dtype) {
+    return dtype == REDUCE_F16 ? 2 : (dtype == REDUCE_F32 ? 4 : 8);
+}
+
+
+/* float16 <-> float32 标量转换 */
+float half_to_float(uint16_t h) {
+    uint32_t u = (uint32_t)(h & 0x7fff) << 13;
+    uint32_t exp = u & (0x7c00u << 13);
+    u += (127 - 15) << 23;
+    if (exp == (0x7c00u << 13)) {
+        u += (128 - 16) << 23;                  // Inf/NaN
+        if (u & 0x7fffff) {
+            u |= 0x400000;                      // 与 vcvtph2ps 一致：signaling NaN 转成 quiet NaN
+        }
+    } else if (exp == 0) {
+        u += 1 << 23;                           // 非规格化数
+        float f, magic;
+        uint32_t magic_u = 113u << 23;
+        memcpy(&f, &u, 4);
+        memcpy(&magic, &magic_u, 4);
+        f -= magic;
+        memcpy(&u, &f, 4);
+    }
+    u |= (uint32_t)(h & 0x8000) << 16;
+    float f;
+    memcpy(&f, &u, 4);
+    return f;
+}
+
+// 就近偶数舍入，与 vcvtps2ph 的结果一致
+uint16_t float_to_half(float f) {
+    uint32_t u;
+    memcpy(&u, &f, 4);
+    uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+    uint16_t h;
+    if (u >= (127u + 16) << 23) {
+        // 溢出为Inf；NaN与 vcvtps2ph 一致：置quiet位，保留尾数的高10位
+        h = u > (255u << 23) ? (uint16_t)(0x7e00 | ((u >> 13) & 0x3ff)) : 0x7c00;
+    } else if (u < 113u << 23) {
+        // 结果为非规格化数：借助浮点加法完成舍入
+        uint32_t magic_u = 126u << 23;
+        float v, magic;
+        memcpy(&v, &u, 4);
+        memcpy(&magic, &magic_u, 4);
+        v += magic;
+        memcpy(&u, &v, 4);
+        h = (uint16_t)(u - magic_u);
+    } else {
+        uint32_t mant_odd = (u >> 13) & 1;
+        u += ((uint32_t)(15 - 127) << 23) + 0xfff + mant_odd;
+        h = (uint16_t)(u >> 13);
+    }
+    return h | (uint16_t)(sign >> 16);
+}
+
+
+/* 标量 */
+void reduce_sum_f32_scalar(void *dst, const void *src, size_t count) {
+    float *d = (float *)dst;
+    const float *s = (const float *)src;
+    for (size_t i = 0; i < count; i++) {
+        d[i] += s[i];
+    }
+}
+
+void reduce_max_f32_scalar(void *dst, const void *src, size_t count) {
+    float *d = (float *)dst;
+    const float *s = (const float *)src;
+    for (size_t i = 0; i < count; i++) {
+        d[i] = s[i] > d[i] ? s[i] : d[i];
+    }
+}
+
+void reduce_sum_f16_scalar(void *dst, const void *src, size_t count) {
+    uint16_t *d = (uint16_t *)dst;
+    const uint16_t *s = (const uint16_t *)src;
+    for (size_t i = 0; i < count; i++) {
+        d[i] = float_to_half(half_to_float(d[i]) + half_to_float(s[i]));
+    }
+}
+
+void reduce_max_f16_scalar(void *dst, const void *src, size_t count) {
+    uint16_t *d = (uint16_t *)dst;
+    const uint16_t *s = (const uint16_t *)src;
+    for (size_t i = 0; i < count; i++) {
+        float a = half_to_float(d[i]), b = half_to_float(s[i]);
+        d[i] = float_to_half(b > a ? b : a);
+    }
+}
+
+void reduce_sum_i64_scalar(void *dst, const void *src, size_t count) {
+    int64_t *d = (int64_t *)dst;
+    const int64_t *s = (const int64_t *)src;
+    for (size_t i = 0; i < count; i++) {
+        d[i] = (int64_t)((uint64_t)d[i] + (uint64_t)s[i]);   // 溢出按补码回绕
+    }
+}
+
+void reduce_max_i64_scalar(void *dst, const void *src, size_t count) {
+    int64_t *d = (int64_t *)dst;
+    const int64_t *s = (const int64_t *)src;
+    for (size_t i = 0; i < count; i++) {
+        d[i] = s[i] > d[i] ? s[i] : d[i];
+    }
+}
+
+
+/* AVX2 */
+#define REDUCE_AVX2_TARGET "avx2,f16c"
+
+__attribute__((target(REDUCE_AVX2_TARGET)))
+void reduce_sum_f32_avx2(void *dst, const void *src, size_t count) {
+    float *d = (float *)dst;
+    const float *s = (const float *)src;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_ps(d + i, _mm256_add_ps(_mm256_loadu_ps(d + i), _mm256_loadu_ps(s + i)));
+    }
+    reduce_sum_f32_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target(REDUCE_AVX2_TARGET)))
+void reduce_max_f32_avx2(void *dst, const void *src, size_t count) {
+    float *d = (float *)dst;
+    const float *s = (const float *)src;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // max_ps(a, b) 在 a > b 时返回 a，否则返回 b，与标量版本的比较顺序一致
+        _mm256_storeu_ps(d + i, _mm256_max_ps(_mm256_loadu_ps(s + i), _mm256_loadu_ps(d + i)));
+    }
+    reduce_max_f32_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target(REDUCE_AVX2_TARGET)))
+void reduce_sum_f16_avx2(void *dst, const void *src, size_t count) {
+    uint16_t *d = (uint16_t *)dst;
+    const uint16_t *s = (const uint16_t *)src;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 a = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(d + i)));
+        __m256 b = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(s + i)));
+        _mm_storeu_si128((__m128i *)(d + i), _mm256_cvtps_ph(_mm256_add_ps(a, b), _MM_FROUND_TO_NEAREST_INT));
+    }
+    reduce_sum_f16_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target(REDUCE_AVX2_TARGET)))
+void reduce_max_f16_avx2(void *dst, const void *src, size_t count) {
+    uint16_t *d = (uint16_t *)dst;
+    const uint16_t *s = (const uint16_t *)src;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 a = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(d + i)));
+        __m256 b = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(s + i)));
+        _mm_storeu_si128((__m128i *)(d + i), _mm256_cvtps_ph(_mm256_max_ps(b, a), _MM_FROUND_TO_NEAREST_INT));
+    }
+    reduce_max_f16_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target(REDUCE_AVX2_TARGET)))
+void reduce_sum_i64_avx2(void *dst, const void *src, size_t count) {
+    int64_t *d = (int64_t *)dst;
+    const int64_t *s = (const int64_t *)src;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(d + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s + i));
+        _mm256_storeu_si256((__m256i *)(d + i), _mm256_add_epi64(a, b));
+    }
+    reduce_sum_i64_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target(REDUCE_AVX2_TARGET)))
+void reduce_max_i64_avx2(void *dst, const void *src, size_t count) {
+    int64_t *d = (int64_t *)dst;
+    const int64_t *s = (const int64_t *)src;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // AVX2 没有64位max指令，用比较+混合代替
+        __m256i a = _mm256_loadu_si256((const __m256i *)(d + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i b_gt = _mm256_cmpgt_epi64(b, a);
+        _mm256_storeu_si256((__m256i *)(d + i), _mm256_blendv_epi8(a, b, b_gt));
+    }
+    reduce_max_i64_scalar(d + i, s + i, count - i);
+}
+
+
+/* AVX-512 */
+#define REDUCE_AVX512_TARGET "avx512f"
+
+// GCC 12 对 avx512fintrin.h 中 _mm512_undefined_* 的自初始化会误报未初始化警告
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+__attribute__((target(REDUCE_AVX512_TARGET)))
+void reduce_sum_f32_avx512(void *dst, const void *src, size_t count) {
+    float *d = (float *)dst;
+    const float *s = (const float *)src;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm512_storeu_ps(d + i, _mm512_add_ps(_mm512_loadu_ps(d + i), _mm512_loadu_ps(s + i)));
+    }
+    reduce_sum_f32_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target(REDUCE_AVX512_TARGET)))
+void reduce_max_f32_avx512(void *dst, const void *src, size_t count) {
+    float *d = (float *)dst;
+    const float *s = (const float *)src;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm512_storeu_ps(d + i, _mm512_max_ps(_mm512_loadu_ps(s + i), _mm512_loadu_ps(d + i)));
+    }
+    reduce_max_f32_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target(REDUCE_AVX512_TARGET)))
+void reduce_sum_f16_avx512(void *dst, const void *src, size_t count) {
+    uint16_t *d = (uint16_t *)dst;
+    const uint16_t *s = (const uint16_t *)src;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 a = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *)(d + i)));
+        __m512 b = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *)(s + i)));
+        _mm256_storeu_si256((__m256i *)(d + i), _mm512_cvtps_ph(_mm512_add_ps(a, b), _MM_FROUND_TO_NEAREST_INT));
+    }
+    reduce_sum_f16_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target(REDUCE_AVX512_TARGET)))
+void reduce_max_f16_avx512(void *dst, const void *src, size_t count) {
+    uint16_t *d = (uint16_t *)dst;
+    const uint16_t *s = (const uint16_t *)src;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 a = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *)(d + i)));
+        __m512 b = _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i *)(s + i)));
+        _mm256_storeu_si256((__m256i *)(d + i), _mm512_cvtps_ph(_mm512_max_ps(b, a), _MM_FROUND_TO_NEAREST_INT));
+    }
+    reduce_max_f16_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target(REDUCE_AVX512_TARGET)))
+void reduce_sum_i64_avx512(void *dst, const void *src, size_t count) {
+    int64_t *d = (int64_t *)dst;
+    const int64_t *s = (const int64_t *)src;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm512_storeu_si512(d + i, _mm512_add_epi64(_mm512_loadu_si512(d + i), _mm512_loadu_si512(s + i)));
+    }
+    reduce_sum_i64_scalar(d + i, s + i, count - i);
+}
+
+__attribute__((target(REDUCE_AVX512_TARGET)))
+void reduce_max_i64_avx512(void *dst, const void *src, size_t count) {
+    int64_t *d = (int64_t *)dst;
+    const int64_t *s = (const int64_t *)src;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm512_storeu_si512(d + i, _mm512_max_epi64(_mm512_loadu_si512(d + i), _mm512_loadu_si512(s + i)));
+    }
+    reduce_max_i64_scalar(d + i, s + i, count - i);
+}
+
+#pragma GCC diagnostic pop
+
+
+/* 运行时选择 */
+static const reduce_fn g_reduce_table[3][3][2] = {
+    {   // REDUCE_SCALAR
+        {reduce_sum_f32_scalar, reduce_max_f32_scalar},
+        {reduce_sum_f16_scalar, reduce_max_f16_scalar},
+        {reduce_sum_i64_scalar, reduce_max_i64_scalar},
+    },
+    {   // REDUCE_AVX2
+        {reduce_sum_f32_avx2, reduce_max_f32_avx2},
+        {reduce_sum_f16_avx2, reduce_max_f16_avx2},
+        {reduce_sum_i64_avx2, reduce_max_i64_avx2},
+    },
+    {   // REDUCE_AVX512
+        {reduce_sum_f32_avx512, reduce_max_f32_avx512},
+        {reduce_sum_f16_avx512, reduce_max_f16_avx512},
+        {reduce_sum_i64_avx512, reduce_max_i64_avx512},
+    },
+};
+
+static const char *g_reduce_level_names[3] = {"scalar", "avx2", "avx512"};
+
+// 当前CPU支持的最高级别
+reduce_level reduce_best_level() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return REDUCE_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c")) {
+        return REDUCE_AVX2;
+    }
+    return REDUCE_SCALAR;
+}
+
+// 取指定级别的内核，level超过CPU能力时返回NULL
+reduce_fn reduce_kernel(reduce_dtype dtype, reduce_op op, reduce_level level, const char **name) {
+    if (level > reduce_best_level()) {
+        return NULL;
+    }
+    if (name) {
+        *name = g_reduce_level_names[level];
+    }
+    return g_reduce_table[level][dtype][op];
+}
+
+reduce_fn reduce_select(reduce_dtype dtype, reduce_op op, const char **name) {
+    return reduce_kernel(dtype, op, reduce_best_level(), name);
+}
+
+
+#endif  // _RDMA_REDUCE_HPP
@@ -0,0 +1,117 @@
+#include "rdma_coalesce.hpp"
+
+// 每个阶段开始前客户端通过TCP告知消息数，count为0表示结束
+struct coalesce_phase {
+    uint32_t count;
+};
+
+// 阶段结束后回复客户端
+struct coalesce_result {
+    uint32_t received;
+    uint32_t errors;
+    uint64_t batches;
+};
+
+// 第seq条消息的长度（32~256字节）
+uint32_t bench_msg_len(uint32_t seq) {
+    return 32 + (uint32_t)(((uint64_t)seq * 2654435761u) >> 7) % 225;
+}
+
+// 校验消息内容：前4字节为序号，其余字节为 (seq + i) & 0xff
+bool check_msg(const char *msg, uint32_t len, uint32_t seq) {
+    uint32_t got_seq;
+    if (len != bench_msg_len(seq)) {
+        return false;
+    }
+    memcpy(&got_seq, msg, sizeof(got_seq));
+    if (got_seq != seq) {
+        return false;
+    }
+    for (uint32_t i = sizeof(seq); i < len; i++) {
+        if ((uint8_t)msg[i] != (uint8_t)(seq + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int rdma_server_coalesce(rdma_context *_ctx, int client_fd) {
+    if (rdma_alloc_resources(_ctx, CREDIT_BUF_SIZE, 2 * (CREDIT_SEND_SLOTS + CREDIT_RECV_SLOTS), IBV_ACCESS_LOCAL_WRITE) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, CREDIT_SEND_SLOTS + CREDIT_CTRL_SLOTS, CREDIT_RECV_SLOTS) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, client_fd, &remote_qp_info, IBV_ACCESS_LOCAL_WRITE, 0) < 0) {
+        return -1;
+    }
+
+    credit_channel ch;
+    if (credit_channel_init(&ch, _ctx) < 0 || credit_handshake(&ch, client_fd) < 0) {
+        return -1;
+    }
+    coalesce_receiver cr;
+    coalesce_receiver_init(&cr, &ch);
+
+    while (true) {
+        coalesce_phase phase;
+        if (sock_recv_all(client_fd, &phase, sizeof(phase)) < 0) {
+            std::cerr << "Failed to receive phase" << std::endl;
+            return -1;
+        }
+        if (phase.count == 0) {
+            break;
+        }
+        uint64_t start_batches = cr.batches;
+        coalesce_result result;
+        memset(&result, 0, sizeof(result));
+        for (uint32_t seq = 0; seq < phase.count; seq++) {
+            uint32_t len;
+            const char *msg = coalesce_recv(&cr, &len);
+            if (!msg) {
+                return -1;
+            }
+            if (!check_msg(msg, len, seq)) {
+                result.errors++;
+            }
+            result.received++;
+        }
+        result.batches = cr.batches - start_batches;
+        if (sock_send_all(client_fd, &result, sizeof(result)) < 0) {
+            std::cerr << "Failed to send result" << std::endl;
+            return -1;
+        }
+    }
+
+    std::cout << "Received " << cr.msgs << " messages in " << cr.batches << " batches"
+              << ", credit messages sent: " << ch.credit_msgs_sent << std::endl;
+    return credit_drain(&ch);
+}
+
+
+int main() {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_server_coalesce(&ctx, client_fd);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
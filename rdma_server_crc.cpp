@@ -0,0 +1,153 @@
+#include "rdma_common.hpp"
+#include "rdma_crc32c.hpp"
+
+/*
+    带CRC32C端到端校验的RDMA写/读服务端。
+    客户端按块RDMA_WRITE_WITH_IMM（立即数据为块号）写入本端缓冲区，本端每收到一个块的通知就计算该块的CRC，
+    与后续块的传输重叠；最后客户端写入尾部（每块CRC数组）并以立即数据携带整体摘要，本端比对后通过TCP回复结果。
+    读阶段由客户端RDMA_READ本端的数据和尾部，本端不参与。
+*/
+
+#define CRC_MAX_RECV_DEPTH 8192     // 预先post的接收数上限，受设备max_qp_wr限制
+
+struct crc_bench_config {
+    uint64_t size;          // 传输的数据量
+    uint32_t chunk;         // 块大小
+    uint32_t iters;
+    uint32_t integrity;     // 0表示不校验
+};
+
+int post_notify_recv(rdma_context *_ctx) {
+    struct ibv_recv_wr recv_wr, *bad_recv_wr;
+    memset(&recv_wr, 0, sizeof(recv_wr));
+    recv_wr.sg_list = NULL;     // RDMA_WRITE_WITH_IMM不消耗接收缓冲区，只需要接收请求
+    recv_wr.num_sge = 0;
+    if (ibv_post_recv(_ctx->qp, &recv_wr, &bad_recv_wr)) {
+        std::cerr << "Failed to post receive request" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 等待一个写通知，返回立即数据
+int wait_notify(rdma_context *_ctx, uint32_t *imm) {
+    struct ibv_wc wc;
+    while (ibv_poll_cq(_ctx->cq, 1, &wc) == 0);
+    if (wc.status != IBV_WC_SUCCESS) {
+        std::cerr << "Receive failed with status " << ibv_wc_status_str(wc.status) << std::endl;
+        return -1;
+    }
+    *imm = ntohl(wc.imm_data);
+    return post_notify_recv(_ctx);
+}
+
+int rdma_server_crc(rdma_context *_ctx, int client_fd) {
+    crc_bench_config cfg;
+    if (sock_recv_all(client_fd, &cfg, sizeof(cfg)) < 0) {
+        std::cerr << "Failed to receive benchmark config" << std::endl;
+        return -1;
+    }
+    uint32_t nchunks = (uint32_t)((cfg.size + cfg.chunk - 1) / cfg.chunk);
+    size_t trailer_size = (nchunks + 1) * sizeof(uint32_t);
+
+    // 每轮客户端连续写 nchunks + 1 个通知（最后一个是尾部），全部预先post，块再小也不依赖RNR重试
+    int recv_depth = (int)std::min<uint32_t>(nchunks + 1, CRC_MAX_RECV_DEPTH);
+    if (recv_depth < (int)nchunks + 1) {
+        std::cout << "Chunk count exceeds " << CRC_MAX_RECV_DEPTH << ", relying on RNR retry" << std::endl;
+    }
+
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    if (rdma_alloc_resources(_ctx, cfg.size + trailer_size, recv_depth + 16, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, 16, recv_depth) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, client_fd, &remote_qp_info, access) < 0) {
+        return -1;
+    }
+    for (int i = 0; i < recv_depth; i++) {
+        if (post_notify_recv(_ctx) < 0) {
+            return -1;
+        }
+    }
+    const char *impl;
+    crc32c_select(&impl);
+    std::cout << "CRC32C implementation: " << impl << std::endl;
+
+    // 接收全部post完成后再让客户端开始写
+    char ready = 1;
+    if (sock_send_all(client_fd, &ready, 1) < 0) {
+        return -1;
+    }
+
+    uint32_t *trailer = (uint32_t *)(_ctx->buffer + cfg.size);
+    std::vector<uint32_t> computed(nchunks);
+    for (uint32_t it = 0; it < cfg.iters; it++) {
+        uint32_t imm;
+        if (cfg.integrity) {
+            // 每个块到达后立即计算，与后续块的传输重叠
+            for (uint32_t n = 0; n < nchunks; n++) {
+                if (wait_notify(_ctx, &imm) < 0) {
+                    return -1;
+                }
+                uint64_t off = (uint64_t)imm * cfg.chunk;
+                computed[imm] = crc32c(0, _ctx->buffer + off, std::min((uint64_t)cfg.chunk, cfg.size - off));
+            }
+        }
+        // 尾部（不校验时为零长度的结束通知）
+        if (wait_notify(_ctx, &imm) < 0) {
+            return -1;
+        }
+        char ok = 1;
+        if (cfg.integrity) {
+            uint32_t bad = 0;
+            for (uint32_t n = 0; n < nchunks; n++) {
+                if (computed[n] != trailer[n]) {
+                    bad++;
+                }
+            }
+            uint32_t digest = crc32c(0, trailer, nchunks * sizeof(uint32_t));
+            if (bad > 0 || digest != imm || digest != trailer[nchunks]) {
+                std::cerr << "Integrity check failed: " << bad << " corrupted chunks" << std::endl;
+                ok = 0;
+            }
+        }
+        if (sock_send_all(client_fd, &ok, 1) < 0) {
+            return -1;
+        }
+    }
+
+    // 等待客户端完成读阶段
+    char done;
+    sock_recv_all(client_fd, &done, 1);
+    return 0;
+}
+
+
+int main() {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_server_crc(&ctx, client_fd);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -0,0 +1,87 @@
+#include "rdma_credit.hpp"
+
+// 基准测试参数，由客户端通过TCP下发
+struct credit_bench_config {
+    uint32_t rounds;     // 突发轮数
+    uint32_t burst;      // 每轮突发的消息数
+    uint32_t oneway;     // 单向阶段的消息数
+};
+
+int rdma_server_credit(rdma_context *_ctx, int client_fd) {
+    credit_bench_config cfg;
+    if (sock_recv_all(client_fd, &cfg, sizeof(cfg)) < 0) {
+        std::cerr << "Failed to receive benchmark config" << std::endl;
+        return -1;
+    }
+
+    if (rdma_alloc_resources(_ctx, CREDIT_BUF_SIZE, 2 * (CREDIT_SEND_SLOTS + CREDIT_RECV_SLOTS), IBV_ACCESS_LOCAL_WRITE) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, CREDIT_SEND_SLOTS + CREDIT_CTRL_SLOTS, CREDIT_RECV_SLOTS) < 0) {
+        return -1;
+    }
+    // rnr_retry = 0：有了信用流控后不应出现RNR，一旦出现立即以错误完成暴露出来
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, client_fd, &remote_qp_info, IBV_ACCESS_LOCAL_WRITE, 0) < 0) {
+        return -1;
+    }
+
+    credit_channel ch;
+    if (credit_channel_init(&ch, _ctx) < 0 || credit_handshake(&ch, client_fd) < 0) {
+        return -1;
+    }
+
+    // 阶段一：突发回显
+    char msg[CREDIT_MSG_SIZE];
+    for (uint32_t r = 0; r < cfg.rounds; r++) {
+        for (uint32_t i = 0; i < cfg.burst; i++) {
+            int len = credit_recv(&ch, msg, sizeof(msg));
+            if (len < 0 || credit_send(&ch, msg, len) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    // 阶段二：单向接收，只依靠纯信用消息归还信用
+    for (uint32_t i = 0; i < cfg.oneway; i++) {
+        if (credit_recv(&ch, msg, sizeof(msg)) < 0) {
+            return -1;
+        }
+    }
+    strcpy(msg, "Done");
+    if (credit_send(&ch, msg, strlen(msg) + 1) < 0 || credit_drain(&ch) < 0) {
+        return -1;
+    }
+
+    std::cout << "Credit messages sent: " << ch.credit_msgs_sent
+              << ", credits piggybacked: " << ch.piggybacked
+              << ", RNR errors: " << ch.rnr_errors << std::endl;
+    return 0;
+}
+
+
+int main() {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_server_credit(&ctx, client_fd);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -0,0 +1,322 @@
+#include "rdma_xport.hpp"
+#include <csignal>
+#include <cerrno>
+
+/*
+    常驻服务端：设备、PD、CQ和注册好的内存池只初始化一次，之后循环accept客户端。
+    每个连接结束后QP经 ERROR -> RESET 回收，下一个客户端直接从 RESET -> INIT 开始建链，
+    省去了每次打开设备、注册MR和创建QP的开销。
+    收到SIGINT/SIGTERM后不再接受新连接，把QP切到ERROR并等待所有在途WR冲刷完成后退出。
+
+    用法: ./rdma_server_daemon [rw|sr]
+      rw  与rdma_client_rw配合：RDMA读客户端缓冲区，再RDMA写回 "Hello from server"；
+          rdma_client_rw 经 xport_open 建链，这里按同样的顺序交换设备标志和缓冲区大小，只接受RDMA
+      sr  与rdma_client_sr配合：接收Ping，回复Pong
+*/
+
+#define DAEMON_ARENA_SLOTS 64                       // 内存池中的缓冲区个数，按连接轮转使用
+#define DAEMON_ARENA_SIZE (DAEMON_ARENA_SLOTS * BUFFER_SIZE)
+#define DAEMON_OP_TIMEOUT_MS 5000                   // 单个操作的最长等待时间，防止客户端异常时卡死
+#define DAEMON_WR_EMPTY_RECV 1                      // rw模式下接收客户端结束消息的wr_id
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void handle_signal(int) {
+    g_stop = 1;
+}
+
+struct daemon_state {
+    rdma_context ctx;
+    int access;             // QP访问权限
+    int outstanding;        // 已post但尚未完成的WR数
+    uint64_t served;        // 已服务的连接数
+};
+
+
+// 等待一个完成，超时或失败返回-1
+int daemon_wait(daemon_state *ds, struct ibv_wc *wc) {
+    uint64_t deadline = now_ns() + (uint64_t)DAEMON_OP_TIMEOUT_MS * 1000000;
+    while (true) {
+        int n = ibv_poll_cq(ds->ctx.cq, 1, wc);
+        if (n < 0) {
+            std::cerr << "Failed to poll CQ" << std::endl;
+            return -1;
+        }
+        if (n == 1) {
+            ds->outstanding--;
+            if (wc->status != IBV_WC_SUCCESS) {
+                std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc->status) << std::endl;
+                return -1;
+            }
+            return 0;
+        }
+        if (now_ns() > deadline) {
+            std::cerr << "Timed out waiting for completion" << std::endl;
+            return -1;
+        }
+    }
+}
+
+// 回收QP：切到ERROR冲刷所有在途WR，再切回RESET等待下一个连接
+int daemon_recycle_qp(daemon_state *ds) {
+    if (modify_qp_to_error(ds->ctx.qp) < 0) {
+        return -1;
+    }
+    struct ibv_wc wc;
+    while (ds->outstanding > 0) {
+        int n = ibv_poll_cq(ds->ctx.cq, 1, &wc);
+        if (n < 0) {
+            std::cerr << "Failed to poll CQ" << std::endl;
+            return -1;
+        }
+        ds->outstanding -= n;
+    }
+    return modify_qp_to_reset(ds->ctx.qp);
+}
+
+// RESET -> INIT -> RTR -> RTS，本地地址指向本连接使用的内存池槽位
+int daemon_connect(daemon_state *ds, int client_fd, char *slot, qp_info *remote_info) {
+    if (modify_qp_to_init(ds->ctx.qp, ds->access) < 0) {
+        return -1;
+    }
+    qp_info local_info;
+    if (fill_local_qp_info(&ds->ctx, &local_info) < 0) {
+        return -1;
+    }
+    local_info.addr = (uintptr_t)slot;
+    if (exchange_qp_info(client_fd, &local_info, remote_info) < 0) {
+        std::cerr << "Failed to exchange QP info" << std::endl;
+        return -1;
+    }
+    if (modify_qp_to_rtr(ds->ctx.qp, remote_info) < 0) {
+        return -1;
+    }
+    return modify_qp_to_rts(ds->ctx.qp);
+}
+
+// xport_open 的第一步：交换是否有RDMA设备，客户端没有时它会退回TCP，常驻服务端不支持
+int daemon_negotiate_rw(int client_fd) {
+    uint8_t local_has = 1, remote_has;
+    if (sock_send_all(client_fd, &local_has, 1) < 0 || sock_recv_all(client_fd, &remote_has, 1) < 0) {
+        std::cerr << "Failed to negotiate transport" << std::endl;
+        return -1;
+    }
+    if (!remote_has) {
+        std::cerr << "Client has no RDMA device, rdma_server_daemon only serves RDMA" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 双边发送一条空消息，与rdma_xport.hpp的结束同步对应
+int daemon_post_empty(daemon_state *ds, bool send) {
+    if (send) {
+        struct ibv_send_wr wr, *bad_wr;
+        memset(&wr, 0, sizeof(wr));
+        wr.opcode = IBV_WR_SEND;
+        wr.num_sge = 0;
+        wr.send_flags = IBV_SEND_SIGNALED;
+        if (ibv_post_send(ds->ctx.qp, &wr, &bad_wr)) {
+            std::cerr << "Failed to post send request" << std::endl;
+            return -1;
+        }
+    } else {
+        struct ibv_recv_wr recv_wr, *bad_recv_wr;
+        memset(&recv_wr, 0, sizeof(recv_wr));
+        recv_wr.wr_id = DAEMON_WR_EMPTY_RECV;
+        recv_wr.num_sge = 0;
+        if (ibv_post_recv(ds->ctx.qp, &recv_wr, &bad_recv_wr)) {
+            std::cerr << "Failed to post receive request" << std::endl;
+            return -1;
+        }
+    }
+    ds->outstanding++;
+    return 0;
+}
+
+// 等待一个发送方向的完成；客户端结束消息可能先到，记下后继续等
+int daemon_wait_send(daemon_state *ds, struct ibv_wc *wc, bool *got_empty) {
+    while (true) {
+        if (daemon_wait(ds, wc) < 0) {
+            return -1;
+        }
+        if (wc->wr_id != DAEMON_WR_EMPTY_RECV) {
+            return 0;
+        }
+        *got_empty = true;
+    }
+}
+
+// 与rdma_server_rw相同的交互：先RDMA读，再RDMA写，最后互发空消息
+int daemon_serve_rw(daemon_state *ds, int client_fd, char *slot, const qp_info *remote_info) {
+    // 先post接收客户端结束时的空消息，再交换缓冲区大小（xport_open的最后一步）
+    if (daemon_post_empty(ds, false) < 0) {
+        return -1;
+    }
+    uint64_t local_size = BUFFER_SIZE, remote_size;
+    if (sock_send_all(client_fd, &local_size, sizeof(local_size)) < 0 ||
+        sock_recv_all(client_fd, &remote_size, sizeof(remote_size)) < 0) {
+        std::cerr << "Failed to exchange buffer sizes" << std::endl;
+        return -1;
+    }
+    if (remote_size < BUFFER_SIZE) {
+        std::cerr << "Client buffer too small" << std::endl;
+        return -1;
+    }
+
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)slot;
+    sge.length = BUFFER_SIZE;
+    sge.lkey = ds->ctx.mr->lkey;
+
+    memset(slot, 0, BUFFER_SIZE);
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.opcode = IBV_WR_RDMA_READ;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.wr.rdma.remote_addr = remote_info->addr;
+    wr.wr.rdma.rkey = remote_info->rkey;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    if (ibv_post_send(ds->ctx.qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post RDMA read request" << std::endl;
+        return -1;
+    }
+    ds->outstanding++;
+
+    struct ibv_wc wc;
+    bool got_empty = false;
+    if (daemon_wait_send(ds, &wc, &got_empty) < 0) {
+        return -1;
+    }
+    std::cout << "RDMA Read completed, received: " << slot << std::endl;
+
+    strcpy(slot, "Hello from server");
+    wr.opcode = IBV_WR_RDMA_WRITE;
+    if (ibv_post_send(ds->ctx.qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post RDMA write request" << std::endl;
+        return -1;
+    }
+    ds->outstanding++;
+    if (daemon_wait_send(ds, &wc, &got_empty) < 0) {
+        return -1;
+    }
+
+    // 发送空消息，再等客户端的空消息（如果还没到）
+    if (daemon_post_empty(ds, true) < 0 || daemon_wait_send(ds, &wc, &got_empty) < 0) {
+        return -1;
+    }
+    return got_empty ? 0 : daemon_wait(ds, &wc);
+}
+
+// 与rdma_server_sr相同的交互：接收Ping，回复Pong
+int daemon_serve_sr(daemon_state *ds, char *slot) {
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)slot;
+    sge.length = BUFFER_SIZE;
+    sge.lkey = ds->ctx.mr->lkey;
+
+    struct ibv_recv_wr recv_wr, *bad_recv_wr;
+    memset(&recv_wr, 0, sizeof(recv_wr));
+    recv_wr.sg_list = &sge;
+    recv_wr.num_sge = 1;
+    if (ibv_post_recv(ds->ctx.qp, &recv_wr, &bad_recv_wr)) {
+        std::cerr << "Failed to post receive request" << std::endl;
+        return -1;
+    }
+    ds->outstanding++;
+
+    struct ibv_wc wc;
+    if (daemon_wait(ds, &wc) < 0) {
+        return -1;
+    }
+    std::cout << "Received message: " << slot << std::endl;
+
+    strcpy(slot, "Pong");
+    sge.length = strlen(slot) + 1;
+    struct ibv_send_wr send_wr, *bad_send_wr;
+    memset(&send_wr, 0, sizeof(send_wr));
+    send_wr.opcode = IBV_WR_SEND;
+    send_wr.sg_list = &sge;
+    send_wr.num_sge = 1;
+    send_wr.send_flags = IBV_SEND_SIGNALED;
+    if (ibv_post_send(ds->ctx.qp, &send_wr, &bad_send_wr)) {
+        std::cerr << "Failed to post send request" << std::endl;
+        return -1;
+    }
+    ds->outstanding++;
+    return daemon_wait(ds, &wc);
+}
+
+
+int main(int argc, char *argv[]) {
+    bool sr_mode = argc > 1 && strcmp(argv[1], "sr") == 0;
+
+    // 不设置SA_RESTART，使阻塞中的accept被信号打断
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // 一次性初始化设备、PD、CQ、内存池和QP
+    uint64_t setup_start = now_ns();
+    daemon_state ds;
+    memset(&ds, 0, sizeof(ds));
+    ds.access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    if (rdma_alloc_resources(&ds.ctx, DAEMON_ARENA_SIZE, 16, ds.access) < 0 ||
+        rdma_create_rc_qp(&ds.ctx, 8, 8) < 0) {
+        rdma_free_resources(&ds.ctx);
+        return -1;
+    }
+    std::cout << "Device/PD/CQ/MR setup took " << (now_ns() - setup_start) / 1000.0 << " us (paid once)" << std::endl;
+
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        rdma_free_resources(&ds.ctx);
+        return -1;
+    }
+
+    while (!g_stop) {
+        int client_fd = accept(server_fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Accept failed" << std::endl;
+            break;
+        }
+        uint64_t conn_start = now_ns();
+        char *slot = ds.ctx.buffer + (ds.served % DAEMON_ARENA_SLOTS) * BUFFER_SIZE;
+
+        qp_info remote_info;
+        int ret = sr_mode ? 0 : daemon_negotiate_rw(client_fd);
+        if (ret == 0) {
+            ret = daemon_connect(&ds, client_fd, slot, &remote_info);
+        }
+        if (ret == 0) {
+            std::cout << "Client " << ds.served << " connected, QP ready in "
+                      << (now_ns() - conn_start) / 1000.0 << " us" << std::endl;
+            ret = sr_mode ? daemon_serve_sr(&ds, slot) : daemon_serve_rw(&ds, client_fd, slot, &remote_info);
+        }
+        if (ret < 0) {
+            std::cerr << "Client " << ds.served << " failed" << std::endl;
+        }
+        close(client_fd);
+        ds.served++;
+
+        if (daemon_recycle_qp(&ds) < 0) {
+            break;
+        }
+    }
+
+    // 优雅退出：QP已经在回收时冲刷了所有在途WR
+    std::cout << "Shutting down after serving " << ds.served << " clients" << std::endl;
+    close(server_fd);
+    if (ds.outstanding > 0) {
+        daemon_recycle_qp(&ds);
+    }
+    rdma_free_resources(&ds.ctx);
+    return 0;
+}
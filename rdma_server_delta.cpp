@@ -0,0 +1,78 @@
+#include "rdma_delta.hpp"
+
+/*
+    增量同步的服务端：缓冲区为 [数据 | 指纹数组]，初始内容由客户端发来的种子生成。
+    每轮客户端写完后发送 DELTA_CMD_VERIFY，服务端重新计算指纹（不计入客户端的同步时间），
+    并回复整个数据区的CRC32C供客户端校验。
+*/
+
+int rdma_server_delta(rdma_context *_ctx, int client_fd) {
+    delta_config cfg;
+    if (sock_recv_all(client_fd, &cfg, sizeof(cfg)) < 0 || cfg.block_size == 0) {
+        std::cerr << "Failed to receive config" << std::endl;
+        return -1;
+    }
+    uint64_t nblocks = (cfg.size + cfg.block_size - 1) / cfg.block_size;
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    if (rdma_alloc_resources(_ctx, cfg.size + nblocks * sizeof(uint32_t), 16, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, 16, 16) < 0) {
+        return -1;
+    }
+    char *data = _ctx->buffer;
+    uint32_t *fps = (uint32_t *)(_ctx->buffer + cfg.size);
+    int nthreads = std::max(1u, std::min(std::thread::hardware_concurrency(), 8u));
+    fill_base(data, cfg.size, cfg.seed);
+    delta_fingerprints(data, cfg.size, cfg.block_size, fps, nthreads);
+
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, client_fd, &remote_qp_info, access) < 0) {
+        return -1;
+    }
+
+    while (true) {
+        uint32_t cmd;
+        if (sock_recv_all(client_fd, &cmd, sizeof(cmd)) < 0) {
+            std::cerr << "Failed to receive command" << std::endl;
+            return -1;
+        }
+        if (cmd == DELTA_CMD_DONE) {
+            break;
+        }
+        delta_fingerprints(data, cfg.size, cfg.block_size, fps, nthreads);
+        uint32_t digest = crc32c(0, data, cfg.size);
+        if (sock_send_all(client_fd, &digest, sizeof(digest)) < 0) {
+            std::cerr << "Failed to send digest" << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+int main() {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_server_delta(&ctx, client_fd);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
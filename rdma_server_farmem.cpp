@@ -0,0 +1,51 @@
+#include "rdma_common.hpp"
+
+/*
+    远端内存捐献方：注册一大块内存并把地址和rkey交给客户端，之后只等待客户端断开，
+    所有读写都由客户端通过RDMA_READ/WRITE单边完成。
+    用法: ./rdma_server_farmem [remote_mb] [port]，在同一台机器上启动多个进程时用不同的端口。
+*/
+
+int main(int argc, char *argv[]) {
+    uint64_t size = (uint64_t)(argc > 1 ? atoi(argv[1]) : 1024) << 20;
+
+    int port = argc > 2 ? atoi(argv[2]) : PORT;
+
+    int server_fd = tcp_listen(port);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    int ret = -1;
+    qp_info remote_qp_info;
+    if (rdma_alloc_resources(&ctx, size, 16, access) == 0 &&
+        rdma_create_rc_qp(&ctx, 16, 16) == 0 &&
+        rdma_connect_qp(&ctx, client_fd, &remote_qp_info, access) == 0) {
+        // 告知客户端远端内存的大小
+        uint64_t remote_size = size;
+        if (sock_send_all(client_fd, &remote_size, sizeof(remote_size)) == 0) {
+            std::cout << "Donating " << (size >> 20) << " MB of memory" << std::endl;
+            char byte;
+            while (recv(client_fd, &byte, 1, 0) > 0);   // 等待客户端断开
+            ret = 0;
+        }
+    }
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
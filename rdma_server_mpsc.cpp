@@ -0,0 +1,43 @@
+#include "rdma_common.hpp"
+
+/*
+    rdma_client_mpsc 的被动端：注册一块可远程写的内存，客户端的所有RDMA_WRITE单边完成，
+    服务端只等待客户端断开。
+*/
+
+#define MPSC_SERVER_BUF_SIZE (1 << 20)
+
+int main() {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE;
+    int ret = -1;
+    qp_info remote_qp_info;
+    if (rdma_alloc_resources(&ctx, MPSC_SERVER_BUF_SIZE, 16, access) == 0 &&
+        rdma_create_rc_qp(&ctx, 16, 16) == 0 &&
+        rdma_connect_qp(&ctx, client_fd, &remote_qp_info, access) == 0) {
+        char byte;
+        while (recv(client_fd, &byte, 1, 0) > 0);   // 等待客户端断开
+        ret = 0;
+    }
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -0,0 +1,100 @@
+#include "rdma_msg.hpp"
+
+// 基准测试参数，由客户端通过TCP下发
+struct msg_bench_config {
+    uint64_t min_size;      // 最小消息长度
+    uint64_t max_size;      // 最大消息长度，每轮翻4倍
+    uint32_t iters;         // 每种长度的消息数
+    uint32_t frag_size;
+    uint32_t zero_copy;     // 0表示经中转区拷贝
+};
+
+int rdma_server_msg(rdma_context *_ctx, int client_fd) {
+    msg_bench_config cfg;
+    if (sock_recv_all(client_fd, &cfg, sizeof(cfg)) < 0) {
+        std::cerr << "Failed to receive benchmark config" << std::endl;
+        return -1;
+    }
+
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE;
+    if (rdma_alloc_resources(_ctx, msg_buffer_size(cfg.frag_size), 4 * MSG_WINDOW, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(_ctx, 2 * MSG_WINDOW, MSG_WINDOW, 2, sizeof(uint64_t)) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, client_fd, &remote_qp_info, access) < 0) {
+        return -1;
+    }
+    msg_channel ch;
+    msg_channel_init(&ch, _ctx, cfg.frag_size);
+    msg_channel_set_remote(&ch, &remote_qp_info);
+
+    // 目的缓冲区，零拷贝模式下整体注册，分片直接落入其中
+    char *dst = (char *)malloc(cfg.max_size);
+    if (!dst) {
+        std::cerr << "Failed to allocate destination buffer" << std::endl;
+        return -1;
+    }
+    struct ibv_mr *dst_mr = NULL;
+    if (cfg.zero_copy) {
+        dst_mr = ibv_reg_mr(_ctx->pd, dst, cfg.max_size, IBV_ACCESS_LOCAL_WRITE);
+        if (!dst_mr) {
+            std::cerr << "Failed to register destination buffer" << std::endl;
+            free(dst);
+            return -1;
+        }
+    }
+
+    int ret = 0;
+    for (uint64_t size = cfg.min_size; size <= cfg.max_size && ret == 0; size *= 4) {
+        for (uint32_t i = 0; i < cfg.iters; i++) {
+            int64_t len = msg_recv(&ch, dst, cfg.max_size, dst_mr);
+            if (len != (int64_t)size || dst[0] != (char)i || dst[len - 1] != (char)i) {
+                std::cerr << "Message " << i << " of size " << size << " corrupted" << std::endl;
+                ret = -1;
+                break;
+            }
+        }
+        // 每种长度结束后通过TCP确认，客户端据此计时
+        char ack = ret == 0 ? 1 : 0;
+        if (sock_send_all(client_fd, &ack, 1) < 0) {
+            ret = -1;
+        }
+    }
+    std::cout << "Fragments received: " << ch.zero_copy_frags << " zero-copy, " << ch.copied_frags << " copied" << std::endl;
+
+    if (dst_mr) {
+        ibv_dereg_mr(dst_mr);
+    }
+    free(dst);
+    return ret;
+}
+
+
+int main() {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_server_msg(&ctx, client_fd);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
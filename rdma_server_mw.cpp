@@ -0,0 +1,243 @@
+#include "rdma_mw.hpp"
+#include <deque>
+
+/*
+    内存窗口授权服务端
+
+    1. 本地基准：对不同长度的子区间比较 绑定+本地撤销（BIND_MW / LOCAL_INV）与 ibv_reg_mr + ibv_dereg_mr 的开销；
+    2. 服务客户端：收到 MW_REQ_GRANT 后绑定一个窗口并回复地址和rkey，
+       客户端用完后发送 SEND_WITH_INV 撤销，收到 MW_REQ_DONE 后等待客户端断开。
+*/
+
+#define MW_ARENA_SIZE (64 << 20)
+#define MW_RECV_SLOTS 4
+
+struct mw_server {
+    rdma_context ctx;
+    struct ibv_mr *ctrl_mr;             // 收发控制消息的缓冲区
+    char ctrl[(MW_RECV_SLOTS + 1) * sizeof(mw_request)];
+    mw_pool pool;
+    std::deque<struct ibv_wc> pending_recv;     // 等待发送完成时到达的接收
+};
+
+
+int post_ctrl_recv(mw_server *srv, int slot) {
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)(srv->ctrl + slot * sizeof(mw_request));
+    sge.length = sizeof(mw_request);
+    sge.lkey = srv->ctrl_mr->lkey;
+    struct ibv_recv_wr recv_wr, *bad_recv_wr;
+    memset(&recv_wr, 0, sizeof(recv_wr));
+    recv_wr.wr_id = slot;
+    recv_wr.sg_list = &sge;
+    recv_wr.num_sge = 1;
+    if (ibv_post_recv(srv->ctx.qp, &recv_wr, &bad_recv_wr)) {
+        std::cerr << "Failed to post receive request" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 等待一个发送队列上的完成，期间到达的接收完成暂存起来
+int wait_send(mw_server *srv) {
+    struct ibv_wc wc;
+    while (true) {
+        int n = ibv_poll_cq(srv->ctx.cq, 1, &wc);
+        if (n < 0) {
+            std::cerr << "Failed to poll CQ" << std::endl;
+            return -1;
+        }
+        if (n == 0) {
+            continue;
+        }
+        if (wc.status != IBV_WC_SUCCESS) {
+            std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc.status) << std::endl;
+            return -1;
+        }
+        if (wc.opcode & IBV_WC_RECV) {
+            srv->pending_recv.push_back(wc);
+            continue;
+        }
+        return 0;
+    }
+}
+
+int wait_recv(mw_server *srv, struct ibv_wc *wc) {
+    if (!srv->pending_recv.empty()) {
+        *wc = srv->pending_recv.front();
+        srv->pending_recv.pop_front();
+        return 0;
+    }
+    while (true) {
+        int n = ibv_poll_cq(srv->ctx.cq, 1, wc);
+        if (n < 0) {
+            std::cerr << "Failed to poll CQ" << std::endl;
+            return -1;
+        }
+        if (n == 1) {
+            if (wc->status != IBV_WC_SUCCESS) {
+                std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc->status) << std::endl;
+                return -1;
+            }
+            return 0;
+        }
+    }
+}
+
+// 本地基准：每种长度重复reps次
+int bench_grants(mw_server *srv) {
+    uint64_t sizes[] = {4096, 64 << 10, 1 << 20, 16 << 20};
+    int access = IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    for (uint64_t size : sizes) {
+        int reps = size >= (16 << 20) ? 100 : 1000;
+        std::vector<double> grant_us, revoke_us, reg_us, dereg_us;
+        for (int i = 0; i < reps; i++) {
+            uint64_t offset = (uint64_t)i * 4096 % (MW_ARENA_SIZE - size + 1);
+            mw_grant grant;
+            uint64_t t0 = now_ns();
+            if (mw_grant_post(&srv->pool, offset, size, access, &grant) < 0 || wait_send(srv) < 0) {
+                return -1;
+            }
+            uint64_t t1 = now_ns();
+            if (mw_revoke_post(&srv->pool, grant.rkey) < 0 || wait_send(srv) < 0) {
+                return -1;
+            }
+            uint64_t t2 = now_ns();
+            struct ibv_mr *mr = ibv_reg_mr(srv->ctx.pd, srv->ctx.buffer + offset, size, IBV_ACCESS_LOCAL_WRITE | access);
+            if (!mr) {
+                std::cerr << "Failed to register MR" << std::endl;
+                return -1;
+            }
+            uint64_t t3 = now_ns();
+            ibv_dereg_mr(mr);
+            uint64_t t4 = now_ns();
+            grant_us.push_back((t1 - t0) / 1000.0);
+            revoke_us.push_back((t2 - t1) / 1000.0);
+            reg_us.push_back((t3 - t2) / 1000.0);
+            dereg_us.push_back((t4 - t3) / 1000.0);
+        }
+        std::cout << "Region size: " << size << " bytes" << std::endl;
+        print_latency_stats("  bind_mw  ", grant_us);
+        print_latency_stats("  local_inv", revoke_us);
+        print_latency_stats("  reg_mr   ", reg_us);
+        print_latency_stats("  dereg_mr ", dereg_us);
+    }
+    return 0;
+}
+
+int serve_grants(mw_server *srv) {
+    char *reply_buf = srv->ctrl + MW_RECV_SLOTS * sizeof(mw_request);
+    while (true) {
+        struct ibv_wc wc;
+        if (wait_recv(srv, &wc) < 0) {
+            return -1;
+        }
+        mw_handle_recv(&srv->pool, &wc);
+        int slot = (int)wc.wr_id;
+        mw_request req;
+        memcpy(&req, srv->ctrl + slot * sizeof(mw_request), sizeof(req));
+        if (post_ctrl_recv(srv, slot) < 0) {
+            return -1;
+        }
+        if (req.type == MW_REQ_DONE) {
+            break;
+        }
+        if (req.type != MW_REQ_GRANT) {
+            continue;       // MW_REQ_RELEASE：窗口已在mw_handle_recv中回收
+        }
+
+        mw_reply reply;
+        memset(&reply, 0, sizeof(reply));
+        mw_grant grant;
+        if (mw_grant_post(&srv->pool, req.offset, req.length, (int)req.access, &grant) == 0 && wait_send(srv) == 0) {
+            reply.addr = grant.addr;
+            reply.rkey = grant.rkey;
+        } else {
+            reply.status = 1;
+        }
+        memcpy(reply_buf, &reply, sizeof(reply));
+
+        struct ibv_sge sge;
+        sge.addr = (uintptr_t)reply_buf;
+        sge.length = sizeof(reply);
+        sge.lkey = srv->ctrl_mr->lkey;
+        struct ibv_send_wr wr, *bad_wr;
+        memset(&wr, 0, sizeof(wr));
+        wr.opcode = IBV_WR_SEND;
+        wr.sg_list = &sge;
+        wr.num_sge = 1;
+        wr.send_flags = IBV_SEND_SIGNALED;
+        if (ibv_post_send(srv->ctx.qp, &wr, &bad_wr)) {
+            std::cerr << "Failed to post send request" << std::endl;
+            return -1;
+        }
+        if (wait_send(srv) < 0) {
+            return -1;
+        }
+    }
+    std::cout << "Grants: " << srv->pool.grants << ", revoked by peer: " << srv->pool.remote_revokes
+              << ", revoked locally: " << srv->pool.local_revokes << std::endl;
+    return 0;
+}
+
+
+int main() {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    mw_server *srv = new mw_server;
+    memset(&srv->ctx, 0, sizeof(srv->ctx));
+    srv->ctrl_mr = NULL;
+    // MR只允许绑定窗口，不带远程权限：它的rkey交给对端也无法使用
+    int mr_access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_MW_BIND;
+    int qp_access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    int ret = -1;
+    qp_info remote_qp_info;
+    if (rdma_alloc_resources(&srv->ctx, MW_ARENA_SIZE, 64, mr_access) == 0 &&
+        rdma_create_rc_qp(&srv->ctx, 16, MW_RECV_SLOTS) == 0 &&
+        mw_pool_init(&srv->pool, &srv->ctx, MW_POOL_SIZE) == 0 &&
+        (srv->ctrl_mr = ibv_reg_mr(srv->ctx.pd, srv->ctrl, sizeof(srv->ctrl), IBV_ACCESS_LOCAL_WRITE)) != NULL &&
+        rdma_connect_qp(&srv->ctx, client_fd, &remote_qp_info, qp_access) == 0) {
+        ret = 0;
+        for (int i = 0; i < MW_RECV_SLOTS && ret == 0; i++) {
+            ret = post_ctrl_recv(srv, i);
+        }
+        // 告知客户端接收已就绪
+        char ready = 1;
+        if (ret == 0 && sock_send_all(client_fd, &ready, 1) < 0) {
+            ret = -1;
+        }
+        if (ret == 0) {
+            ret = bench_grants(srv);
+        }
+        if (ret == 0) {
+            ret = serve_grants(srv);
+        }
+        if (ret == 0) {
+            char byte;
+            while (recv(client_fd, &byte, 1, 0) > 0);   // 等待客户端完成撤销检查并断开
+        }
+    }
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    mw_pool_free(&srv->pool);
+    if (srv->ctrl_mr) {
+        ibv_dereg_mr(srv->ctrl_mr);
+    }
+    rdma_free_resources(&srv->ctx);
+    delete srv;
+    return ret;
+}
@@ -0,0 +1,58 @@
+#include "rdma_proto.hpp"
+
+/*
+    协议选择的服务端：以收到消息时对端使用的协议原样回显，
+    这样客户端强制某种协议时两个方向走的都是同一种协议。
+*/
+
+int rdma_server_proto(rdma_context *_ctx, int client_fd) {
+    uint32_t max_size;
+    if (sock_recv_all(client_fd, &max_size, sizeof(max_size)) < 0) {
+        std::cerr << "Failed to receive config" << std::endl;
+        return -1;
+    }
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ;
+    if (rdma_alloc_resources(_ctx, PROTO_RESERVED_SIZE + (size_t)max_size, PROTO_CQ_DEPTH, access) < 0) {
+        return -1;
+    }
+    if (proto_create_qp(_ctx) < 0) {
+        return -1;
+    }
+    qp_info remote_qp_info;
+    if (rdma_connect_qp(_ctx, client_fd, &remote_qp_info, access) < 0) {
+        return -1;
+    }
+    proto_channel ch;
+    if (proto_channel_init(&ch, _ctx) < 0 || proto_handshake(client_fd) < 0) {
+        return -1;
+    }
+    std::cout << "Max inline data: " << ch.inline_cap << " bytes" << std::endl;
+    return proto_serve_echo(&ch, _ctx->buffer + PROTO_RESERVED_SIZE, max_size);
+}
+
+
+int main() {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int ret = rdma_server_proto(&ctx, client_fd);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
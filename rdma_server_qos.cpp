@@ -0,0 +1,76 @@
+#include "rdma_common.hpp"
+#include "rdma_qos.hpp"
+
+/*
+    QoS基准测试的被动端：按客户端发来的类别列表为每个类别创建一个QP，使用与客户端相同的SL和traffic_class，
+    之后只等待客户端断开，所有写入都由客户端单边完成。
+*/
+
+#define QOS_SERVER_BUF_SIZE (64 << 20)
+
+int rdma_server_qos(rdma_context *_ctx, int client_fd, std::vector<struct ibv_qp *> *qps) {
+    uint32_t nclasses;
+    if (sock_recv_all(client_fd, &nclasses, sizeof(nclasses)) < 0 || nclasses == 0 || nclasses > QOS_MAX_CLASSES) {
+        std::cerr << "Failed to receive class count" << std::endl;
+        return -1;
+    }
+    qos_wire_class classes[QOS_MAX_CLASSES];
+    if (sock_recv_all(client_fd, classes, nclasses * sizeof(qos_wire_class)) < 0) {
+        std::cerr << "Failed to receive classes" << std::endl;
+        return -1;
+    }
+
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_WRITE | IBV_ACCESS_REMOTE_READ;
+    if (rdma_alloc_resources(_ctx, QOS_SERVER_BUF_SIZE, 16, access) < 0) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < nclasses; i++) {
+        if (rdma_create_rc_qp(_ctx, 1, 1) < 0) {
+            return -1;
+        }
+        qps->push_back(_ctx->qp);
+        qp_info remote_qp_info;
+        if (rdma_connect_qp(_ctx, client_fd, &remote_qp_info, access, 7, classes[i].sl, classes[i].traffic_class) < 0) {
+            return -1;
+        }
+        std::cout << "Class " << i << ": SL " << (int)classes[i].sl
+                  << ", traffic class " << (int)classes[i].traffic_class << std::endl;
+    }
+
+    char byte;
+    while (recv(client_fd, &byte, 1, 0) > 0);   // 等待客户端断开
+    return 0;
+}
+
+
+int main() {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    std::vector<struct ibv_qp *> qps;
+    int ret = rdma_server_qos(&ctx, client_fd, &qps);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    for (struct ibv_qp *qp : qps) {
+        if (qp != ctx.qp) {
+            ibv_destroy_qp(qp);
+        }
+    }
+    rdma_free_resources(&ctx);
+    return ret;
+}
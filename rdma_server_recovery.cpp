@@ -0,0 +1,58 @@
+#include "rdma_recovery.hpp"
+
+/*
+    rdma_client_recovery 的被动端：注册一块可远程读写的内存，
+    之后在TCP连接上等待恢复请求，每收到一个 RECOV_REQ 就把QP重新连接一次，直到客户端断开。
+*/
+
+#define RECOVERY_SERVER_BUF_SIZE (1 << 20)
+
+int main() {
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    rdma_context ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    int ret = -1;
+    qp_info remote_qp_info;
+    if (rdma_alloc_resources(&ctx, RECOVERY_SERVER_BUF_SIZE, 16, access) == 0 &&
+        rdma_create_rc_qp(&ctx, 16, 16) == 0 &&
+        rdma_connect_qp(&ctx, client_fd, &remote_qp_info, access) == 0 &&
+        recov_async_nonblock(&ctx) == 0) {
+        ret = 0;
+        int recoveries = 0;
+        recov_msg msg;
+        while (sock_recv_all(client_fd, &msg, sizeof(msg)) == 0) {
+            if (ntohl(msg.type) != RECOV_REQ) {
+                std::cerr << "Unexpected message type " << ntohl(msg.type) << std::endl;
+                ret = -1;
+                break;
+            }
+            uint64_t start = now_ns();
+            if (recov_serve_request(&ctx, client_fd, access, &remote_qp_info, ntohl(msg.psn)) < 0) {
+                ret = -1;
+                break;
+            }
+            recoveries++;
+            std::cout << "QP recovered (" << recoveries << "), took " << (now_ns() - start) / 1000.0 << " us" << std::endl;
+        }
+    }
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    close(client_fd);
+    close(server_fd);
+    rdma_free_resources(&ctx);
+    return ret;
+}
@@ -205,6 +205,7 @@ void init_server(rdma_context *ctx) {
 
     // 发送响应消息
     strcpy(ctx->buffer, "Pong");
+    sge.length = strlen(ctx->buffer) + 1;   // 只发送有效数据，对端的接收缓冲区可能小于BUFFER_SIZE
     struct ibv_send_wr send_wr, *bad_send_wr;
     memset(&send_wr, 0, sizeof(send_wr));
     send_wr.opcode = IBV_WR_SEND;       // 设置操作码为发送操作
@@ -0,0 +1,54 @@
+#include "rdma_xport.hpp"
+
+/*
+    传输对比的服务端：用法 ./rdma_server_xport [auto|rdma|tcp]
+    缓冲区为 [单边读写区 (max_size) | 消息区 (XPORT_MSG_MAX)]，回显客户端的双边消息，
+    TCP传输下客户端的单边读写也在回显循环中处理。
+*/
+
+#define XPORT_MSG_MAX (64 * 1024)
+
+int rdma_server_xport(xport *x, int client_fd, int want) {
+    uint64_t max_size;
+    if (sock_recv_all(client_fd, &max_size, sizeof(max_size)) < 0) {
+        std::cerr << "Failed to receive config" << std::endl;
+        return -1;
+    }
+    if (xport_open(x, client_fd, max_size + XPORT_MSG_MAX, want) < 0) {
+        return -1;
+    }
+    std::cout << "Transport: " << xport_name(x->kind) << std::endl;
+    return xport_serve_echo(x, max_size, XPORT_MSG_MAX);
+}
+
+
+int main(int argc, char *argv[]) {
+    int want = argc > 1 ? xport_parse_kind(argv[1]) : XPORT_AUTO;
+    if (want < 0) {
+        std::cerr << "Usage: " << argv[0] << " [auto|rdma|tcp]" << std::endl;
+        return -1;
+    }
+    int server_fd = tcp_listen(PORT);
+    if (server_fd < 0) {
+        return -1;
+    }
+    int client_fd = accept(server_fd, NULL, NULL);
+    if (client_fd < 0) {
+        std::cerr << "Accept failed" << std::endl;
+        close(server_fd);
+        return -1;
+    }
+    std::cout << "Client connected" << std::endl;
+
+    xport x;
+    xport_init(&x);
+    int ret = rdma_server_xport(&x, client_fd, want);
+    if (ret < 0) {
+        std::cerr << "RDMA transaction failed" << std::endl;
+    }
+
+    xport_close(&x);
+    close(client_fd);
+    close(server_fd);
+    return ret;
+}
@@ -0,0 +1,302 @@
+#ifndef _RDMA_STRIPE_HPP
+#define _RDMA_STRIPE_HPP
+
+#include "rdma_common.hpp"
+#include "rdma_ec.hpp"
+#include <string>
+
+/*
+    纠删码条带写：每个块切成k个数据分片，编码出m个校验分片，分别RDMA_WRITE到k+m个远端内存服务器
+    （rdma_server_farmem，每个服务器一个RC QP，共用一个PD、CQ和MR）。
+
+    本地缓冲区布局：
+      [ 数据区 (nblocks × k × frag_size) | 校验区 (STRIPE_PIPELINE × m × frag_size) | 恢复区 ((k + m) × frag_size) ]
+    调用方直接在数据区中准备块内容，数据分片从这里零拷贝写出。
+    第b个块的第i个分片写到第i个服务器的 b × frag_size 处。
+
+    流水线：校验区有 depth 个槽位，块b使用槽位 b % depth。编码块b+1时块b的写请求仍在网络上传输，
+    只有槽位上一次的 k+m 个写全部完成后才会被复用。depth为1时退化为"编码 → 写 → 等待"串行执行。
+
+    读：从任意k个可用服务器RDMA_READ分片到恢复区，缺少数据分片时用 ec_reconstruct 重建，
+    恢复区的前 k × frag_size 字节即为完整的块。
+*/
+
+#define STRIPE_PIPELINE 8
+#define STRIPE_WR_READ 0x52440000ull    // wr_id：读分片
+
+struct stripe_server {
+    struct ibv_qp *qp;
+    int sock_fd;
+    uint64_t addr;
+    uint32_t rkey;
+    uint64_t size;
+};
+
+struct stripe_set {
+    rdma_context ctx;           // ctx.qp 与最后一个服务器的QP相同
+    ec_codec codec;
+    int k;
+    int m;
+    size_t frag_size;
+    size_t block_size;
+    uint64_t nblocks;
+    std::vector<stripe_server> servers;
+    char *data;
+    char *parity;
+    char *recovery;
+    int depth;                          // 当前使用的流水线深度
+    int pending[STRIPE_PIPELINE];       // 每个校验槽位上未完成的写
+    int reads_done;
+
+    // 统计信息
+    uint64_t encode_ns;
+    uint64_t blocks_written;
+};
+
+
+// 解析 "ip:port"，省略端口时使用PORT
+int stripe_parse_endpoint(const char *endpoint, std::string *ip, int *port) {
+    const char *colon = strrchr(endpoint, ':');
+    if (!colon) {
+        *ip = endpoint;
+        *port = PORT;
+        return 0;
+    }
+    *ip = std::string(endpoint, colon - endpoint);
+    *port = atoi(colon + 1);
+    return *port > 0 ? 0 : -1;
+}
+
+// 连接k+m个服务器，每个服务器至少需要 nblocks × frag_size 字节的远端内存
+int stripe_init(stripe_set *s, int k, int m, size_t frag_size, uint64_t nblocks, const char *const *endpoints,
+                ec_level level) {
+    memset(&s->ctx, 0, sizeof(s->ctx));
+    s->servers.clear();
+    if (ec_codec_init(&s->codec, k, m, level) < 0) {
+        return -1;
+    }
+    s->k = k;
+    s->m = m;
+    s->frag_size = frag_size;
+    s->block_size = frag_size * k;
+    s->nblocks = nblocks;
+    s->depth = STRIPE_PIPELINE;
+    memset(s->pending, 0, sizeof(s->pending));
+    s->reads_done = 0;
+    s->encode_ns = 0;
+    s->blocks_written = 0;
+
+    int n = k + m;
+    size_t data_size = s->block_size * nblocks;
+    size_t buf_size = data_size + (size_t)STRIPE_PIPELINE * m * frag_size + (size_t)n * frag_size;
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    if (rdma_alloc_resources(&s->ctx, buf_size, 2 * n * (STRIPE_PIPELINE + 1), access) < 0) {
+        return -1;
+    }
+    s->data = s->ctx.buffer;
+    s->parity = s->data + data_size;
+    s->recovery = s->parity + (size_t)STRIPE_PIPELINE * m * frag_size;
+
+    for (int i = 0; i < n; i++) {
+        stripe_server srv;
+        std::string ip;
+        int port;
+        if (stripe_parse_endpoint(endpoints[i], &ip, &port) < 0) {
+            std::cerr << "Invalid endpoint " << endpoints[i] << std::endl;
+            return -1;
+        }
+        srv.sock_fd = tcp_connect(ip.c_str(), port);
+        if (srv.sock_fd < 0) {
+            return -1;
+        }
+        srv.qp = NULL;
+        if (rdma_create_rc_qp(&s->ctx, STRIPE_PIPELINE + 1, 1) < 0) {
+            close(srv.sock_fd);
+            return -1;
+        }
+        srv.qp = s->ctx.qp;
+        s->servers.push_back(srv);      // 先记下，出错时由stripe_free释放
+
+        qp_info remote_info;
+        if (rdma_connect_qp(&s->ctx, srv.sock_fd, &remote_info, access) < 0) {
+            return -1;
+        }
+        uint64_t remote_size;
+        if (sock_recv_all(srv.sock_fd, &remote_size, sizeof(remote_size)) < 0) {
+            std::cerr << "Failed to receive remote size" << std::endl;
+            return -1;
+        }
+        if (remote_size < nblocks * frag_size) {
+            std::cerr << "Server " << endpoints[i] << " has " << (remote_size >> 20) << " MB, need "
+                      << ((nblocks * frag_size) >> 20) << " MB" << std::endl;
+            return -1;
+        }
+        s->servers.back().addr = remote_info.addr;
+        s->servers.back().rkey = remote_info.rkey;
+        s->servers.back().size = remote_size;
+    }
+    return 0;
+}
+
+void stripe_free(stripe_set *s) {
+    for (stripe_server &srv : s->servers) {
+        if (srv.qp && srv.qp != s->ctx.qp) {
+            ibv_destroy_qp(srv.qp);
+        }
+        close(srv.sock_fd);
+    }
+    s->servers.clear();
+    rdma_free_resources(&s->ctx);
+}
+
+// 设置流水线深度（1 ~ STRIPE_PIPELINE），必须在没有未完成的写时调用
+void stripe_set_depth(stripe_set *s, int depth) {
+    s->depth = std::max(1, std::min(depth, STRIPE_PIPELINE));
+}
+
+// 第block个块在数据区中的位置
+char *stripe_block(stripe_set *s, uint64_t block) {
+    return s->data + block * s->block_size;
+}
+
+// 轮询一次CQ，返回处理的完成数，出错返回-1
+int stripe_poll(stripe_set *s) {
+    struct ibv_wc wc[32];
+    int n = ibv_poll_cq(s->ctx.cq, 32, wc);
+    if (n < 0) {
+        std::cerr << "Failed to poll CQ" << std::endl;
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        if (wc[i].status != IBV_WC_SUCCESS) {
+            std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc[i].status) << std::endl;
+            return -1;
+        }
+        if ((wc[i].wr_id & 0xffff0000ull) == STRIPE_WR_READ) {
+            s->reads_done++;
+        } else {
+            s->pending[wc[i].wr_id]--;
+        }
+    }
+    return n;
+}
+
+// 等待所有写完成
+int stripe_flush(stripe_set *s) {
+    for (int slot = 0; slot < STRIPE_PIPELINE; slot++) {
+        while (s->pending[slot] > 0) {
+            if (stripe_poll(s) < 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int stripe_post(stripe_set *s, int server, enum ibv_wr_opcode opcode, char *local, uint64_t remote_offset, uint64_t wr_id) {
+    const stripe_server &srv = s->servers[server];
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)local;
+    sge.length = (uint32_t)s->frag_size;
+    sge.lkey = s->ctx.mr->lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = wr_id;
+    wr.opcode = opcode;
+    wr.sg_list = &sge;
+    wr.num_sge = 1;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = srv.addr + remote_offset;
+    wr.wr.rdma.rkey = srv.rkey;
+    if (ibv_post_send(srv.qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post request to server " << server << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 编码第block个块并把k+m个分片并行写出，不等待完成
+int stripe_write_block(stripe_set *s, uint64_t block) {
+    int slot = (int)(block % s->depth);
+    while (s->pending[slot] > 0) {
+        if (stripe_poll(s) < 0) {
+            return -1;
+        }
+    }
+
+    int k = s->k, m = s->m;
+    char *block_buf = stripe_block(s, block);
+    const uint8_t *data[EC_MAX_FRAGS];
+    uint8_t *parity[EC_MAX_FRAGS];
+    for (int j = 0; j < k; j++) {
+        data[j] = (const uint8_t *)block_buf + j * s->frag_size;
+    }
+    for (int i = 0; i < m; i++) {
+        parity[i] = (uint8_t *)s->parity + ((size_t)slot * m + i) * s->frag_size;
+    }
+    uint64_t start = now_ns();
+    ec_encode(&s->codec, data, parity, s->frag_size);
+    s->encode_ns += now_ns() - start;
+
+    uint64_t remote_offset = block * s->frag_size;
+    for (int i = 0; i < k + m; i++) {
+        char *local = i < k ? (char *)data[i] : (char *)parity[i - k];
+        if (stripe_post(s, i, IBV_WR_RDMA_WRITE, local, remote_offset, slot) < 0) {
+            return -1;
+        }
+        s->pending[slot]++;
+    }
+    s->blocks_written++;
+    return 0;
+}
+
+// 从未失效的服务器中选k个读回第block个块，failed[i]为true表示第i个服务器不可用；
+// 成功时返回恢复区中完整块的指针，下一次读之前有效
+char *stripe_read_block(stripe_set *s, uint64_t block, const bool *failed) {
+    if (stripe_flush(s) < 0) {
+        return NULL;
+    }
+    int k = s->k, n = s->k + s->m;
+    bool avail[EC_MAX_FRAGS];
+    uint8_t *frags[EC_MAX_FRAGS];
+    // 先数可用的服务器，不足k个时什么都不post，避免留下在途的读
+    int up = 0;
+    for (int i = 0; i < n; i++) {
+        up += failed[i] ? 0 : 1;
+    }
+    if (up < k) {
+        std::cerr << "Only " << up << " servers available, need " << k << std::endl;
+        return NULL;
+    }
+    int chosen = 0;
+    s->reads_done = 0;
+    bool post_failed = false;
+    for (int i = 0; i < n; i++) {
+        frags[i] = (uint8_t *)s->recovery + (size_t)i * s->frag_size;
+        avail[i] = !post_failed && chosen < k && !failed[i];
+        if (avail[i]) {
+            if (stripe_post(s, i, IBV_WR_RDMA_READ, (char *)frags[i], block * s->frag_size, STRIPE_WR_READ | i) < 0) {
+                post_failed = true;     // 已post的读仍要等完成后再返回
+                avail[i] = false;
+                continue;
+            }
+            chosen++;
+        }
+    }
+    while (s->reads_done < chosen) {
+        if (stripe_poll(s) < 0) {
+            return NULL;
+        }
+    }
+    if (post_failed) {
+        return NULL;
+    }
+    if (ec_reconstruct(&s->codec, frags, avail, s->frag_size) < 0) {
+        return NULL;
+    }
+    return s->recovery;
+}
+
+
+#endif  // _RDMA_STRIPE_HPP
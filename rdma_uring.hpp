@@ -0,0 +1,665 @@
+#ifndef _RDMA_URING_HPP
+#define _RDMA_URING_HPP
+
+#include "rdma_common.hpp"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+#include <cerrno>
+#include <deque>
+#include <string>
+
+/*
+    基于io_uring的TCP传输，在没有RDMA设备时代替QP（直接使用系统调用，不依赖liburing）
+
+      - 本端缓冲区用 IORING_REGISTER_BUFFERS 注册，大于 URING_ZC_MIN 的数据用 IORING_OP_SEND_ZC
+        从注册缓冲区零拷贝发出；注册失败（如超出RLIMIT_MEMLOCK）时退化为不带固定缓冲区的SEND_ZC；
+      - 接收用一个multishot IORING_OP_RECV，数据放进 provided buffer ring 中的缓冲区，解析后立即归还；
+      - 单边操作由对端的进度引擎代为完成：WRITE把数据写到对端缓冲区的偏移处后回ACK，
+        READ_REQ由对端从自己的缓冲区零拷贝发回READ_RESP；SEND是双边消息，放进对端的收件箱后回ACK。
+    TCP是字节流，多个发送请求并发执行时字节可能交错，所以同一时刻只有一条发送链在途：
+    排队的消息（消息头 + 数据）用 IOSQE_IO_LINK 串成一条链一次提交，链上全部完成、零拷贝通知也全部到达后
+    再提交下一条。对端按到达顺序处理请求，ACK/READ_RESP也按顺序返回，本地操作按post顺序完成，与RC QP一致。
+    收到ACK时发送数据的零拷贝通知可能还没到（内核仍在引用缓冲区），所以操作要等它所在的链释放后才算完成。
+    远端地址一律是对端缓冲区内的偏移。
+*/
+
+#define URING_SQ_ENTRIES 256
+#define URING_RECV_BUFS 64                  // provided buffer的个数，必须是2的幂
+#define URING_RECV_BUF_SIZE (64 * 1024)
+#define URING_CHAIN_MAX 64                  // 每条发送链最多的消息数
+#define URING_ZC_MIN 4096                   // 小于此长度时拷贝发送比零拷贝便宜
+
+#define URING_UD_RECV (1ull << 56)
+#define URING_UD_SEND (2ull << 56)
+#define URING_UD_MASK (0xffull << 56)
+
+enum uring_op {
+    URING_OP_WRITE = 1,
+    URING_OP_READ_REQ = 2,
+    URING_OP_READ_RESP = 3,
+    URING_OP_SEND = 4,
+    URING_OP_ACK = 5,
+};
+
+struct uring_hdr {
+    uint32_t op;
+    uint32_t len;
+    uint64_t remote;    // 目标端缓冲区内的偏移
+    uint64_t local;     // READ_REQ：发起端接收数据的偏移，由READ_RESP带回
+    uint64_t id;
+};
+
+struct uring_out {
+    uring_hdr hdr;
+    const char *payload;
+};
+
+struct uring_pending_op {
+    uint64_t id;
+    uint64_t wr_id;
+    uint64_t chain;     // 发出该请求的链的序号，提交前为0
+    bool acked;         // 已收到ACK/READ_RESP
+};
+
+struct uring_ring {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+    unsigned sqe_tail;          // 本地维护的SQ尾，uring_submit时发布
+    unsigned to_submit;
+};
+
+struct uring_conn {
+    int sock_fd;
+    uring_ring ring;
+    char *buffer;
+    size_t size;
+    bool fixed;                         // 缓冲区是否注册成功
+
+    char *recv_pool;
+    struct io_uring_buf *br;            // provided buffer ring；环尾与 br[0].resv 重叠
+    unsigned br_tail;
+    bool recv_armed;
+    bool peer_closed;
+
+    // 接收方向的解析状态
+    uring_hdr in_hdr;
+    uint32_t in_hdr_have;
+    char *in_dst;                       // 数据的目的地址，SEND时为NULL（追加到in_msg）
+    uint32_t in_left;
+    std::string in_msg;
+
+    // 发送方向
+    std::deque<uring_out> outq;
+    uring_hdr chain_hdrs[URING_CHAIN_MAX];
+    uint32_t chain_lens[2 * URING_CHAIN_MAX];
+    int chain_pending;                  // 当前链上未完成的SQE数
+    int zc_pending;                     // 未收到通知的零拷贝发送，归零前数据缓冲区仍被内核引用
+
+    uint64_t chains;                    // 已提交的链数，最新一条链的序号
+    uint64_t chains_released;           // 发送和零拷贝通知都已完成的链数，链按序号依次释放
+
+    uint64_t next_id;
+    std::deque<uring_pending_op> ops;   // 尚未完成的本地操作，按post顺序
+    std::deque<uint64_t> done;
+    std::deque<std::string> inbox;
+
+    // 统计信息
+    uint64_t zc_sends;
+    uint64_t copy_sends;
+};
+
+
+int uring_sys_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+int uring_sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+int uring_sys_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// 创建io_uring并映射SQ/CQ
+int uring_ring_init(uring_ring *r, unsigned entries) {
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * 4;         // 零拷贝发送和multishot接收每个SQE会产生多个CQE
+    r->fd = uring_sys_setup(entries, &p);
+    if (r->fd < 0) {
+        std::cerr << "io_uring_setup failed: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        r->sq_size = r->cq_size = std::max(r->sq_size, r->cq_size);
+    }
+    r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        r->sq_ptr = NULL;
+        std::cerr << "Failed to map SQ ring" << std::endl;
+        return -1;
+    }
+    if (single_mmap) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) {
+            r->cq_ptr = NULL;
+            std::cerr << "Failed to map CQ ring" << std::endl;
+            return -1;
+        }
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        std::cerr << "Failed to map SQEs" << std::endl;
+        return -1;
+    }
+    r->sqes = (struct io_uring_sqe *)sqes;
+
+    char *sq = (char *)r->sq_ptr, *cq = (char *)r->cq_ptr;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    r->sqe_tail = *r->sq_tail;
+    return 0;
+}
+
+void uring_ring_free(uring_ring *r) {
+    if (r->sqes) munmap(r->sqes, r->sqes_size);
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_size);
+    if (r->sq_ptr) munmap(r->sq_ptr, r->sq_size);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+// 取一个空闲SQE，SQ满时返回NULL
+struct io_uring_sqe *uring_get_sqe(uring_ring *r) {
+    unsigned head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+    if (r->sqe_tail - head > *r->sq_mask) {
+        return NULL;
+    }
+    unsigned idx = r->sqe_tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[idx] = idx;
+    r->sqe_tail++;
+    r->to_submit++;
+    return sqe;
+}
+
+// 发布新的SQE并进入内核；wait时在内核中睡眠到至少有一个CQE，否则只处理待完成的任务
+int uring_submit(uring_ring *r, bool wait) {
+    unsigned n = r->to_submit;
+    if (n > 0) {
+        __atomic_store_n(r->sq_tail, r->sqe_tail, __ATOMIC_RELEASE);
+    }
+    int ret = uring_sys_enter(r->fd, n, wait ? 1 : 0, IORING_ENTER_GETEVENTS);
+    if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        std::cerr << "io_uring_enter failed: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    if (ret > 0) {
+        r->to_submit -= std::min((unsigned)ret, n);
+    }
+    return 0;
+}
+
+
+/* 接收 */
+void uring_recycle_buf(uring_conn *u, unsigned bid) {
+    // C++下 io_uring_buf_ring::bufs 的偏移与内核不一致（空结构体占位），直接按数组访问
+    struct io_uring_buf *buf = &u->br[u->br_tail & (URING_RECV_BUFS - 1)];
+    buf->addr = (uintptr_t)(u->recv_pool + (size_t)bid * URING_RECV_BUF_SIZE);
+    buf->len = URING_RECV_BUF_SIZE;
+    buf->bid = (uint16_t)bid;
+    u->br_tail++;
+    __atomic_store_n(&u->br[0].resv, (uint16_t)u->br_tail, __ATOMIC_RELEASE);
+}
+
+int uring_arm_recv(uring_conn *u) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&u->ring);
+    if (!sqe) {
+        return 0;   // 下一次进度推进时再试
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = u->sock_fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = URING_UD_RECV;
+    u->recv_armed = true;
+    return 0;
+}
+
+void uring_queue(uring_conn *u, uint32_t op, uint32_t len, uint64_t remote, uint64_t local, uint64_t id,
+                 const char *payload) {
+    uring_out out;
+    out.hdr.op = op;
+    out.hdr.len = len;
+    out.hdr.remote = remote;
+    out.hdr.local = local;
+    out.hdr.id = id;
+    out.payload = payload;
+    u->outq.push_back(out);
+}
+
+// 对端确认了一个操作；ACK按post顺序到达，已确认的操作总是ops的前缀
+int uring_complete_op(uring_conn *u, uint64_t id) {
+    for (uring_pending_op &op : u->ops) {
+        if (op.acked) {
+            continue;
+        }
+        if (op.id != id) {
+            break;
+        }
+        op.acked = true;
+        return 0;
+    }
+    std::cerr << "Unexpected completion for operation " << id << std::endl;
+    return -1;
+}
+
+// 已确认、且所在的链已释放（内核不再引用数据）的操作移入done
+void uring_retire_ops(uring_conn *u) {
+    if (u->chain_pending == 0 && u->zc_pending == 0) {
+        u->chains_released = u->chains;
+    }
+    while (!u->ops.empty() && u->ops.front().acked && u->ops.front().chain <= u->chains_released) {
+        u->done.push_back(u->ops.front().wr_id);
+        u->ops.pop_front();
+    }
+}
+
+// 一个请求的数据全部到达
+int uring_finish_incoming(uring_conn *u) {
+    const uring_hdr &h = u->in_hdr;
+    switch (h.op) {
+    case URING_OP_WRITE:
+        uring_queue(u, URING_OP_ACK, 0, 0, 0, h.id, NULL);
+        return 0;
+    case URING_OP_SEND:
+        u->inbox.push_back(std::move(u->in_msg));
+        u->in_msg.clear();
+        uring_queue(u, URING_OP_ACK, 0, 0, 0, h.id, NULL);
+        return 0;
+    case URING_OP_READ_RESP:
+        return uring_complete_op(u, h.id);
+    }
+    return 0;
+}
+
+// 消息头完整后确定数据的去向
+int uring_begin_incoming(uring_conn *u) {
+    const uring_hdr &h = u->in_hdr;
+    u->in_dst = NULL;
+    u->in_left = 0;
+    switch (h.op) {
+    case URING_OP_WRITE:
+    case URING_OP_READ_REQ:
+        if (h.remote > u->size || h.len > u->size - h.remote) {
+            std::cerr << "Remote access out of bounds: offset " << h.remote << ", length " << h.len << std::endl;
+            return -1;
+        }
+        if (h.op == URING_OP_READ_REQ) {
+            // 由本端代为完成远端的读：从注册缓冲区直接发回
+            uring_queue(u, URING_OP_READ_RESP, h.len, 0, h.local, h.id, u->buffer + h.remote);
+            return 0;
+        }
+        u->in_dst = u->buffer + h.remote;
+        u->in_left = h.len;
+        break;
+    case URING_OP_READ_RESP:
+        if (h.local > u->size || h.len > u->size - h.local) {
+            std::cerr << "Read response out of bounds" << std::endl;
+            return -1;
+        }
+        u->in_dst = u->buffer + h.local;
+        u->in_left = h.len;
+        break;
+    case URING_OP_SEND:
+        u->in_msg.clear();
+        u->in_msg.reserve(h.len);
+        u->in_left = h.len;
+        break;
+    case URING_OP_ACK:
+        return uring_complete_op(u, h.id);
+    default:
+        std::cerr << "Unknown request " << h.op << std::endl;
+        return -1;
+    }
+    return u->in_left == 0 ? uring_finish_incoming(u) : 0;
+}
+
+// 解析一段接收到的字节流
+int uring_parse(uring_conn *u, const char *data, uint32_t len) {
+    while (len > 0) {
+        if (u->in_left == 0) {
+            uint32_t n = std::min<uint32_t>(len, sizeof(uring_hdr) - u->in_hdr_have);
+            memcpy((char *)&u->in_hdr + u->in_hdr_have, data, n);
+            u->in_hdr_have += n;
+            data += n;
+            len -= n;
+            if (u->in_hdr_have == sizeof(uring_hdr)) {
+                u->in_hdr_have = 0;
+                if (uring_begin_incoming(u) < 0) {
+                    return -1;
+                }
+            }
+            continue;
+        }
+        uint32_t n = std::min(len, u->in_left);
+        if (u->in_dst) {
+            memcpy(u->in_dst, data, n);
+            u->in_dst += n;
+        } else {
+            u->in_msg.append(data, n);
+        }
+        data += n;
+        len -= n;
+        u->in_left -= n;
+        if (u->in_left == 0 && uring_finish_incoming(u) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+/* 发送 */
+int uring_add_send(uring_conn *u, const char *buf, uint32_t len, int slot, bool more, bool last) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&u->ring);
+    if (!sqe) {
+        std::cerr << "Submission queue full" << std::endl;
+        return -1;
+    }
+    sqe->fd = u->sock_fd;
+    sqe->addr = (uintptr_t)buf;
+    sqe->len = len;
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+    sqe->flags = last ? 0 : IOSQE_IO_LINK;
+    sqe->user_data = URING_UD_SEND | slot;
+    bool in_buffer = buf >= u->buffer && buf + len <= u->buffer + u->size;
+    if (len >= URING_ZC_MIN && in_buffer) {
+        sqe->opcode = IORING_OP_SEND_ZC;
+        if (u->fixed) {
+            sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+            sqe->buf_index = 0;
+        }
+        u->zc_sends++;
+    } else {
+        sqe->opcode = IORING_OP_SEND;
+        u->copy_sends++;
+    }
+    u->chain_lens[slot] = len;
+    u->chain_pending++;
+    return 0;
+}
+
+// 记录本端发起的请求由哪条链发出
+void uring_mark_chain(uring_conn *u, const uring_hdr &h, uint64_t chain) {
+    if (h.op != URING_OP_WRITE && h.op != URING_OP_SEND && h.op != URING_OP_READ_REQ) {
+        return;     // ACK/READ_RESP的id属于对端
+    }
+    for (auto it = u->ops.rbegin(); it != u->ops.rend(); ++it) {
+        if (it->id == h.id) {
+            it->chain = chain;
+            return;
+        }
+    }
+}
+
+// 把排队的消息串成一条链提交，上一条链未完成（包括零拷贝通知）时不提交
+int uring_flush_chain(uring_conn *u) {
+    if (u->chain_pending > 0 || u->zc_pending > 0 || u->outq.empty()) {
+        return 0;
+    }
+    uint64_t chain = u->chains + 1;
+    // 给接收的重新arm留一个SQE
+    int max_msgs = std::min<int>(URING_CHAIN_MAX, (URING_SQ_ENTRIES - 1) / 2);
+    int n = std::min<int>(max_msgs, (int)u->outq.size());
+    int slot = 0;
+    for (int i = 0; i < n; i++) {
+        const uring_out &out = u->outq[i];
+        bool has_payload = out.hdr.len > 0 && out.payload;
+        bool last_msg = i == n - 1;
+        u->chain_hdrs[i] = out.hdr;
+        uring_mark_chain(u, out.hdr, chain);
+        if (uring_add_send(u, (const char *)&u->chain_hdrs[i], sizeof(uring_hdr), slot++, has_payload || !last_msg,
+                           last_msg && !has_payload) < 0) {
+            return -1;
+        }
+        if (has_payload && uring_add_send(u, out.payload, out.hdr.len, slot++, !last_msg, last_msg) < 0) {
+            return -1;
+        }
+    }
+    u->outq.erase(u->outq.begin(), u->outq.begin() + n);
+    u->chains = chain;
+    return 0;
+}
+
+// 处理已有的CQE
+int uring_reap(uring_conn *u) {
+    uring_ring *r = &u->ring;
+    unsigned head = *r->cq_head;
+    unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+    int ret = 0;
+    for (; head != tail && ret == 0; head++) {
+        struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        uint64_t kind = cqe->user_data & URING_UD_MASK;
+        if (kind == URING_UD_RECV) {
+            if (!(cqe->flags & IORING_CQE_F_MORE)) {
+                u->recv_armed = false;
+            }
+            if (cqe->res == 0) {
+                u->peer_closed = true;
+            } else if (cqe->res < 0) {
+                if (cqe->res != -ENOBUFS) {     // 缓冲区暂时用完时multishot会结束，重新arm即可
+                    std::cerr << "Receive failed: " << strerror(-cqe->res) << std::endl;
+                    ret = -1;
+                }
+            } else {
+                unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                ret = uring_parse(u, u->recv_pool + (size_t)bid * URING_RECV_BUF_SIZE, (uint32_t)cqe->res);
+                uring_recycle_buf(u, bid);
+            }
+        } else if (cqe->flags & IORING_CQE_F_NOTIF) {
+            u->zc_pending--;
+        } else {
+            int slot = (int)(cqe->user_data & 0xffffffffull);
+            if (cqe->flags & IORING_CQE_F_MORE) {
+                u->zc_pending++;        // 之后还有一个通知CQE
+            }
+            if (cqe->res != (int)u->chain_lens[slot]) {
+                std::cerr << "Send failed: "
+                          << (cqe->res < 0 ? strerror(-cqe->res) : "short write") << std::endl;
+                ret = -1;
+            }
+            u->chain_pending--;
+        }
+    }
+    __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    uring_retire_ops(u);
+    return ret;
+}
+
+// 推进一次：提交排队的发送和接收，处理完成。
+// wait时如果还没有CQE就在内核中等待：本地操作要等对端进度引擎的ACK，一直忙等会占住CPU，
+// 同一台机器上对端进程和内核的发送处理得不到调度（单核时每次都要等到时间片用完）
+int uring_progress(uring_conn *u, bool wait) {
+    if (!u->recv_armed && !u->peer_closed && uring_arm_recv(u) < 0) {
+        return -1;
+    }
+    if (uring_flush_chain(u) < 0) {
+        return -1;
+    }
+    // 对端关闭且没有在途的发送时不会再有CQE
+    bool can_complete = u->recv_armed || u->chain_pending > 0 || u->zc_pending > 0;
+    if (uring_submit(&u->ring, wait && can_complete) < 0) {
+        return -1;
+    }
+    return uring_reap(u);
+}
+
+
+/* 连接 */
+// 在已连接的TCP套接字上建立传输，buffer为本端可被远端访问的size字节内存
+int uring_init(uring_conn *u, int sock_fd, char *buffer, size_t size) {
+    u->sock_fd = sock_fd;
+    u->buffer = buffer;
+    u->size = size;
+    u->fixed = false;
+    u->recv_pool = NULL;
+    u->br = NULL;
+    u->br_tail = 0;
+    u->recv_armed = false;
+    u->peer_closed = false;
+    u->in_hdr_have = 0;
+    u->in_dst = NULL;
+    u->in_left = 0;
+    u->chain_pending = 0;
+    u->zc_pending = 0;
+    u->chains_released = 0;
+    u->next_id = 1;
+    u->chains = 0;
+    u->zc_sends = 0;
+    u->copy_sends = 0;
+    if (uring_ring_init(&u->ring, URING_SQ_ENTRIES) < 0) {
+        return -1;
+    }
+    // 消息之间靠MSG_MORE聚合，关闭Nagle避免小的ACK/消息头等待对端的延迟确认
+    int one = 1;
+    if (setsockopt(sock_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0) {
+        std::cerr << "Failed to set TCP_NODELAY" << std::endl;
+        return -1;
+    }
+
+    struct iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = size;
+    if (uring_sys_register(u->ring.fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0) {
+        u->fixed = true;
+    } else {
+        std::cerr << "Failed to register buffer (" << strerror(errno) << "), sending without fixed buffers" << std::endl;
+    }
+
+    size_t ring_bytes = URING_RECV_BUFS * sizeof(struct io_uring_buf);
+    void *ring_mem = mmap(NULL, ring_bytes, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (ring_mem == MAP_FAILED) {
+        std::cerr << "Failed to allocate buffer ring" << std::endl;
+        return -1;
+    }
+    u->br = (struct io_uring_buf *)ring_mem;
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uintptr_t)ring_mem;
+    reg.ring_entries = URING_RECV_BUFS;
+    reg.bgid = 0;
+    if (uring_sys_register(u->ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        std::cerr << "Failed to register buffer ring: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    u->recv_pool = (char *)malloc((size_t)URING_RECV_BUFS * URING_RECV_BUF_SIZE);
+    if (!u->recv_pool) {
+        std::cerr << "Failed to allocate receive buffers" << std::endl;
+        return -1;
+    }
+    for (unsigned i = 0; i < URING_RECV_BUFS; i++) {
+        uring_recycle_buf(u, i);
+    }
+    return uring_arm_recv(u);
+}
+
+// 发完排队的消息（如最后一个ACK）并等待零拷贝通知后释放，允许部分初始化
+void uring_free(uring_conn *u) {
+    if (u->ring.fd >= 0) {
+        while ((!u->outq.empty() || u->chain_pending > 0 || u->zc_pending > 0) && uring_progress(u, true) == 0);
+    }
+    uring_ring_free(&u->ring);
+    if (u->br) munmap(u->br, URING_RECV_BUFS * sizeof(struct io_uring_buf));
+    free(u->recv_pool);
+    u->br = NULL;
+    u->recv_pool = NULL;
+}
+
+// post一个单边读写或双边发送，完成后wr_id由uring_poll返回
+int uring_post(uring_conn *u, uint32_t op, uint64_t local_off, uint64_t remote_off, uint32_t len, uint64_t wr_id) {
+    if (u->peer_closed) {
+        std::cerr << "Connection closed by peer" << std::endl;
+        return -1;
+    }
+    uint64_t id = u->next_id++;
+    switch (op) {
+    case URING_OP_WRITE:
+    case URING_OP_SEND:
+        uring_queue(u, op, len, remote_off, 0, id, u->buffer + local_off);
+        break;
+    case URING_OP_READ_REQ:
+        uring_queue(u, op, len, remote_off, local_off, id, NULL);
+        break;
+    default:
+        std::cerr << "Unsupported operation " << op << std::endl;
+        return -1;
+    }
+    u->ops.push_back({id, wr_id, 0, false});
+    return 0;
+}
+
+// 有未完成的操作时等到有CQE再返回，所以可能返回0
+int uring_poll(uring_conn *u, uint64_t *wr_ids, int max) {
+    if (u->done.empty() && uring_progress(u, !u->ops.empty()) < 0) {
+        return -1;
+    }
+    if (u->done.empty() && u->peer_closed && !u->ops.empty()) {
+        std::cerr << "Connection closed with " << u->ops.size() << " operations pending" << std::endl;
+        return -1;
+    }
+    int n = 0;
+    while (n < max && !u->done.empty()) {
+        wr_ids[n++] = u->done.front();
+        u->done.pop_front();
+    }
+    return n;
+}
+
+// 阻塞接收一条双边消息到本端缓冲区的local_off处，返回长度
+int uring_recv(uring_conn *u, uint64_t local_off, uint32_t max_len) {
+    while (u->inbox.empty()) {
+        if (uring_progress(u, true) < 0) {
+            return -1;
+        }
+        if (u->peer_closed && u->inbox.empty()) {
+            std::cerr << "Connection closed by peer" << std::endl;
+            return -1;
+        }
+    }
+    std::string &msg = u->inbox.front();
+    uint32_t len = (uint32_t)std::min<size_t>(msg.size(), max_len);
+    memcpy(u->buffer + local_off, msg.data(), len);
+    u->inbox.pop_front();
+    return (int)len;
+}
+
+
+#endif  // _RDMA_URING_HPP
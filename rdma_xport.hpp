@@ -0,0 +1,338 @@
+#ifndef _RDMA_XPORT_HPP
+#define _RDMA_XPORT_HPP
+
+#include "rdma_common.hpp"
+#include "rdma_uring.hpp"
+
+/*
+    统一的传输接口：RC QP，或没有RDMA设备时的io_uring TCP传输（rdma_uring.hpp）
+
+    两端在TCP连接上交换各自是否有RDMA设备，都有时才用RDMA，否则双方都退回TCP；
+    指定 XPORT_RDMA 而任一端没有设备时报错。建立后的接口与传输无关：
+      - 本地和远端地址都用各自缓冲区内的偏移表示；
+      - xport_post 提交单边写/读或双边发送，完成按提交顺序由 xport_poll 返回wr_id；
+      - xport_recv 阻塞接收一条双边消息。
+    RDMA传输在本端缓冲区之后另外注册 XPORT_RECV_SLOTS 个接收缓冲区，连接后全部预先post，
+    xport_recv 从中拷出一条消息并重新post该缓冲区，所以对端发送时不会因为没有接收而触发RNR重传；
+    双边消息不能超过 XPORT_RECV_SIZE。
+    TCP传输下对端的单边操作在本端调用 xport_poll / xport_recv 推进时处理，
+    被动端需要一直处于这两个调用中（例如 xport_serve_echo）。
+*/
+
+#define XPORT_MAX_WR 64
+#define XPORT_RECV_SLOTS 16
+#define XPORT_RECV_SIZE (64 * 1024)         // RDMA传输下每个接收缓冲区的大小
+#define XPORT_WR_RECV 0xffffffffffffffffull
+
+enum xport_kind {
+    XPORT_AUTO = 0,
+    XPORT_RDMA = 1,
+    XPORT_TCP = 2,
+};
+
+enum xport_op {
+    XPORT_WRITE = 0,
+    XPORT_READ = 1,
+    XPORT_SEND = 2,
+};
+
+struct xport {
+    int kind;
+    rdma_context rdma;
+    uring_conn uring;
+    char *buffer;
+    size_t size;
+    uint64_t remote_addr;
+    uint32_t rkey;
+    uint64_t remote_size;
+    std::deque<uint64_t> done;      // RDMA：xport_recv等待时收到的其他完成
+    char *recv_area;                // RDMA：预先post的接收缓冲区，紧接在本端缓冲区之后
+    uint64_t recv_next;             // RDMA：下一条消息所在的接收缓冲区，RC按post顺序完成
+    std::deque<uint32_t> received;  // RDMA：xport_poll时到达、尚未取走的消息长度
+};
+
+
+const char *xport_name(int kind) {
+    return kind == XPORT_RDMA ? "rdma" : (kind == XPORT_TCP ? "tcp" : "auto");
+}
+
+// 解析 "auto" / "rdma" / "tcp"
+int xport_parse_kind(const char *name) {
+    if (strcmp(name, "rdma") == 0) return XPORT_RDMA;
+    if (strcmp(name, "tcp") == 0) return XPORT_TCP;
+    if (strcmp(name, "auto") == 0) return XPORT_AUTO;
+    return -1;
+}
+
+// 是否有可用的RDMA设备，不打开设备
+bool rdma_device_present() {
+    int num_devices = 0;
+    struct ibv_device **dev_list = ibv_get_device_list(&num_devices);
+    if (dev_list) {
+        ibv_free_device_list(dev_list);
+    }
+    return num_devices > 0;
+}
+
+int xport_post_recv(xport *x, uint64_t slot) {
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)(x->recv_area + (size_t)slot * XPORT_RECV_SIZE);
+    sge.length = XPORT_RECV_SIZE;
+    sge.lkey = x->rdma.mr->lkey;
+
+    struct ibv_recv_wr recv_wr, *bad_recv_wr;
+    memset(&recv_wr, 0, sizeof(recv_wr));
+    recv_wr.wr_id = XPORT_WR_RECV;
+    recv_wr.sg_list = &sge;
+    recv_wr.num_sge = 1;
+    if (ibv_post_recv(x->rdma.qp, &recv_wr, &bad_recv_wr)) {
+        std::cerr << "Failed to post receive request" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+int xport_open_rdma(xport *x, int sock_fd, size_t size) {
+    int access = IBV_ACCESS_LOCAL_WRITE | IBV_ACCESS_REMOTE_READ | IBV_ACCESS_REMOTE_WRITE;
+    size_t recv_bytes = (size_t)XPORT_RECV_SLOTS * XPORT_RECV_SIZE;
+    if (rdma_alloc_resources(&x->rdma, size + recv_bytes, 2 * XPORT_MAX_WR, access) < 0) {
+        return -1;
+    }
+    if (rdma_create_rc_qp(&x->rdma, XPORT_MAX_WR, XPORT_MAX_WR) < 0) {
+        return -1;
+    }
+    qp_info remote_info;
+    if (rdma_connect_qp(&x->rdma, sock_fd, &remote_info, access) < 0) {
+        return -1;
+    }
+    x->buffer = x->rdma.buffer;
+    x->remote_addr = remote_info.addr;
+    x->rkey = remote_info.rkey;
+    // 在xport_open交换缓冲区大小之前post，对端开始发送时接收已经就绪
+    x->recv_area = x->buffer + size;
+    for (uint64_t i = 0; i < XPORT_RECV_SLOTS; i++) {
+        if (xport_post_recv(x, i) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int xport_open_tcp(xport *x, int sock_fd, size_t size) {
+    x->buffer = (char *)malloc(size);
+    if (!x->buffer) {
+        std::cerr << "Failed to allocate buffer" << std::endl;
+        return -1;
+    }
+    memset(x->buffer, 0, size);
+    return uring_init(&x->uring, sock_fd, x->buffer, size);
+}
+
+// 使xport_close可以安全调用，main中代替memset
+void xport_init(xport *x) {
+    memset(&x->rdma, 0, sizeof(x->rdma));
+    memset(&x->uring.ring, 0, sizeof(x->uring.ring));
+    x->uring.ring.fd = -1;
+    x->uring.br = NULL;
+    x->uring.recv_pool = NULL;
+    x->kind = XPORT_TCP;
+    x->buffer = NULL;
+    x->size = 0;
+    x->remote_addr = 0;
+    x->rkey = 0;
+    x->remote_size = 0;
+    x->done.clear();
+    x->recv_area = NULL;
+    x->recv_next = 0;
+    x->received.clear();
+}
+
+// 在已连接的TCP套接字上协商传输并建立连接，本端缓冲区为size字节
+int xport_open(xport *x, int sock_fd, size_t size, int want) {
+    xport_init(x);
+    x->size = size;
+
+    uint8_t local_has = want != XPORT_TCP && rdma_device_present();
+    uint8_t remote_has;
+    if (sock_send_all(sock_fd, &local_has, 1) < 0 || sock_recv_all(sock_fd, &remote_has, 1) < 0) {
+        std::cerr << "Failed to negotiate transport" << std::endl;
+        return -1;
+    }
+    if (local_has && remote_has) {
+        x->kind = XPORT_RDMA;
+    } else if (want == XPORT_RDMA) {
+        std::cerr << (local_has ? "Peer has" : "Found") << " no RDMA device" << std::endl;
+        return -1;
+    } else if (want == XPORT_AUTO) {
+        std::cout << "No RDMA device on " << (local_has ? "peer" : "this host") << ", using io_uring TCP transport"
+                  << std::endl;
+    }
+
+    int ret = x->kind == XPORT_RDMA ? xport_open_rdma(x, sock_fd, size) : xport_open_tcp(x, sock_fd, size);
+    if (ret < 0) {
+        return -1;
+    }
+    uint64_t local_size = size;
+    if (sock_send_all(sock_fd, &local_size, sizeof(local_size)) < 0 ||
+        sock_recv_all(sock_fd, &x->remote_size, sizeof(x->remote_size)) < 0) {
+        std::cerr << "Failed to exchange buffer sizes" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 允许部分初始化
+void xport_close(xport *x) {
+    if (x->kind == XPORT_RDMA) {
+        rdma_free_resources(&x->rdma);
+    } else {
+        uring_free(&x->uring);
+        free(x->buffer);
+    }
+    x->buffer = NULL;
+}
+
+// 提交一个操作：XPORT_WRITE / XPORT_READ 访问远端remote_off处，XPORT_SEND 忽略remote_off
+int xport_post(xport *x, int op, uint64_t local_off, uint64_t remote_off, uint32_t len, uint64_t wr_id) {
+    if (local_off > x->size || len > x->size - local_off) {
+        std::cerr << "Local range out of bounds" << std::endl;
+        return -1;
+    }
+    if (op != XPORT_SEND && (remote_off > x->remote_size || len > x->remote_size - remote_off)) {
+        std::cerr << "Remote range out of bounds" << std::endl;
+        return -1;
+    }
+    if (x->kind == XPORT_TCP) {
+        uint32_t uop = op == XPORT_WRITE ? URING_OP_WRITE : (op == XPORT_READ ? URING_OP_READ_REQ : URING_OP_SEND);
+        return uring_post(&x->uring, uop, local_off, remote_off, len, wr_id);
+    }
+    if (op == XPORT_SEND && len > XPORT_RECV_SIZE) {
+        std::cerr << "Message larger than receive buffer" << std::endl;
+        return -1;
+    }
+
+    struct ibv_sge sge;
+    sge.addr = (uintptr_t)(x->buffer + local_off);
+    sge.length = len;
+    sge.lkey = x->rdma.mr->lkey;
+
+    struct ibv_send_wr wr, *bad_wr;
+    memset(&wr, 0, sizeof(wr));
+    wr.wr_id = wr_id;
+    wr.opcode = op == XPORT_WRITE ? IBV_WR_RDMA_WRITE : (op == XPORT_READ ? IBV_WR_RDMA_READ : IBV_WR_SEND);
+    wr.sg_list = &sge;
+    wr.num_sge = len > 0 ? 1 : 0;
+    wr.send_flags = IBV_SEND_SIGNALED;
+    wr.wr.rdma.remote_addr = x->remote_addr + remote_off;
+    wr.wr.rdma.rkey = x->rkey;
+    if (ibv_post_send(x->rdma.qp, &wr, &bad_wr)) {
+        std::cerr << "Failed to post send request" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// 非阻塞地取最多max个完成的wr_id
+int xport_poll(xport *x, uint64_t *wr_ids, int max) {
+    if (x->kind == XPORT_TCP) {
+        return uring_poll(&x->uring, wr_ids, max);
+    }
+    int n = 0;
+    while (n < max && !x->done.empty()) {
+        wr_ids[n++] = x->done.front();
+        x->done.pop_front();
+    }
+    if (n > 0) {
+        return n;
+    }
+    struct ibv_wc wc[16];
+    int got = ibv_poll_cq(x->rdma.cq, std::min(max, 16), wc);
+    if (got < 0) {
+        std::cerr << "Failed to poll CQ" << std::endl;
+        return -1;
+    }
+    for (int i = 0; i < got; i++) {
+        if (wc[i].status != IBV_WC_SUCCESS) {
+            std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc[i].status) << std::endl;
+            return -1;
+        }
+        if (wc[i].wr_id == XPORT_WR_RECV) {
+            x->received.push_back(wc[i].byte_len);      // 留给xport_recv
+        } else {
+            wr_ids[n++] = wc[i].wr_id;
+        }
+    }
+    return n;
+}
+
+// 等待n个完成
+int xport_wait(xport *x, int n) {
+    uint64_t wr_ids[16];
+    while (n > 0) {
+        int got = xport_poll(x, wr_ids, std::min(n, 16));
+        if (got < 0) {
+            return -1;
+        }
+        n -= got;
+    }
+    return 0;
+}
+
+// 阻塞接收一条双边消息到local_off处，返回长度
+int xport_recv(xport *x, uint64_t local_off, uint32_t max_len) {
+    if (local_off > x->size || max_len > x->size - local_off) {
+        std::cerr << "Local range out of bounds" << std::endl;
+        return -1;
+    }
+    if (x->kind == XPORT_TCP) {
+        return uring_recv(&x->uring, local_off, max_len);
+    }
+
+    while (x->received.empty()) {
+        struct ibv_wc wc;
+        int got = ibv_poll_cq(x->rdma.cq, 1, &wc);
+        if (got < 0) {
+            std::cerr << "Failed to poll CQ" << std::endl;
+            return -1;
+        }
+        if (got == 0) {
+            continue;
+        }
+        if (wc.status != IBV_WC_SUCCESS) {
+            std::cerr << "Work completion failed with status " << ibv_wc_status_str(wc.status) << std::endl;
+            return -1;
+        }
+        if (wc.wr_id == XPORT_WR_RECV) {
+            x->received.push_back(wc.byte_len);
+        } else {
+            x->done.push_back(wc.wr_id);
+        }
+    }
+    uint32_t len = std::min(x->received.front(), max_len);
+    x->received.pop_front();
+    uint64_t slot = x->recv_next++ % XPORT_RECV_SLOTS;
+    memcpy(x->buffer + local_off, x->recv_area + (size_t)slot * XPORT_RECV_SIZE, len);
+    if (xport_post_recv(x, slot) < 0) {
+        return -1;
+    }
+    return (int)len;
+}
+
+// 被动端：回显收到的每条双边消息，期间对端的单边操作照常进行；收到长度为0的消息时返回
+int xport_serve_echo(xport *x, uint64_t msg_off, uint32_t max_len) {
+    while (true) {
+        int len = xport_recv(x, msg_off, max_len);
+        if (len < 0) {
+            return -1;
+        }
+        if (len == 0) {
+            return 0;
+        }
+        if (xport_post(x, XPORT_SEND, msg_off, 0, (uint32_t)len, 0) < 0 || xport_wait(x, 1) < 0) {
+            return -1;
+        }
+    }
+}
+
+
+#endif  // _RDMA_XPORT_HPP